@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "loader.hpp"
+
+namespace sim {
+// One simulation of a batch
+struct BatchJob {
+  std::string elf;
+  // 0 means no limit
+  long instruction_limit = 0;
+  // Simulator options, as they would follow the program on the command line
+  std::vector<std::string> options;
+};
+
+struct BatchResult {
+  // "exit", "limit" when the instruction limit stopped it, or the error
+  std::string status = "not run";
+  int exit_code = 0;
+  long instructions = 0;
+  double seconds = 0;
+};
+
+// Runs many short simulations in one process. Each ELF is read once and its
+// image shared by all of its jobs. Jobs are dealt round-robin to per-worker
+// deques; a worker takes from the back of its own deque and, once that is
+// empty, steals from the front of the others.
+// In cooperative mode a worker keeps up to max_guests jobs loaded at once
+// and takes turns between them on its thread, a slice of budget
+// instructions each, instead of running one job to the end.
+class BatchRunner final {
+public:
+  static constexpr std::size_t max_guests = 1024;
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::size_t> jobs;
+  };
+
+  struct Guest {
+    std::size_t job;
+    std::unique_ptr<Loader> loader;
+    // Spent in this guest's slices only
+    double seconds = 0;
+  };
+
+  std::vector<BatchJob> jobs_;
+  std::vector<BatchResult> results_;
+  std::map<std::string, std::shared_ptr<const ElfImage>> images_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Instructions per slice in cooperative mode, or 0
+  long budget_ = 0;
+
+  bool take(std::size_t worker, std::size_t &job);
+
+  std::unique_ptr<Loader> load_job(std::size_t job) const;
+
+  void finish_job(std::size_t job, const MachineBase &machine,
+                  int exit_code);
+
+  void run_job(std::size_t job);
+
+  void run_cooperative(std::size_t worker);
+
+public:
+  // Lines are "<elf> <instruction limit> [options...]". Blank lines and lines
+  // starting with # are skipped.
+  void read_manifest(const std::string &path);
+
+  void set_cooperative(long budget) { budget_ = budget; }
+
+  // 0 workers means one per host CPU
+  void run(std::size_t n_workers);
+
+  // One tab-separated line per job, in manifest order
+  void write_results(const std::string &path) const;
+};
+} // namespace sim
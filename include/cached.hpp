@@ -1,29 +1,76 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
 
+#include "xlen.hpp"
+
 namespace sim {
-class Hart;
+template <int XLEN> class Hart;
+
+template <int XLEN>
+using InstructionHandler = std::function<void(Hart<XLEN> *)>;
+template <int XLEN>
+using DecodedInstruction = std::pair<InstructionHandler<XLEN>, bool>;
 
-using register_t = uint32_t;
-using InstructionHandler = std::function<void(Hart *)>;
-using DecodedInstruction = std::pair<InstructionHandler, bool>;
+// A decoded instruction together with the number of bytes it occupies and
+// the number of guest instructions it retires
+template <int XLEN> struct CachedInstruction {
+  InstructionHandler<XLEN> handler;
+  uint32_t length;
+  uint32_t count = 1;
+};
 
-DecodedInstruction decode(uint32_t instr);
+// Decodes one instruction for the given register width. 16-bit instructions
+// are expanded first. RV64-only opcodes are illegal in RV32.
+template <int XLEN> DecodedInstruction<XLEN> decode(uint32_t instr);
 
-class Cached final {
+// Fuses sh1add/sh2add/sh3add with a following integer load based on its
+// result, which is how indexed array accesses compile with Zba. Returns an
+// empty handler when the pair does not fuse.
+template <int XLEN>
+InstructionHandler<XLEN> fuse(uint32_t first, uint32_t first_length,
+                              uint32_t second);
+
+// Decoded blocks keyed by the physical address they were fetched from, so
+// they stay valid across satp switches and aliasing virtual mappings. Blocks
+// never cross a page and are looked up by halfword offset within their page.
+template <int XLEN> class Cached final {
 private:
-  std::unordered_map<register_t, std::vector<InstructionHandler>> cached_;
+  using register_t = typename Xlen<XLEN>::reg;
+
+  static constexpr uint32_t page_shift = 12;
+  static constexpr uint32_t halfwords_per_page = 1 << (page_shift - 1);
+
+  struct CachedPage {
+    std::array<std::vector<CachedInstruction<XLEN>>, halfwords_per_page>
+        blocks;
+  };
+
+  std::unordered_map<uint32_t, std::unique_ptr<CachedPage>> pages_;
+  uint32_t last_frame_ = ~0u;
+  CachedPage *last_page_ = nullptr;
+
+  CachedPage *find_page(uint32_t paddr, bool create);
 
 public:
-  Hart *hart_;
+  Hart<XLEN> *hart_;
+
+  // Copies every decoded block of another hart. Handlers only depend on the
+  // instruction bits, so the copy is valid for any hart running the same
+  // code.
+  void copy_from(const Cached &other);
 
-  bool cache_it(register_t pc);
+  // Returns false if not even the first instruction fits in the page
+  bool cache_it(uint32_t paddr);
 
-  bool execute_from_cache(register_t &pc);
+  // Runs the block starting at paddr, which the hart's pc translates to. A
+  // taken branch or a trap leaves the block early.
+  bool execute_from_cache(register_t &pc, uint32_t paddr);
 };
-}; // namespace sim
\ No newline at end of file
+}; // namespace sim
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "device.hpp"
+#include "snapshot.hpp"
+
+namespace sim {
+constexpr uint32_t clint_base = mmio_base + 0x02000000;
+
+// Core-local interruptor: msip, mtimecmp and mtime registers. mtime counts
+// retired instructions of hart 0 plus the time skipped by wfi, so a timer is
+// just an instruction-count deadline on the hart. Writing msip of another
+// hart sends it an IPI.
+class Clint final : public Device {
+private:
+  struct Target {
+    InterruptLines *lines;
+    const long *instret;
+    uint64_t mtimecmp;
+  };
+
+  std::vector<Target> targets_;
+  const long *instret_ = nullptr;
+  std::atomic<long> time_offset_{0};
+
+  void update_deadline(Target &target);
+
+public:
+  static constexpr uint32_t size = 0x10000;
+  static constexpr uint32_t msip_offset = 0x0;
+  static constexpr uint32_t mtimecmp_offset = 0x4000;
+  static constexpr uint32_t mtime_offset = 0xBFF8;
+
+  // Harts attach in the order of their mhartid. instret is the instruction
+  // count of the hart, which its timer deadline is measured in.
+  void attach(InterruptLines *lines, const long *instret);
+
+  uint64_t mtime() const;
+
+  // Takes over mtime and the timers of another CLINT once the same number
+  // of harts is attached
+  void copy_from(const Clint &other);
+
+  // mtime and the timers; restore once the harts are attached
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+
+  // Advances mtime to the nearest timer deadline of the hart, as if it had
+  // been sleeping in wfi. Returns false if no timer is armed or if there are
+  // other harts, which keep running meanwhile.
+  bool fast_forward(unsigned hart_id);
+
+  uint64_t read(uint32_t offset, int size) override;
+
+  void write(uint32_t offset, uint64_t value, int size) override;
+};
+} // namespace sim
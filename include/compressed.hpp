@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sim {
+// Instructions whose two low bits are not 11 are 16 bits long
+inline uint32_t instruction_length(uint32_t instr) {
+  return (instr & 3) == 3 ? 4 : 2;
+}
+
+// Expands a 16-bit RVC instruction into the equivalent 32-bit one, so the
+// regular decoder and handlers run it. Reserved and unsupported encodings
+// expand to 0, which is illegal.
+template <int XLEN> uint32_t expand_compressed(uint16_t instr);
+} // namespace sim
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace sim {
+// Physical window above RAM reserved for memory-mapped devices
+constexpr uint32_t mmio_base = 0x18000000;
+constexpr uint32_t mmio_size = 0x08000000;
+constexpr uint32_t mmio_page_shift = 12;
+
+constexpr uint32_t MIP_MSIP = 1 << 3;  // Machine software interrupt
+constexpr uint32_t MIP_MTIP = 1 << 7;  // Machine timer interrupt
+constexpr uint32_t MIP_MEIP = 1 << 11; // Machine external interrupt
+
+class Device {
+public:
+  virtual ~Device() = default;
+
+  virtual uint64_t read(uint32_t offset, int size) = 0;
+
+  virtual void write(uint32_t offset, uint64_t value, int size) = 0;
+};
+
+// Interrupt inputs of a single hart. Devices drive them; the hart only looks
+// at them once its instruction count reaches next_event, so nothing is polled
+// on the per-instruction path.
+struct InterruptLines {
+  static constexpr long never = std::numeric_limits<long>::max();
+
+  std::atomic<uint32_t> pending{0};
+  std::atomic<long> timer_deadline{never};
+  std::atomic<long> next_event{0};
+
+  void raise(uint32_t mask) {
+    pending.fetch_or(mask);
+    next_event.store(0);
+  }
+
+  void lower(uint32_t mask) { pending.fetch_and(~mask); }
+};
+} // namespace sim
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cfenv>
+#include <cstdint>
+
+#include "snapshot.hpp"
+
+namespace sim {
+constexpr uint32_t FFLAG_NX = 1 << 0;
+constexpr uint32_t FFLAG_UF = 1 << 1;
+constexpr uint32_t FFLAG_OF = 1 << 2;
+constexpr uint32_t FFLAG_DZ = 1 << 3;
+constexpr uint32_t FFLAG_NV = 1 << 4;
+
+constexpr uint32_t RM_RNE = 0;
+constexpr uint32_t RM_RTZ = 1;
+constexpr uint32_t RM_RDN = 2;
+constexpr uint32_t RM_RUP = 3;
+constexpr uint32_t RM_RMM = 4;
+constexpr uint32_t RM_DYN = 7;
+
+// F and D register file and fcsr of a hart. Arithmetic runs directly on the
+// host FPU: the host's sticky exception flags hold the fflags raised since
+// the last sync(), and the host rounding mode is only switched when an
+// instruction asks for a different one, so round-to-nearest code never
+// touches it.
+class Fpu final {
+private:
+  std::array<uint64_t, 32> fpr_{};
+  uint32_t fflags_ = 0;
+  uint32_t frm_ = RM_RNE;
+  int host_rounding_ = FE_TONEAREST;
+
+public:
+  // Single values are NaN-boxed; a single read from a register that does
+  // not hold a boxed value yields the canonical NaN
+  template <typename T> T get(uint8_t reg) const;
+  // Stores an arithmetic result, replacing any NaN with the canonical one
+  template <typename T> void set(uint8_t reg, T value);
+
+  // Raw IEEE encodings, for moves, sign injection, loads and stores
+  template <typename T> uint64_t get_bits(uint8_t reg) const;
+  template <typename T> void set_bits(uint8_t reg, uint64_t bits);
+
+  uint32_t fflags() const;
+  void set_fflags(uint32_t flags);
+  void raise(uint32_t flags) { fflags_ |= flags; }
+  uint32_t frm() const { return frm_; }
+  void set_frm(uint32_t rm) { frm_ = rm & 7; }
+
+  // Selects the host rounding mode for an instruction's rm field. RMM has no
+  // host equivalent and rounds to nearest-even outside of conversions.
+  void round(uint32_t rm);
+  uint32_t effective_rm(uint32_t rm) const { return rm == RM_DYN ? frm_ : rm; }
+
+  // Moves the host's exception flags into fflags and restores the default
+  // rounding mode, so that host code and other harts start from a clean
+  // environment
+  void sync();
+
+  // Drops host exception flags that guest code did not raise
+  void discard_host_flags();
+
+  // Registers and fcsr, after a sync()
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+
+  template <typename T> T min_max(T a, T b, bool max);
+  // Quiet (feq) or signaling (flt, fle) comparison
+  template <typename T> bool compare(T a, T b, bool less, bool equal,
+                                     bool signaling);
+  template <typename T> static uint32_t classify(T value);
+  // Saturating conversion to an integer type, as fcvt.{w,wu,l,lu}.{s,d}
+  template <typename I, typename T> I to_int(T value, uint32_t rm);
+};
+} // namespace sim
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "machine.hpp"
+
+namespace sim {
+// In-process persistent-mode fuzzing of one guest function. The function
+// takes a buffer in a0 and its size in a1, like LLVMFuzzerTestOneInput, and
+// is called with the buffer it may fill. The program runs once up to the
+// entry of the function, and the machine there becomes the baseline. Every
+// execution then resets the machine to it, which copies back only the pages
+// the last one wrote, writes an input into the buffer and its length into
+// a1, and runs until the function returns. Edges between blocks are counted
+// in a coverage map, and inputs that reach a new edge, or an edge a new
+// number of times, join the corpus.
+class Fuzzer final {
+private:
+  enum class Outcome { ok, crash, hang };
+
+  std::uint64_t entry_;
+  std::filesystem::path corpus_dir_;
+  std::size_t runs_;
+  long limit_;
+  std::uint64_t buffer_ = 0;
+  std::uint64_t capacity_ = 0;
+  std::uint64_t return_ = 0;
+  std::vector<std::vector<std::uint8_t>> corpus_;
+  // Hit counts of the current execution, and the classes of hit counts
+  // seen so far per edge, separately for crashes
+  std::vector<std::uint8_t> trace_;
+  std::vector<std::uint8_t> seen_;
+  std::vector<std::uint8_t> seen_crashes_;
+  std::mt19937_64 random_;
+
+  void read_corpus();
+
+  std::vector<std::uint8_t> mutate();
+
+  Outcome execute(MachineBase &machine, const std::vector<std::uint8_t> &input,
+                  std::string &reason);
+
+  // Adds the trace of the last execution to seen and clears it. Returns
+  // whether it had anything that seen did not.
+  bool merge(std::vector<std::uint8_t> &seen);
+
+  // Named after its contents, so that the same input is saved once
+  static void save(const std::filesystem::path &dir,
+                   const std::vector<std::uint8_t> &input);
+
+public:
+  // entry is a guest address. Executions that run more than limit
+  // instructions count as hangs.
+  Fuzzer(std::uint64_t entry, std::filesystem::path corpus_dir,
+         std::size_t runs, long limit);
+
+  // Fuzzes a loaded single-hart machine that has not run yet for runs
+  // executions. The files in the corpus directory are the seeds, and new
+  // inputs are saved there. An execution crashes when the simulator throws,
+  // for example on an illegal instruction, when the guest jumps outside RAM
+  // or when it exits with a code other than 0. One input per new crash
+  // coverage goes to the crashes subdirectory. Returns the exit code if the
+  // program ends before it calls the function, otherwise 0.
+  int run(MachineBase &machine);
+};
+} // namespace sim
@@ -1,90 +1,300 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
+#include "xlen.hpp"
 
 namespace sim {
+    template <int XLEN> class Hart;
 
-class Hart;
+    template<typename T>
+    T sign_extend(T value, int bits) {
+        T sign_bit = (value >> (bits - 1)) & 1;
+        if (sign_bit) {
+            T mask = (static_cast<T>(1) << bits) - 1;
+            return value | ~mask;
+        }
+        return value;
+    }
 
-using register_t = uint32_t;
+    template<typename T>
+    T count_leading_zeros(T value) {
+        if (value == 0) return sizeof(T) * 8;
+        if constexpr (sizeof(T) == 8) return __builtin_clzll(value);
+        else return __builtin_clz(value);
+    }
 
-template <typename T> T sign_extend(T value, int bits) {
-  T sign_bit = (value >> (bits - 1)) & 1;
-  if (sign_bit) {
-    T mask = (static_cast<T>(1) << bits) - 1;
-    return value | ~mask;
-  }
-  return value;
-}
+    template<typename T>
+    T count_trailing_zeros(T value) {
+        if (value == 0) return sizeof(T) * 8;
+        if constexpr (sizeof(T) == 8) return __builtin_ctzll(value);
+        else return __builtin_ctz(value);
+    }
 
-void exec_add(Hart *hart, uint32_t instr);
-void exec_sub(Hart *hart, uint32_t instr);
-void exec_sll(Hart *hart, uint32_t instr);
-void exec_slt(Hart *hart, uint32_t instr);
-void exec_sltu(Hart *hart, uint32_t instr);
-void exec_xor(Hart *hart, uint32_t instr);
-void exec_srl(Hart *hart, uint32_t instr);
-void exec_sra(Hart *hart, uint32_t instr);
-void exec_or(Hart *hart, uint32_t instr);
-void exec_and(Hart *hart, uint32_t instr);
-void exec_addi(Hart *hart, uint32_t instr);
-void exec_slti(Hart *hart, uint32_t instr);
-void exec_sltiu(Hart *hart, uint32_t instr);
-void exec_xori(Hart *hart, uint32_t instr);
-void exec_ori(Hart *hart, uint32_t instr);
-void exec_andi(Hart *hart, uint32_t instr);
-void exec_slli(Hart *hart, uint32_t instr);
-void exec_srli(Hart *hart, uint32_t instr);
-void exec_srai(Hart *hart, uint32_t instr);
-void exec_lb(Hart *hart, uint32_t instr);
-void exec_lh(Hart *hart, uint32_t instr);
-void exec_lw(Hart *hart, uint32_t instr);
-void exec_lbu(Hart *hart, uint32_t instr);
-void exec_lhu(Hart *hart, uint32_t instr);
-void exec_sb(Hart *hart, uint32_t instr);
-void exec_sh(Hart *hart, uint32_t instr);
-void exec_sw(Hart *hart, uint32_t instr);
-void exec_beq(Hart *hart, uint32_t instr);
-void exec_bne(Hart *hart, uint32_t instr);
-void exec_blt(Hart *hart, uint32_t instr);
-void exec_bge(Hart *hart, uint32_t instr);
-void exec_bltu(Hart *hart, uint32_t instr);
-void exec_bgeu(Hart *hart, uint32_t instr);
-void exec_jal(Hart *hart, uint32_t instr);
-void exec_jalr(Hart *hart, uint32_t instr);
-void exec_lui(Hart *hart, uint32_t instr);
-void exec_auipc(Hart *hart, uint32_t instr);
-void exec_fence(Hart *hart, uint32_t instr);
-void exec_fence_i(Hart *hart, uint32_t instr);
-void exec_csrrw(Hart *hart, uint32_t instr);
-void exec_csrrs(Hart *hart, uint32_t instr);
-void exec_csrrc(Hart *hart, uint32_t instr);
-void exec_csrrwi(Hart *hart, uint32_t instr);
-void exec_csrrsi(Hart *hart, uint32_t instr);
-void exec_csrrci(Hart *hart, uint32_t instr);
-void exec_ecall(Hart *hart, uint32_t instr);
-void exec_ebreak(Hart *hart, uint32_t instr);
-void exec_uret(Hart *hart, uint32_t instr);
-void exec_sret(Hart *hart, uint32_t instr);
-void exec_mret(Hart *hart, uint32_t instr);
-void exec_wfi(Hart *hart, uint32_t instr);
-void exec_sfence_vma(Hart *hart, uint32_t instr);
-void exec_addiw(Hart *hart, uint32_t instr);
-void exec_slliw(Hart *hart, uint32_t instr);
-void exec_srliw(Hart *hart, uint32_t instr);
-void exec_sraiw(Hart *hart, uint32_t instr);
-void exec_addw(Hart *hart, uint32_t instr);
-void exec_subw(Hart *hart, uint32_t instr);
-void exec_sllw(Hart *hart, uint32_t instr);
-void exec_srlw(Hart *hart, uint32_t instr);
-void exec_sraw(Hart *hart, uint32_t instr);
-void exec_sltw(Hart *hart, uint32_t instr);
-void exec_sltuw(Hart *hart, uint32_t instr);
-void exec_xorw(Hart *hart, uint32_t instr);
-void exec_orw(Hart *hart, uint32_t instr);
-void exec_andw(Hart *hart, uint32_t instr);
-void exec_ld(Hart *hart, uint32_t instr);
-void exec_lwu(Hart *hart, uint32_t instr);
-void exec_sd(Hart *hart, uint32_t instr);
-void exec_ill(Hart *hart, uint32_t instr);
-} // namespace sim
+    template<typename T>
+    T count_ones(T value) {
+        if constexpr (sizeof(T) == 8) return __builtin_popcountll(value);
+        else return __builtin_popcount(value);
+    }
+
+    template<typename T>
+    T byte_swap(T value) {
+        if constexpr (sizeof(T) == 8) return __builtin_bswap64(value);
+        else return __builtin_bswap32(value);
+    }
+
+    // Both rotates compile to a single host rotate instruction
+    template<typename T>
+    T rotate_left(T value, unsigned shift) {
+        return (value << shift) | (value >> (-shift & (sizeof(T) * 8 - 1)));
+    }
+
+    template<typename T>
+    T rotate_right(T value, unsigned shift) {
+        return (value >> shift) | (value << (-shift & (sizeof(T) * 8 - 1)));
+    }
+
+    // orc.b: every non-zero byte becomes 0xFF. Adding 0x7F to the low seven
+    // bits of a byte carries into its top bit unless they are all zero.
+    template<typename T>
+    T or_combine(T value) {
+        T high = (~T{0} / 0xFF) << 7;
+        T nonzero = (((value & ~high) + ~high) | value) & high;
+        return (nonzero >> 7) * 0xFF;
+    }
+
+    // Read-modify-write operations of the A extension
+    enum class AmoOp { swap, add, xor_, and_, or_, min, max, minu, maxu };
+
+    // Applies op to the naturally aligned *ptr with one host atomic operation
+    // and returns the old value. T is uint32_t or uint64_t. Everything is
+    // sequentially consistent whatever aq and rl say, which is what a locked
+    // x86 instruction costs anyway.
+    template<typename T>
+    T atomic_fetch_op(AmoOp op, T* ptr, T value) {
+        switch (op) {
+            case AmoOp::swap: return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::add: return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::xor_: return __atomic_fetch_xor(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::and_: return __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::or_: return __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST);
+            default: break;
+        }
+        // The host has no fetch-min or fetch-max, so retry a compare-and-swap
+        using S = std::make_signed_t<T>;
+        T old = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+        T next;
+        do {
+            bool replace = op == AmoOp::min ? S(value) < S(old)
+                : op == AmoOp::max ? S(value) > S(old)
+                : op == AmoOp::minu ? value < old : value > old;
+            next = replace ? value : old;
+        } while (!__atomic_compare_exchange_n(ptr, &old, next, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+        return old;
+    }
+
+    // Instruction handlers for one register width, instantiated for RV32 and
+    // RV64 in generated_instructions.cpp. decode() in cached.cpp picks them.
+    template <int XLEN> struct Instructions final {
+        using register_t = typename Xlen<XLEN>::reg;
+        using sregister_t = typename Xlen<XLEN>::sreg;
+        using dregister_t = typename Xlen<XLEN>::dreg;
+        using sdregister_t = typename Xlen<XLEN>::sdreg;
+        static constexpr uint32_t shamt_mask = XLEN - 1;
+
+        static void exec_add(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sub(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sll(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_slt(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sltu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_xor(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_srl(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sra(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_or(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_and(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_addi(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_slti(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sltiu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_xori(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ori(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_andi(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_slli(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_srli(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_srai(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lb(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lh(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lbu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lhu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sb(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_beq(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_bne(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_blt(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_bge(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_bltu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_bgeu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_jal(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_jalr(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lui(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_auipc(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fence(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fence_i(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrs(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrc(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrwi(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrsi(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_csrrci(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ecall(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ebreak(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_uret(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sret(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mret(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_wfi(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sfence_vma(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_addiw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_slliw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_srliw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sraiw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_addw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_subw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sllw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_srlw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sraw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ld(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lwu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sd(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mul(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mulh(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mulhsu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mulhu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_div(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_divu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rem(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_remu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_mulw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_divw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_divuw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_remw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_remuw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_flw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fld(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsd(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmadd_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmsub_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fnmsub_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fnmadd_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fadd_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsub_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmul_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fdiv_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsqrt_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnj_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnjn_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnjx_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmin_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmax_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_feq_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_flt_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fle_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fclass_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_w_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_s_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_wu_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_s_wu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_l_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_s_l(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_lu_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_s_lu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmadd_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmsub_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fnmsub_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fnmadd_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fadd_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsub_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmul_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fdiv_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsqrt_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnj_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnjn_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fsgnjx_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmin_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmax_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_feq_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_flt_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fle_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fclass_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_w_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_d_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_wu_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_d_wu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_l_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_d_l(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_lu_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_d_lu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_s_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fcvt_d_s(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmv_x_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmv_w_x(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmv_x_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_fmv_d_x(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh1add(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh2add(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh3add(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_andn(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_orn(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_xnor(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_min(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_minu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_max(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_maxu(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rol(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ror(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_zext_h(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_clz(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ctz(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_cpop(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sext_b(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sext_h(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rori(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_orc_b(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rev8(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_add_uw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh1add_uw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh2add_uw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sh3add_uw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_slli_uw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_clzw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ctzw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_cpopw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rolw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_rorw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_roriw(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lr_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sc_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoswap_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoadd_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoxor_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoand_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoor_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomin_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomax_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amominu_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomaxu_w(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_lr_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_sc_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoswap_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoadd_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoxor_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoand_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amoor_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomin_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomax_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amominu_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_amomaxu_d(Hart<XLEN>* hart, uint32_t instr);
+        static void exec_ill(Hart<XLEN>* hart, uint32_t instr);
+    };
+} 
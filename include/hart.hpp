@@ -1,52 +1,284 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <stack>
 
 #include "cached.hpp"
+#include "clint.hpp"
+#include "compressed.hpp"
+#include "device.hpp"
+#include "fpu.hpp"
 #include "memory.hpp"
 #include "mmu.hpp"
+#include "syscall.hpp"
+#include "vector.hpp"
+#include "xlen.hpp"
 
 namespace sim {
-using register_t = uint32_t;
 const int n_regs = 32;
-const int n_csr = 1024;
+const int n_csr = 4096;
+
+namespace csr {
+constexpr uint32_t fflags = 0x001;
+constexpr uint32_t frm = 0x002;
+constexpr uint32_t fcsr = 0x003;
+constexpr uint32_t vstart = 0x008;
+constexpr uint32_t satp = 0x180;
+constexpr uint32_t mstatus = 0x300;
+constexpr uint32_t mie = 0x304;
+constexpr uint32_t mtvec = 0x305;
+constexpr uint32_t mepc = 0x341;
+constexpr uint32_t mcause = 0x342;
+constexpr uint32_t mtval = 0x343;
+constexpr uint32_t mip = 0x344;
+constexpr uint32_t mcycle = 0xB00;
+constexpr uint32_t minstret = 0xB02;
+constexpr uint32_t mcycleh = 0xB80;
+constexpr uint32_t minstreth = 0xB82;
+constexpr uint32_t cycle = 0xC00;
+constexpr uint32_t time = 0xC01;
+constexpr uint32_t instret = 0xC02;
+constexpr uint32_t vl = 0xC20;
+constexpr uint32_t vtype = 0xC21;
+constexpr uint32_t vlenb = 0xC22;
+constexpr uint32_t cycleh = 0xC80;
+constexpr uint32_t timeh = 0xC81;
+constexpr uint32_t instreth = 0xC82;
+constexpr uint32_t mhartid = 0xF14;
+} // namespace csr
+
+constexpr uint32_t MSTATUS_MIE = 1 << 3;
+constexpr uint32_t MSTATUS_MPIE = 1 << 7;
+constexpr uint32_t MSTATUS_MPP = 3 << 11;
+
+// The reservation set of an LR: the host address it loaded and the value it
+// saw. SC stores with a host compare-and-swap against that value, so plain
+// stores never have to look at reservations, at the price of missing a store
+// that writes back the same value.
+struct Reservation {
+  uint8_t *ptr = nullptr;
+  std::size_t size = 0;
+  uint64_t value = 0;
+};
+
+// Why run_for() gave the thread back
+enum class Yield {
+  budget,  // ran its instructions
+  wfi,     // waits for an interrupt
+  syscall, // a syscall would block and is retried on the next call
+  stopped, // stop(), the instruction limit or a breakpoint
+  exited
+};
+
+// Edge coverage map written by harts, see Hart::set_coverage()
+constexpr uint32_t coverage_bits = 16;
+constexpr std::size_t coverage_size = std::size_t{1} << coverage_bits;
+
+template <int XLEN> class Hart final {
+public:
+  using register_t = typename Xlen<XLEN>::reg;
+  using sregister_t = typename Xlen<XLEN>::sreg;
 
-class Hart final {
 private:
-  Cached cache_;
-  MMU mmu_;
+  Cached<XLEN> cache_;
+  MMU<XLEN> mmu_;
   bool mmu_enabled_;
+  InterruptLines irq_;
+  Clint *clint_ = nullptr;
+  unsigned hart_id_ = 0;
+  Memory<XLEN> memory_;
+  // Set by another thread to end the run at the next interrupt check
+  std::atomic<bool> stop_requested_{false};
+  long instruction_limit_ = InterruptLines::never;
+  // Cooperative harts give their thread back on wfi and blocking syscalls
+  bool cooperative_ = false;
+  // A yield requested by the current instruction, budget if none
+  Yield yield_ = Yield::budget;
+  double seconds_ = 0;
+  // Last translated instruction page, so that fetch only consults the iTLB
+  // when execution crosses a page boundary
+  static constexpr register_t no_page = ~register_t{0};
+  register_t fetch_page_ = no_page;
+  uint32_t fetch_frame_ = 0;
+  register_t breakpoint_ = ~register_t{0};
+  uint8_t *coverage_ = nullptr;
+  uint32_t previous_block_ = 0;
+  bool quiet_ = false;
+
+  bool running() const {
+    return !halted_ && pc < static_cast<register_t>(memory_size);
+  }
+
+  // Reads the instruction at pc, whose first halfword is at paddr. The upper
+  // half of a 32-bit instruction may be on the next page.
+  bool fetch(uint32_t paddr, uint32_t &instr);
+
+  // Runs one decoded instruction that is length bytes long
+  void execute(const InstructionHandler<XLEN> &handler, uint32_t length) {
+    next_pc = pc + length;
+    handler(this);
+    pc = next_pc;
+    ++n_instructions;
+  }
+
+  // Returns false when the hart has to stop: on a stop request, at the
+  // instruction limit or on a cooperative yield
+  bool check_interrupts();
+
+  void take_interrupt(uint32_t cause);
+
+  // Counts the edge from the previous block to the one at paddr. Blocks are
+  // hashed by address, and the edge is the hash of the previous block
+  // shifted by one, xored with this one, as in AFL.
+  void cover(uint32_t paddr) {
+    uint32_t hash = (paddr >> 1) * 0x9E3779B1u;
+    uint32_t block = hash >> (32 - coverage_bits);
+    ++coverage_[block ^ previous_block_];
+    previous_block_ = block >> 1;
+  }
 
 public:
   long n_instructions = 0;
   Hart() { cache_.hart_ = this; }
   std::array<register_t, n_regs> gpr_{};
-  std::array<register_t, n_csr> csr_;
-  Memory *mem_ = nullptr;
+  std::array<register_t, n_csr> csr_{};
+  Fpu fpu_;
+  VectorUnit vpu_;
+  Reservation reservation_;
+  Memory<XLEN> *mem_ = nullptr;
+  Syscalls *sys_ = nullptr;
   register_t pc;
+  // Where execution continues after the current instruction. Handlers that
+  // jump or trap overwrite it.
+  register_t next_pc;
+  bool halted_ = false;
+  int exit_code_ = 0;
 
+  // Runs until the guest exits or stop() is called, then report() prints
+  // the statistics
   void run();
 
+  // Quantum and cooperative scheduling: start() once, then run_for() runs
+  // about n instructions, up to the end of a decoded block, and says why it
+  // returned. All state lives in the hart, so the next call picks up where
+  // the last one stopped. Host FPU state is handed back after every call,
+  // so any number of harts can take turns on one thread.
+  void start();
+
+  Yield run_for(long n);
+
+  void set_cooperative(bool cooperative) { cooperative_ = cooperative; }
+  bool cooperative() const { return cooperative_; }
+
+  // Ends the current run_for() after this instruction
+  void yield(Yield reason);
+
+  // Runs the current ecall again on the next run_for(), instead of blocking
+  void retry_syscall();
+
+  // Stops the hart before it runs the instruction at pc, every time until
+  // the breakpoint moves. It is only checked where a block starts, so pc
+  // has to be a jump target, such as the entry or return address of a call.
+  void set_breakpoint(register_t pc) { breakpoint_ = pc; }
+
+  // Counts the edges between the blocks the hart runs in a map of
+  // coverage_size bytes, which any number of harts may share. Without the
+  // decoded instruction cache, every instruction is a block of its own.
+  // nullptr turns it off.
+  void set_coverage(uint8_t *map) {
+    coverage_ = map;
+    previous_block_ = 0;
+  }
+
+  // Keeps page faults off stdout
+  void set_quiet(bool quiet) { quiet_ = quiet; }
+
+  void stop();
+
+  bool stop_requested() const { return stop_requested_.load(); }
+
+  void report() const;
+
+  // Host time spent running guest instructions
+  double seconds() const { return seconds_; }
+
   bool step();
 
   void set_register(const uint8_t &reg, const register_t &value);
 
   void set_pc(const register_t &value);
 
-  void set_mem(Memory *mem);
+  // Gives the hart its view of the physical memory shared by all harts
+  void set_mem(PhysicalMemory *phys);
+
+  void set_hart_id(unsigned id);
+
+  // Takes over the whole state of a stopped hart of another machine, decoded
+  // instructions included, except for its memory and devices
+  void copy_from(const Hart &other);
+
+  // The same without decoded instructions, which stay valid as long as the
+  // code is the same: brings a hart back to an earlier copy of itself
+  void copy_state_from(const Hart &other);
+
+  // Architectural state of a stopped hart. Decoded instructions are not
+  // saved and a reservation does not survive a restore.
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+
+  // Stops the hart once it has run this many instructions
+  void set_instruction_limit(long limit);
+  bool out_of_budget() const { return n_instructions >= instruction_limit_; }
+
+  void set_syscalls(Syscalls *sys);
+
+  void set_clint(Clint *clint);
+
+  InterruptLines *interrupt_lines() { return &irq_; }
+
+  register_t get_csr(uint32_t addr) const;
+
+  void set_csr(uint32_t addr, register_t value);
+
+  void mret();
+
+  void wait_for_interrupt();
+
+  // x0 as rs1 means all addresses, x0 as rs2 means all address spaces
+  void sfence_vma(uint8_t rs1, uint8_t rs2);
 
   void dump_registers() const;
 
   bool is_mmu_enabled_() const;
 
-  bool translate_mmu(uint32_t vaddr, uint32_t &paddr, uint32_t access_type);
+  bool translate_mmu(register_t vaddr, uint32_t &paddr, uint32_t access_type);
 
-  void handle_page_fault(uint32_t vaddr, uint32_t cause);
-};
+  // The same without taking the page fault, for guest buffers passed to
+  // syscalls, which fail with EFAULT instead
+  bool translate_no_fault(register_t vaddr, uint32_t &paddr,
+                          uint32_t access_type);
+
+  bool translate_fetch(register_t vaddr, uint32_t &paddr) {
+    if ((vaddr >> 12) == fetch_page_) {
+      paddr = fetch_frame_ | (vaddr & 0xFFF);
+      return true;
+    }
+    if (!translate_mmu(vaddr, paddr, ACCESS_EXECUTE)) {
+      return false;
+    }
+    fetch_page_ = vaddr >> 12;
+    fetch_frame_ = paddr & ~0xFFFu;
+    return true;
+  }
 
-bool create_page_table(Memory &mem, uint32_t table_phys_addr);
+  void configure_tlb(const TlbConfig &config);
 
+  MmuStats mmu_stats() const { return mmu_.stats(); }
+
+  void handle_page_fault(register_t vaddr, uint32_t access_type);
+};
 } // namespace sim
\ No newline at end of file
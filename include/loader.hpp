@@ -5,18 +5,122 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "fuzz.hpp"
 #include "machine.hpp"
+#include "sweep.hpp"
 
 namespace sim {
+// The loadable part of an ELF file. Read once, it can be loaded into any
+// number of machines, which only copy from it.
+struct ElfImage {
+  struct Segment {
+    std::uint64_t virtual_addr;
+    std::uint64_t memory_size;
+    std::uint32_t flags; // ELF p_flags
+    std::vector<char> data;
+  };
+
+  bool is_64bit = false;
+  std::uint64_t entry = 0;
+  std::vector<Segment> segments;
+  // Addresses of the function symbols, by name
+  std::unordered_map<std::string, std::uint64_t> functions;
+
+  // Prints the ELF properties and segments when verbose
+  static std::shared_ptr<const ElfImage> read(const std::filesystem::path &path,
+                                              bool verbose);
+};
+
 class Loader final {
 private:
-  Machine machine_;
+  // Created by load once the ELF class is known
+  std::unique_ptr<MachineBase> machine_;
+
+  // Options given before the machine exists
+  std::string disk_path_;
+  std::optional<TlbConfig> tlb_;
+  std::size_t n_harts_ = 1;
+  std::size_t quantum_ = 0;
+  long instruction_limit_ = 0;
+  bool quiet_ = false;
+  std::optional<Sweep> sweep_;
+  std::size_t lanes_ = 0;
+  std::string inputs_path_;
+  bool check_lanes_ = false;
+  long snapshot_at_ = 0;
+  std::string snapshot_path_;
+  std::size_t repeat_ = 0;
+  std::string fuzz_function_;
+  // Found by load() when fuzz_function_ names a function of the ELF
+  std::optional<std::uint64_t> fuzz_entry_;
+  std::string corpus_dir_;
+  std::size_t fuzz_runs_ = 0;
+
+  // Creates the machine and applies the options given so far
+  void build(bool is_64bit, std::size_t n_harts);
 
 public:
   void read_elf(const std::filesystem::path &path);
 
-  void run();
+  // Builds the machine and copies the image into its memory
+  void load(const ElfImage &image, bool verbose);
+
+  // Builds the machine from a snapshot file instead, see SnapshotFile. The
+  // number of harts comes from the snapshot.
+  void restore(const std::string &path);
+
+  // Command line options that follow the program, see main.cpp
+  void parse_options(const std::vector<std::string> &args);
+
+  void attach_disk(const std::string &path);
+
+  void configure_tlb(const TlbConfig &config);
+
+  void set_harts(std::size_t n_harts);
+
+  void set_quantum(std::size_t instructions);
+
+  // 0 means no limit
+  void set_instruction_limit(long limit);
+
+  void set_quiet(bool quiet);
+
+  // Makes run() sweep the TLB configurations instead, see Sweep
+  void set_sweep(long fast_forward, long region,
+                 std::vector<TlbConfig> configs);
+
+  // Makes run() start one copy of the program per line of the inputs file,
+  // lanes copies at a time in lock-step. A line holds up to eight numbers,
+  // which go to a0-a7.
+  void set_lanes(std::size_t lanes, const std::string &inputs_path);
+
+  // Makes the lanes run also run every input on a scalar hart, and fail if
+  // any exit code differs
+  void set_check_lanes(bool check);
+
+  // Makes run() stop after this many instructions and save the machine
+  void set_snapshot(long instructions, const std::string &path);
+
+  // Makes run() run the program this many times, with a reset() to the
+  // starting point in between
+  void set_repeat(std::size_t runs);
+
+  // Makes run() fuzz a function of the program, see Fuzzer. The function is
+  // a symbol of the ELF or an address. The instruction limit applies to
+  // each execution.
+  void set_fuzz(const std::string &function, const std::string &corpus_dir,
+                std::size_t runs);
+
+  int run();
+
+  MachineBase &machine() { return *machine_; }
+
+  const MachineBase &machine() const { return *machine_; }
 };
-} // namespace sim
\ No newline at end of file
+} // namespace sim
@@ -1,21 +1,228 @@
 #pragma once
 
+#include "clint.hpp"
 #include "hart.hpp"
 #include "memory.hpp"
+#include "page_table.hpp"
+#include "syscall.hpp"
+#include "virtio_blk.hpp"
 #include <elfio/elfio.hpp>
+#include <memory>
+#include <vector>
 
 namespace sim {
-class Machine final {
+// Width-independent interface used by the loader, so that it can build either
+// machine from the ELF class. Only called while loading, never per
+// instruction.
+class MachineBase {
+public:
+  virtual ~MachineBase() = default;
+
+  virtual int run() = 0;
+
+  // Continues a machine that was stopped by its instruction limit, or a fork
+  virtual int resume() = 0;
+
+  // Cooperative scheduling, so that one thread can take turns between many
+  // machines: start() once instead of run(), then every slice() runs about
+  // budget instructions on each live hart and returns. Harts give the
+  // thread back early on wfi and on reads that would block. The result is
+  // budget while any hart still made progress, otherwise why hart 0
+  // returned.
+  virtual void start() = 0;
+
+  virtual Yield slice(long budget) = 0;
+
+  // Of hart 0, once it has exited
+  virtual int exit_code() const = 0;
+
+  // Copies the stopped machine: RAM, harts with their decoded instructions,
+  // heap and timers. A machine with a disk cannot be forked.
+  virtual std::unique_ptr<MachineBase> fork() const = 0;
+
+  // Writes the stopped machine to a snapshot file, with the same parts as
+  // fork() copies. restore() loads one into a machine that has not run yet
+  // and has as many harts; resume() then continues it.
+  virtual void save(const std::string &path) const = 0;
+
+  virtual void restore(const SnapshotFile &file) = 0;
+
+  // Fast reset for running one guest many times: set_baseline() keeps a
+  // copy of the machine as it is, started if it has not run yet. reset()
+  // brings the machine back to that copy. It copies back only the pages
+  // written since, and keeps decoded instructions, so it costs about what
+  // the run touched. Returns the number of pages copied.
+  virtual void set_baseline() = 0;
+
+  virtual std::size_t reset() = 0;
+
+  // Stops hart 0 before it runs the instruction at pc, see
+  // Hart::set_breakpoint(). run() then returns with pc() there.
+  virtual void set_breakpoint(std::uint64_t pc) = 0;
+
+  // Edge coverage of every hart, see Hart::set_coverage()
+  virtual void set_coverage(std::uint8_t *map) = 0;
+
+  virtual std::size_t harts() const = 0;
+
+  // Of hart 0
+  virtual std::uint64_t pc() const = 0;
+
+  virtual std::uint64_t get_register(std::uint8_t reg) const = 0;
+
+  virtual void set_register(std::uint8_t reg, std::uint64_t value) = 0;
+
+  virtual PhysicalMemory &memory() = 0;
+
+  virtual void set_pc(const std::uint64_t &pc_val) = 0;
+
+  virtual void add_data(const char *data, const std::uint64_t &size,
+                        ELFIO::Elf64_Addr virtual_addr) = 0;
+
+  virtual void set_brk(const std::uint64_t &addr) = 0;
+
+  virtual void add_segment(ELFIO::Elf64_Addr virtual_addr,
+                           const std::uint64_t &size, std::uint32_t flags) = 0;
+
+  virtual void attach_disk(const std::string &path) = 0;
+
+  virtual void configure_tlb(const TlbConfig &config) = 0;
+
+  virtual void set_quantum(std::size_t instructions) = 0;
+
+  // Stops every hart after this many instructions
+  virtual void set_instruction_limit(long limit) = 0;
+
+  // Leaves out the statistics that run() prints at the end
+  virtual void set_quiet(bool quiet) = 0;
+
+  // After run(): instructions retired by all harts, and whether hart 0 was
+  // stopped by the instruction limit rather than by the guest
+  virtual long instructions() const = 0;
+
+  virtual bool out_of_budget() const = 0;
+
+  // Runs one copy of the loaded program per input set, with the numbers of
+  // a set in a0-a7, and returns their exit codes. Copies run width at a time
+  // in lock-step on a WideHart.
+  virtual std::vector<int>
+  run_lanes(const std::vector<std::vector<std::uint64_t>> &inputs,
+            std::size_t width) = 0;
+
+  // Summed over all harts
+  virtual MmuStats mmu_stats() const = 0;
+};
+
+template <int XLEN> class Machine final : public MachineBase {
 private:
-  Hart hart_;
+  struct Segment {
+    std::uint64_t virtual_addr;
+    std::uint64_t size;
+    std::uint32_t flags; // ELF p_flags
+  };
+
+  // Harts keep pointers to themselves, so they are never moved
+  std::vector<std::unique_ptr<Hart<XLEN>>> harts_;
+  Syscalls syscalls_;
+  Clint clint_;
+  VirtioBlk disk_;
+  std::vector<Segment> segments_;
+  std::uint64_t heap_start_ = 0;
+  // Instructions per turn in quantum mode, or 0 for a thread per hart
+  std::size_t quantum_ = 0;
+  bool quiet_ = false;
+  bool prepared_ = false;
+  // The snapshot file this machine was restored from, which save() writes
+  // incremental snapshots on top of
+  std::string snapshot_;
+  std::unique_ptr<Machine> baseline_;
+
+  // Attaches the harts to memory, syscalls and the CLINT
+  void connect();
+
+  // Everything run() does before the harts start, once
+  void prepare();
+
+  void build_page_table();
+
+  // Deterministic mode: harts take turns of quantum_ instructions on the
+  // calling thread
+  void run_quanta();
 
 public:
-  Memory memory_;
-  void run();
+  PhysicalMemory memory_;
+
+  explicit Machine(std::size_t n_harts = 1);
+
+  // Runs hart 0 on the calling thread and every other hart on a thread of
+  // its own, unless a quantum is set. The machine stops when hart 0 exits,
+  // with its exit code.
+  int run() override;
+
+  int resume() override;
+
+  void start() override;
+
+  Yield slice(long budget) override;
+
+  int exit_code() const override { return harts_[0]->exit_code_; }
+
+  std::unique_ptr<MachineBase> fork() const override;
+
+  void save(const std::string &path) const override;
+
+  void restore(const SnapshotFile &file) override;
+
+  void set_baseline() override;
+
+  std::size_t reset() override;
+
+  void set_breakpoint(std::uint64_t pc) override;
+
+  void set_coverage(std::uint8_t *map) override;
 
-  void set_pc(const std::uint64_t &pc_val);
+  std::size_t harts() const override { return harts_.size(); }
+
+  std::uint64_t pc() const override { return harts_[0]->pc; }
+
+  std::uint64_t get_register(std::uint8_t reg) const override {
+    return harts_[0]->gpr_[reg];
+  }
+
+  void set_register(std::uint8_t reg, std::uint64_t value) override;
+
+  PhysicalMemory &memory() override { return memory_; }
+
+  Hart<XLEN> &hart(std::size_t i) { return *harts_[i]; }
+
+  void set_pc(const std::uint64_t &pc_val) override;
 
   void add_data(const char *data, const std::uint64_t &size,
-                ELFIO::Elf64_Addr virtual_addr);
+                ELFIO::Elf64_Addr virtual_addr) override;
+
+  void set_brk(const std::uint64_t &addr) override;
+
+  void add_segment(ELFIO::Elf64_Addr virtual_addr, const std::uint64_t &size,
+                   std::uint32_t flags) override;
+
+  void attach_disk(const std::string &path) override;
+
+  void configure_tlb(const TlbConfig &config) override;
+
+  void set_quantum(std::size_t instructions) override;
+
+  void set_instruction_limit(long limit) override;
+
+  void set_quiet(bool quiet) override;
+
+  long instructions() const override;
+
+  bool out_of_budget() const override { return harts_[0]->out_of_budget(); }
+
+  MmuStats mmu_stats() const override;
+
+  std::vector<int>
+  run_lanes(const std::vector<std::vector<std::uint64_t>> &inputs,
+            std::size_t width) override;
 };
 } // namespace sim
@@ -2,24 +2,101 @@
 
 #include <elfio/elfio.hpp>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include "device.hpp"
+#include "snapshot.hpp"
+#include "xlen.hpp"
 
 namespace sim {
-class Hart;
+template <int XLEN> class Hart;
 
 const long int memory_size = 400000000;
 
-using register_t = uint32_t;
+const uint32_t ACCESS_READ = 0x0;
+const uint32_t ACCESS_EXECUTE = 0x1;
+const uint32_t ACCESS_WRITE = 0x2;
 
-class Memory final {
-private:
-  Hart *hart_;
+// Guest RAM and the MMIO window, addressed physically. Devices and the page
+// walker only need this part, which does not depend on the register width.
+// All harts share one; device accesses are serialized by mmio_mutex_.
+class PhysicalMemory {
+  template <int XLEN> friend class Memory;
+
+protected:
   uint8_t *mem_;
   int position_ = 0;
   bool mmu_enable_;
+  struct MmioPage {
+    Device *device = nullptr;
+    uint32_t base = 0;
+  };
+  std::vector<MmioPage> mmio_pages_;
+  std::mutex mmio_mutex_;
+  // One byte per page. Every write to RAM sets all bits of its page, and
+  // each user of the flags clears only its own bit.
+  std::unique_ptr<uint8_t[]> dirty_;
+
+  const MmioPage *find_device(uint32_t paddr) const;
+  uint64_t mmio_read(uint32_t paddr, int size);
+  bool mmio_write(uint32_t paddr, uint64_t value, int size);
 
 public:
-  Memory();
-  ~Memory();
+  static constexpr std::size_t page_size = 4096;
+  static constexpr std::size_t n_pages =
+      (memory_size + page_size - 1) / page_size;
+
+  // Bits of the dirty flags: pages written since the machine was restored
+  // from a snapshot, and since its reset baseline. The written bit is never
+  // cleared, so it marks every page that was ever written or mapped from a
+  // snapshot file.
+  static constexpr uint8_t dirty_snapshot = 1;
+  static constexpr uint8_t dirty_reset = 2;
+  static constexpr uint8_t dirty_written = 4;
+
+  PhysicalMemory();
+  ~PhysicalMemory();
+  PhysicalMemory(const PhysicalMemory &) = delete;
+  PhysicalMemory &operator=(const PhysicalMemory &) = delete;
+
+  // Copies the RAM of another machine. Devices are not copied.
+  void copy_from(const PhysicalMemory &other);
+
+  // One flag per 4 KiB page of RAM, set if the page may hold something else
+  // than zero: the pages with the written bit. Unlike residency, this does
+  // not change when the host swaps the page out.
+  std::vector<bool> used_pages() const;
+
+  void mark_dirty(uint32_t paddr, std::size_t size) {
+    for (std::size_t page = paddr / page_size; page * page_size < paddr + size;
+         ++page) {
+      dirty_[page] = 0xFF;
+    }
+  }
+
+  // Pages with the dirty bit set, in ascending order
+  std::vector<uint32_t> dirty_pages(uint8_t bit) const;
+
+  void clear_dirty(uint8_t bit);
+
+  // Copies these pages back from the RAM of another machine and clears
+  // their dirty bit
+  void copy_pages_from(const PhysicalMemory &other,
+                       const std::vector<uint32_t> &pages, uint8_t bit);
+
+  const uint8_t *data() const { return mem_; }
+
+  // Maps size bytes of a file at offset over RAM at paddr, copy-on-write.
+  // Offset, paddr and size are page aligned. The pages count as written.
+  void map_file(int fd, uint64_t offset, uint32_t paddr, std::size_t size);
+
+  // The loader's view of RAM, not its contents
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
 
   std::uint64_t virtual_addr_{std::numeric_limits<int64_t>::max()};
 
@@ -36,27 +113,93 @@ public:
 
   void set_virtual_address(ELFIO::Elf64_Addr virtual_addr);
 
-  uint8_t read_byte(register_t addr);
+  void write_physical_byte(uint32_t paddr, uint8_t value);
+  void write_physical_word(uint32_t paddr, uint32_t value);
+  uint8_t read_physical_byte(uint32_t paddr) const;
+  uint16_t read_physical_half(uint32_t paddr) const;
+  uint32_t read_physical_word(uint32_t paddr) const;
 
-  uint16_t read_halfword(register_t addr);
+  // Host pointer to the physical range [paddr, paddr + size) for device DMA,
+  // or nullptr if the range is not entirely inside RAM. Only the writable
+  // pointer marks the range as written.
+  const uint8_t *physical_ptr(uint32_t paddr, std::size_t size) const;
+  uint8_t *writable_ptr(uint32_t paddr, std::size_t size);
 
-  uint32_t read_word(register_t addr);
+  // Maps [base, base + size) of the MMIO window to a device. Accesses that
+  // miss RAM are routed by page, so RAM accesses pay nothing for devices.
+  void add_device(uint32_t base, uint32_t size, Device *device);
+};
 
-  uint64_t read_doubleword(register_t addr);
+// Guest memory as seen by one hart: virtual accesses are translated by its
+// MMU, then go to the physical memory shared by all harts. RAM accesses are
+// single host loads and stores, so naturally aligned ones are single-copy
+// atomic as RVWMO requires.
+template <int XLEN> class Memory final {
+private:
+  using register_t = typename Xlen<XLEN>::reg;
 
-  bool write_byte(uint8_t value, const std::uint64_t &addr);
+  PhysicalMemory *phys_ = nullptr;
+  uint8_t *mem_ = nullptr;
+  uint8_t *dirty_ = nullptr;
+  Hart<XLEN> *hart_ = nullptr;
 
-  bool write_halfword(uint16_t value, const std::uint64_t &addr);
+  // Stores are never larger than a page, so they touch at most two
+  void mark_dirty(uint32_t paddr, std::size_t size) {
+    dirty_[paddr / PhysicalMemory::page_size] = 0xFF;
+    dirty_[(paddr + size - 1) / PhysicalMemory::page_size] = 0xFF;
+  }
 
-  bool write_word(uint32_t value, const std::uint64_t &addr);
+public:
+  uint8_t read_byte(register_t addr);
 
-  bool write_doubleword(uint64_t value, const std::uint64_t &addr);
+  uint16_t read_halfword(register_t addr);
 
-  void write_physical_byte(uint32_t paddr, uint8_t value);
-  void write_physical_word(uint32_t paddr, uint32_t value);
-  uint8_t read_physical_byte(uint32_t paddr) const;
-  uint32_t read_physical_word(uint32_t paddr) const;
+  uint32_t read_word(register_t addr);
+
+  uint64_t read_doubleword(register_t addr);
 
-  void set_hart(Hart *hart);
+  bool write_byte(uint8_t value, register_t addr);
+
+  bool write_halfword(uint16_t value, register_t addr);
+
+  bool write_word(uint32_t value, register_t addr);
+
+  bool write_doubleword(uint64_t value, register_t addr);
+
+  // Splits the guest buffer [addr, addr + size) into host pointers into RAM,
+  // merging pages that are physically contiguous. Used to pass guest buffers
+  // to the host kernel without copying. A page fault only makes it return
+  // false, without a trap.
+  bool host_iovec(register_t addr, std::size_t size, uint32_t access_type,
+                  std::vector<iovec> &iov);
+
+  // Copies the guest range [addr, addr + size) to or from a host buffer a
+  // page at a time, with one memcpy per page of RAM. Returns false if a page
+  // faults.
+  bool read_block(register_t addr, uint8_t *dst, std::size_t size);
+  bool write_block(const uint8_t *src, register_t addr, std::size_t size);
+
+  // Host pointer for an atomic access of size bytes at addr. Returns false if
+  // the page faults. ptr is nullptr if addr is misaligned or outside RAM,
+  // where host atomics cannot reach.
+  bool atomic_ptr(register_t addr, std::size_t size, uint32_t access_type,
+                  uint8_t *&ptr);
+
+  // A NUL-terminated string of at most a page, without trapping like
+  // host_iovec()
+  bool read_string(register_t addr, std::string &str);
+
+  // Physical accesses that bypass translation, for fetch and the page walker
+  uint16_t read_physical_half(uint32_t paddr) const {
+    return phys_->read_physical_half(paddr);
+  }
+  const uint8_t *physical_ptr(uint32_t paddr, std::size_t size) const {
+    return phys_->physical_ptr(paddr, size);
+  }
+  uint8_t *writable_ptr(uint32_t paddr, std::size_t size) {
+    return phys_->writable_ptr(paddr, size);
+  }
+
+  void attach(PhysicalMemory *phys, Hart<XLEN> *hart);
 };
 } // namespace sim
\ No newline at end of file
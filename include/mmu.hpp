@@ -5,73 +5,144 @@
 #include <optional>
 #include <vector>
 
-namespace sim {
-
-class Hart;
+#include "snapshot.hpp"
+#include "tlb.hpp"
+#include "xlen.hpp"
 
-constexpr uint32_t PTE_V = 1 << 0; // Valid
-constexpr uint32_t PTE_R = 1 << 1; // Readable
-constexpr uint32_t PTE_W = 1 << 2; // Writable
-constexpr uint32_t PTE_X = 1 << 3; // Executable
-constexpr uint32_t PTE_U = 1 << 4; // User accessible
-constexpr uint32_t PTE_G = 1 << 5; // Global
-constexpr uint32_t PTE_A = 1 << 6; // Accessed
-constexpr uint32_t PTE_D = 1 << 7; // Dirty
+namespace sim {
 
-struct TLBEntry {
-  bool valid = false;
-  uint32_t virtual_page;
-  uint32_t physical_page;
-  uint32_t flags;
-  uint32_t asid;
-};
+template <int XLEN> class Hart;
 
 struct PageTableEntry {
   bool valid = false;
-  uint32_t ppn;
+  uint64_t ppn;
   uint32_t flags; // R, W, X, U, G, A, D
 };
 
-class MMU {
+// Translation scheme of each register width: Sv32 for RV32, Sv39 for RV64
+template <int XLEN> struct PagingMode;
+
+template <> struct PagingMode<32> {
+  static constexpr uint32_t levels = 2;
+  static constexpr uint32_t vpn_bits = 10;
+  static constexpr uint32_t pte_size = 4;
+  static constexpr uint64_t ppn_mask = 0x3FFFFF;
+  static constexpr uint32_t satp_asid_shift = 22;
+  static constexpr uint32_t satp_asid_mask = 0x1FF;
+  static constexpr uint32_t satp_mode_shift = 31;
+  static constexpr uint32_t satp_mode = 1;
+};
+
+template <> struct PagingMode<64> {
+  static constexpr uint32_t levels = 3;
+  static constexpr uint32_t vpn_bits = 9;
+  static constexpr uint32_t pte_size = 8;
+  static constexpr uint64_t ppn_mask = 0xFFFFFFFFFFF;
+  static constexpr uint32_t satp_asid_shift = 44;
+  static constexpr uint32_t satp_asid_mask = 0xFFFF;
+  static constexpr uint32_t satp_mode_shift = 60;
+  static constexpr uint32_t satp_mode = 8;
+};
+
+// Translation counters of one hart
+struct MmuStats {
+  uint64_t itlb_hits = 0;
+  uint64_t itlb_misses = 0;
+  uint64_t dtlb_hits = 0;
+  uint64_t dtlb_misses = 0;
+  uint64_t walk_cache_hits = 0;
+  uint64_t page_faults = 0;
+
+  MmuStats &operator+=(const MmuStats &other);
+};
+
+template <int XLEN> class MMU final {
 private:
-  static constexpr size_t TLB_SIZE = 64;
-  std::array<TLBEntry, TLB_SIZE> tlb_;
-  size_t tlb_pointer_ = 0;
+  using register_t = typename Xlen<XLEN>::reg;
+  using sregister_t = typename Xlen<XLEN>::sreg;
+  using Mode = PagingMode<XLEN>;
+
+  static constexpr uint32_t va_bits = 12 + Mode::levels * Mode::vpn_bits;
+  static constexpr uint32_t vpn_index_mask = (1u << Mode::vpn_bits) - 1;
+
+  static constexpr size_t default_tlb_entries = 64;
+  static constexpr size_t default_tlb_ways = 4;
+  TLB itlb_{default_tlb_entries, default_tlb_ways, Mode::vpn_bits};
+  TLB dtlb_{default_tlb_entries, default_tlb_ways, Mode::vpn_bits};
 
-  uint32_t satp_ = 0;
+  register_t satp_ = 0;
 
   uint32_t mode_ = 0;
 
-  uint64_t tlb_hits_ = 0;
-  uint64_t tlb_misses_ = 0;
+  // Pointers to last-level tables, keyed by root table and the VPN bits above
+  // level 0, so a TLB miss usually costs a single PTE read
+  struct WalkCacheEntry {
+    bool valid = false;
+    uint64_t root_ppn;
+    uint32_t vpn_high;
+    uint64_t table_ppn;
+  };
+  static constexpr size_t walk_cache_size = 32;
+  std::array<WalkCacheEntry, walk_cache_size> walk_cache_;
+
+  uint64_t walk_cache_hits_ = 0;
   uint64_t page_faults_ = 0;
-  Hart *hart_;
+  Hart<XLEN> *hart_;
+
+  static uint64_t page_offset_mask(uint32_t level) {
+    return (uint64_t{1} << (12 + level * Mode::vpn_bits)) - 1;
+  }
 
   bool check_permissions(uint32_t pte_flags, uint32_t access_type);
 
+  void update_accessed_dirty(uint32_t pte_addr, PageTableEntry &pte,
+                             uint32_t access_type);
+
+  void walk_cache_clear();
+
 public:
   MMU();
 
   void init_tlb();
 
-  void set_hart(Hart *hart);
+  // Reconfigures both the instruction and the data TLB, dropping their
+  // contents
+  void configure_tlb(const TlbConfig &config);
+
+  // Takes over satp and the page-walk cache of another MMU, which must
+  // translate through identical page tables. The TLBs keep their own
+  // configuration and start empty.
+  void copy_from(const MMU &other);
+
+  // Only satp is saved; TLBs and the walk cache start cold after restore
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+
+  void set_hart(Hart<XLEN> *hart);
 
   void dump_tlb() const;
 
-  bool translate(uint32_t vaddr, uint32_t &paddr, uint32_t access_type,
+  bool translate(register_t vaddr, uint32_t &paddr, uint32_t access_type,
                  bool &page_fault);
 
-  void tlb_add(uint32_t vaddr, uint32_t paddr, uint32_t flags, uint32_t asid);
+  void tlb_add(uint32_t vpn, uint32_t ppn, uint32_t flags, uint32_t asid,
+               uint32_t access_type, uint32_t level);
   void tlb_clear();
-  void tlb_remove(uint32_t vaddr, uint32_t asid);
 
-  void set_satp(uint32_t value);
-  uint32_t get_satp() const;
+  // sfence.vma: drops the translations of one page and/or one address space
+  // from both TLBs and the page-walk cache. Global mappings survive an
+  // ASID-only fence.
+  void sfence_vma(bool has_vaddr, register_t vaddr, bool has_asid,
+                  register_t asid);
+
+  void set_satp(register_t value);
+  register_t get_satp() const;
 
   bool read_pte(uint32_t pte_addr, PageTableEntry &pte);
   bool write_pte(uint32_t pte_addr, const PageTableEntry &pte);
 
   void dump_stats() const;
+  MmuStats stats() const;
 };
 
-} // namespace sim
\ No newline at end of file
+} // namespace sim
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "memory.hpp"
+#include "mmu.hpp"
+
+namespace sim {
+// Builds Sv32 (RV32) or Sv39 (RV64) page tables directly in guest RAM. Tables
+// are bump-allocated from [base, base + size), and PTEs are written whole.
+// Ranges whose virtual and physical addresses are aligned to a superpage are
+// mapped with superpages.
+template <int XLEN> class PageTableBuilder final {
+private:
+  using Mode = PagingMode<XLEN>;
+
+  PhysicalMemory &mem_;
+  uint32_t root_;
+  uint32_t next_table_;
+  uint32_t limit_;
+
+  uint64_t read_pte(uint32_t addr) const;
+
+  void write_pte(uint32_t addr, uint64_t value);
+
+  uint32_t alloc_table();
+
+public:
+  static constexpr uint32_t page_size = 1 << 12;
+
+  PageTableBuilder(PhysicalMemory &mem, uint32_t base, uint32_t size);
+
+  // Maps [vaddr, vaddr + size) to [paddr, paddr + size), widened to whole
+  // pages. flags are the R/W/X/U/G bits; V, A and D (for writable pages) are
+  // added so that the walker never has to write them back. Pages that are
+  // already mapped to the same frame get the union of permissions.
+  void map(uint64_t vaddr, uint32_t paddr, uint64_t size, uint32_t flags);
+
+  typename Xlen<XLEN>::reg satp(uint32_t asid = 0) const;
+};
+} // namespace sim
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace sim {
+class PhysicalMemory;
+
+// Registers and the rest of the small state of a machine. Every part writes
+// its fields in a fixed order and reads them back in the same order. Values
+// are stored as host bytes, so a snapshot is read on the kind of host that
+// wrote it.
+class StateWriter final {
+private:
+  std::vector<uint8_t> data_;
+
+public:
+  template <typename T> void put(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "state is stored as plain bytes");
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(T));
+  }
+
+  const std::vector<uint8_t> &data() const { return data_; }
+};
+
+class StateReader final {
+private:
+  const uint8_t *pos_;
+  const uint8_t *end_;
+
+public:
+  StateReader(const uint8_t *data, std::size_t size)
+      : pos_(data), end_(data + size) {}
+
+  template <typename T> void get(T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "state is stored as plain bytes");
+    if (static_cast<std::size_t>(end_ - pos_) < sizeof(T)) {
+      throw std::runtime_error("Snapshot state is truncated");
+    }
+    std::memcpy(&value, pos_, sizeof(T));
+    pos_ += sizeof(T);
+  }
+
+  template <typename T> T get() {
+    T value;
+    get(value);
+    return value;
+  }
+};
+
+// Snapshot file of a stopped machine: a header, the machine state, the path
+// of the parent snapshot if any, a map of the stored RAM pages, then those
+// pages. A full snapshot stores the pages that are not zero, an incremental
+// one the pages written since the machine was restored from its parent.
+// Identical pages are stored once. Pages start at page boundaries of the
+// file, so restore maps them into RAM copy-on-write, and a page is only read
+// from disk when the guest first touches it.
+class SnapshotFile final {
+private:
+  struct Header {
+    char magic[8];
+    uint32_t xlen;
+    uint32_t harts;
+    uint64_t state_size;
+    uint64_t parent_size;
+    uint64_t n_pages;
+    uint64_t data_offset;
+  };
+
+  struct PageEntry {
+    uint32_t page;
+    // Index of the stored copy in the data area
+    uint32_t blob;
+  };
+
+  int fd_ = -1;
+  std::string path_;
+  Header header_{};
+  std::vector<uint8_t> state_;
+  std::string parent_;
+  std::vector<PageEntry> pages_;
+
+public:
+  static constexpr std::size_t page_size = 4096;
+
+  // Pages are scanned and written in parallel, one thread per host CPU.
+  // With a parent, only the given pages are stored. The file is written
+  // next to path and renamed over it once complete.
+  static void write(const std::string &path, int xlen, std::size_t n_harts,
+                    const StateWriter &state, const PhysicalMemory &memory,
+                    const std::string &parent = {},
+                    const std::vector<uint32_t> &pages = {});
+
+  // Reads the header, state and page map. Pages are left in the file.
+  explicit SnapshotFile(const std::string &path);
+  ~SnapshotFile();
+  SnapshotFile(const SnapshotFile &) = delete;
+  SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+  int xlen() const { return static_cast<int>(header_.xlen); }
+  std::size_t harts() const { return header_.harts; }
+
+  // Absolute
+  const std::string &path() const { return path_; }
+
+  StateReader state() const { return {state_.data(), state_.size()}; }
+
+  // Maps the stored pages over the RAM of a machine that has not run yet,
+  // those of the parents first
+  void map_memory(PhysicalMemory &memory) const;
+};
+} // namespace sim
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "machine.hpp"
+#include "tlb.hpp"
+
+namespace sim {
+// TLB design-space sweep. The program runs once up to the fast-forward
+// point, then the stopped machine is forked once per configuration and the
+// forks run the next region in parallel, one thread each. RAM, decoded
+// instructions and the page-walk cache are copied, so only the TLBs start
+// cold.
+class Sweep final {
+private:
+  long fast_forward_;
+  long region_;
+  std::vector<TlbConfig> configs_;
+
+public:
+  Sweep(long fast_forward, long region, std::vector<TlbConfig> configs);
+
+  // Runs a loaded machine that has not started yet and prints the TLB hit
+  // rates of every configuration side by side. Returns the exit code if the
+  // program ends during the fast-forward, otherwise 0.
+  int run(MachineBase &machine) const;
+};
+} // namespace sim
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "memory.hpp"
+
+namespace sim {
+template <int XLEN> class Hart;
+
+// Linux RISC-V syscall numbers (asm-generic/unistd.h)
+namespace sysno {
+constexpr uint32_t openat = 56;
+constexpr uint32_t close = 57;
+constexpr uint32_t lseek = 62;
+constexpr uint32_t read = 63;
+constexpr uint32_t write = 64;
+constexpr uint32_t fstat = 80;
+constexpr uint32_t exit = 93;
+constexpr uint32_t exit_group = 94;
+constexpr uint32_t clock_gettime = 113;
+constexpr uint32_t gettimeofday = 169;
+constexpr uint32_t brk = 214;
+constexpr uint32_t munmap = 215;
+constexpr uint32_t mmap = 222;
+} // namespace sysno
+
+// User-mode emulation of the Linux syscall ABI: number in a7, arguments in
+// a0-a5, result (or -errno) in a0. File descriptors are host descriptors.
+// Shared by both register widths; guest addresses are kept as 64-bit.
+// Harts share one instance. Only the heap and mmap state is locked, so a
+// hart blocked in read() holds up no other hart's syscalls.
+class Syscalls final {
+private:
+  // Guards the break and the mmap area
+  std::mutex mutex_;
+  uint64_t brk_start_ = 0;
+  uint64_t brk_ = 0;
+  uint64_t mmap_top_ = 0;
+  uint64_t mmap_bottom_ = 0;
+  // The highest break and the lowest mmap ever handed out. Only memory
+  // between them and the starts may hold data; above and below, RAM has
+  // never been given to the guest and is still zero.
+  uint64_t brk_high_ = 0;
+  uint64_t mmap_low_ = 0;
+
+  template <int XLEN> uint64_t sys_read(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_write(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_openat(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_fstat(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_brk(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_mmap(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_munmap(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_clock_gettime(Hart<XLEN> *hart);
+  template <int XLEN> uint64_t sys_gettimeofday(Hart<XLEN> *hart);
+
+  template <int XLEN>
+  bool copy_to_guest(Hart<XLEN> *hart, uint64_t addr, const void *data,
+                     std::size_t size);
+  template <int XLEN>
+  bool zero_guest(Hart<XLEN> *hart, uint64_t addr, std::size_t size);
+  // Zeroes the parts of [addr, addr + size) that were handed out before, so
+  // that memory which was never used is not touched
+  template <int XLEN>
+  bool zero_reused(Hart<XLEN> *hart, uint64_t addr, uint64_t size);
+
+public:
+  static constexpr uint32_t stack_size = 8 * 1024 * 1024;
+
+  // Program break starts right after the highest loaded segment; anonymous
+  // mmaps are carved downwards from below the stack.
+  void set_brk(uint64_t addr);
+  void set_mmap_top(uint64_t addr);
+
+  // Takes over the heap and mmap area of another machine
+  void copy_from(const Syscalls &other);
+
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+
+  template <int XLEN> void handle(Hart<XLEN> *hart);
+};
+} // namespace sim
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sim {
+constexpr uint32_t PTE_V = 1 << 0; // Valid
+constexpr uint32_t PTE_R = 1 << 1; // Readable
+constexpr uint32_t PTE_W = 1 << 2; // Writable
+constexpr uint32_t PTE_X = 1 << 3; // Executable
+constexpr uint32_t PTE_U = 1 << 4; // User accessible
+constexpr uint32_t PTE_G = 1 << 5; // Global
+constexpr uint32_t PTE_A = 1 << 6; // Accessed
+constexpr uint32_t PTE_D = 1 << 7; // Dirty
+
+struct TLBEntry {
+  bool valid = false;
+  uint32_t virtual_page; // VPN with the bits below the page level dropped
+  uint32_t physical_page;
+  uint32_t flags;
+  uint32_t asid;
+  uint32_t level; // 0 for a 4 KiB page, higher for superpages
+};
+
+// Victim selection inside a set once all of its ways are valid
+enum class TlbPolicy { plru, fifo, random };
+
+// Geometry and replacement policy of a TLB, written "64:4" or "64:4:fifo"
+struct TlbConfig {
+  std::size_t entries = 64;
+  std::size_t ways = 4;
+  TlbPolicy policy = TlbPolicy::plru;
+
+  static TlbConfig parse(const std::string &text);
+  std::string name() const;
+};
+
+// Set-associative TLB indexed by the low VPN bits, with tree pseudo-LRU,
+// FIFO or random replacement inside a set. A lookup probes exactly one set,
+// so its cost depends on the associativity only, not on the number of
+// entries.
+class TLB final {
+private:
+  std::vector<TLBEntry> entries_;
+  // PLRU tree bits, or the next way to evict under FIFO
+  std::vector<uint64_t> plru_;
+  std::size_t sets_ = 0;
+  std::size_t ways_ = 0;
+  uint32_t set_mask_ = 0;
+  uint32_t level_bits_;
+  TlbPolicy policy_ = TlbPolicy::plru;
+  // xorshift state of the random policy, fixed so that runs are repeatable
+  uint64_t random_ = 0x9E3779B97F4A7C15;
+
+  // Highest superpage level currently cached, so that TLBs without
+  // superpages probe a single set
+  uint32_t max_level_ = 0;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  TLBEntry *probe(uint32_t tag, uint32_t level, uint32_t asid) {
+    std::size_t set = tag & set_mask_;
+    TLBEntry *base = &entries_[set * ways_];
+    for (std::size_t way = 0; way < ways_; ++way) {
+      TLBEntry &entry = base[way];
+      if (entry.valid && entry.virtual_page == tag && entry.level == level &&
+          ((entry.flags & PTE_G) || entry.asid == asid)) {
+        touch(set, way);
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  void touch(std::size_t set, std::size_t way);
+
+  std::size_t victim(std::size_t set);
+
+public:
+  static constexpr std::size_t max_ways = 64;
+
+  // level_bits is the number of VPN bits per page-table level: 10 for Sv32,
+  // 9 for Sv39
+  TLB(std::size_t entries, std::size_t ways, uint32_t level_bits);
+
+  // Both sizes must be powers of two, with ways <= entries. Drops the
+  // contents and the hit and miss counts.
+  void configure(std::size_t entries, std::size_t ways,
+                 TlbPolicy policy = TlbPolicy::plru);
+
+  // 4 KiB entries are indexed by the full VPN and superpages by the VPN bits
+  // above their level, so a lookup is one set probe per cached level
+  TLBEntry *lookup(uint32_t vpn, uint32_t asid) {
+    TLBEntry *entry = probe(vpn, 0, asid);
+    for (uint32_t level = 1; !entry && level <= max_level_; ++level) {
+      entry = probe(vpn >> (level * level_bits_), level, asid);
+    }
+    if (entry) {
+      ++hits_;
+    } else {
+      ++misses_;
+    }
+    return entry;
+  }
+
+  void insert(uint32_t vpn, uint32_t ppn, uint32_t flags, uint32_t asid,
+              uint32_t level);
+
+  // Drops every entry (4 KiB or superpage) translating vpn. With match_asid
+  // set, only non-global entries of that address space are dropped.
+  void remove(uint32_t vpn, bool match_asid, uint32_t asid);
+
+  // Drops all non-global entries of an address space
+  void remove_asid(uint32_t asid);
+
+  void clear();
+
+  std::size_t size() const { return entries_.size(); }
+  std::size_t ways() const { return ways_; }
+  TlbPolicy policy() const { return policy_; }
+  const std::vector<TLBEntry> &entries() const { return entries_; }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+};
+} // namespace sim
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "snapshot.hpp"
+#include "vector_kernels.hpp"
+#include "xlen.hpp"
+
+namespace sim {
+template <int XLEN> class Hart;
+
+constexpr uint32_t vlen = 256;
+constexpr uint32_t vlenb = vlen / 8;
+
+// funct3 of the OP-V major opcode
+constexpr uint32_t OPIVV = 0x0;
+constexpr uint32_t OPMVV = 0x2;
+constexpr uint32_t OPIVI = 0x3;
+constexpr uint32_t OPIVX = 0x4;
+constexpr uint32_t OPMVX = 0x6;
+constexpr uint32_t OPCFG = 0x7;
+
+// Element width in bytes of a vector load or store, from its width field
+inline uint32_t vector_eew(uint32_t width) {
+  return width == 0 ? 1 : 1u << (width - 4);
+}
+
+// Vector register file and vector CSRs of a hart, for a subset of RVV 1.0:
+// integer arithmetic, logic, compares, reductions and mask operations.
+// Register groups are contiguous in vreg_, so an instruction hands vl
+// elements to a single host kernel whatever LMUL is. Tail and inactive
+// elements are always left undisturbed, and vstart is not resumed from.
+class VectorUnit final {
+private:
+  alignas(32) std::array<uint8_t, 32 * vlenb> vreg_{};
+  // A splatted scalar operand, and results of masked operations before they
+  // are merged into the destination
+  alignas(32) std::array<uint8_t, 8 * vlenb> operand_{};
+  alignas(32) std::array<uint8_t, 8 * vlenb> result_{};
+  // v0 at the start of a masked instruction, which may overwrite it
+  std::array<uint8_t, vlenb> mask_{};
+  const VectorKernels *kernels_ = &vector_kernels();
+
+  uint64_t vl_ = 0;
+  uint64_t vtype_ = 0;
+  bool vill_ = true;
+  uint32_t sew_ = 1;
+  uint64_t vstart_ = 0;
+
+  bool active(std::size_t i) const { return mask_[i / 8] >> (i % 8) & 1; }
+  void save_mask();
+
+  bool elementwise(VectorOp op, uint8_t vd, const uint8_t *a,
+                   const uint8_t *b, bool masked);
+  bool compare(uint32_t funct6, uint8_t vd, uint8_t vs2,
+               const uint8_t *operand, bool masked);
+  bool merge(uint8_t vd, uint8_t vs2, const uint8_t *operand, bool masked);
+  bool reduce(uint32_t funct6, uint8_t vd, uint8_t vs2, uint8_t vs1,
+              bool masked);
+  bool mask_logical(uint32_t funct6, uint8_t vd, uint8_t vs2, uint8_t vs1,
+                    bool masked);
+  bool id(uint8_t vd, bool masked);
+
+public:
+  uint64_t vl() const { return vl_; }
+  // vtype without vill, which the CSR read places at XLEN - 1
+  uint64_t vtype() const { return vtype_; }
+  bool vill() const { return vill_; }
+  uint32_t sew() const { return sew_; }
+  uint64_t vstart() const { return vstart_; }
+  void set_vstart(uint64_t value) { vstart_ = value; }
+
+  void save(StateWriter &out) const;
+  void restore(StateReader &in);
+  const char *isa() const { return kernels_->isa; }
+
+  uint8_t *reg(uint8_t v) { return vreg_.data() + v * vlenb; }
+  // Element i of the mask in v0
+  bool mask_bit(std::size_t i) const { return vreg_[i / 8] >> (i % 8) & 1; }
+  // Whether a group of bytes starting at register v stays inside the file
+  bool fits(uint8_t v, std::size_t bytes) const {
+    return v * vlenb + bytes <= vreg_.size();
+  }
+  // Register group v as a source of vl elements, or nullptr if it does not
+  // fit
+  const uint8_t *source(uint8_t v) {
+    return fits(v, vl_ * sew_) ? reg(v) : nullptr;
+  }
+
+  // vsetvl{i}: sets vtype and returns the new vl for the requested AVL
+  uint64_t set_vtype(uint64_t vtype, uint64_t avl);
+
+  // Fills the operand buffer with vl copies of a scalar
+  const uint8_t *splat(uint64_t value);
+
+  // Whether funct6 is implemented under an OP-V funct3
+  static bool implemented(uint32_t funct3, uint32_t funct6);
+  // .vi forms that take an unsigned immediate
+  static bool unsigned_immediate(uint32_t funct6);
+
+  // OPIVV/OPIVX/OPIVI: vd = vs2 op operand, where operand is vs1 or a splat.
+  // Returns false for an illegal instruction.
+  bool opi(uint32_t funct6, uint8_t vd, uint8_t vs2, const uint8_t *operand,
+           bool masked);
+  // OPMVV/OPMVX forms that write a vector register
+  bool opm(uint32_t funct6, uint8_t vd, uint8_t vs2, uint8_t vs1,
+           const uint8_t *operand, bool masked);
+
+  // Element 0 of vs2, sign-extended (vmv.x.s)
+  int64_t scalar(uint8_t vs2) const;
+  // Writes element 0 of vd when vl is not zero (vmv.s.x)
+  void set_scalar(uint8_t vd, uint64_t value);
+  // vcpop.m and vfirst.m
+  uint64_t cpop(uint8_t vs2, bool masked);
+  int64_t first(uint8_t vs2, bool masked);
+};
+
+// Handlers of the vector instructions, called by decode() in cached.cpp.
+// They are written by hand rather than generated from the DSL, because their
+// operands do not fit its instruction formats.
+template <int XLEN> struct VectorInstructions final {
+  using register_t = typename Xlen<XLEN>::reg;
+  using sregister_t = typename Xlen<XLEN>::sreg;
+
+  static void exec_vsetvli(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vsetivli(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vsetvl(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vle(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vse(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vlse(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_vsse(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_opivv(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_opivx(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_opivi(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_opmvv(Hart<XLEN> *hart, uint32_t instr);
+  static void exec_opmvx(Hart<XLEN> *hart, uint32_t instr);
+};
+} // namespace sim
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sim {
+// Element-wise integer operations that have a host kernel. The first operand
+// is vs2, the second vs1 or a splatted scalar.
+enum class VectorOp {
+  add,
+  sub,
+  and_,
+  or_,
+  xor_,
+  mul,
+  minu,
+  min,
+  maxu,
+  max,
+  sll,
+  srl,
+  sra,
+  count
+};
+
+// Computes n elements of dst = a op b. Operands are packed little-endian
+// element arrays and may alias each other.
+using VectorKernel = void (*)(uint8_t *dst, const uint8_t *a,
+                              const uint8_t *b, std::size_t n);
+
+struct VectorKernels {
+  const char *isa;
+  // Indexed by operation and log2 of the element width in bytes
+  VectorKernel op[static_cast<std::size_t>(VectorOp::count)][4];
+
+  VectorKernel get(VectorOp operation, uint32_t sew) const {
+    return op[static_cast<std::size_t>(operation)][sew_index(sew)];
+  }
+
+  static std::size_t sew_index(uint32_t sew) {
+    return sew == 1 ? 0 : sew == 2 ? 1 : sew == 4 ? 2 : 3;
+  }
+};
+
+// The best kernels for the host CPU, picked once at startup: AVX2, then SSE2,
+// then plain loops
+const VectorKernels &vector_kernels();
+} // namespace sim
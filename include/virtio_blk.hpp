@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "device.hpp"
+#include "memory.hpp"
+
+namespace sim {
+constexpr uint32_t virtio_blk_base = mmio_base + 0x01000000;
+
+// virtio-mmio (version 2) block device with a single request queue. The
+// backing image is mmap'ed, so requests are served by copying straight
+// between guest RAM and the mapping. Requests complete synchronously on
+// QueueNotify and are signalled through the machine external interrupt.
+class VirtioBlk final : public Device {
+private:
+  struct Queue {
+    uint32_t num = 0;
+    bool ready = false;
+    uint32_t desc = 0;
+    uint32_t avail = 0;
+    uint32_t used = 0;
+    uint16_t last_avail = 0;
+  };
+
+  PhysicalMemory *mem_ = nullptr;
+  InterruptLines *irq_ = nullptr;
+
+  int fd_ = -1;
+  uint8_t *image_ = nullptr;
+  std::size_t image_size_ = 0;
+  bool read_only_ = false;
+
+  Queue queue_;
+  uint32_t status_ = 0;
+  uint32_t interrupt_status_ = 0;
+  uint32_t device_features_sel_ = 0;
+  uint32_t driver_features_sel_ = 0;
+  uint64_t driver_features_ = 0;
+
+  uint64_t features() const;
+
+  uint64_t config_read(uint32_t offset, int size) const;
+
+  void reset();
+
+  void process_queue();
+
+  uint32_t process_request(uint16_t head, uint32_t &written);
+
+public:
+  static constexpr uint32_t size = 0x1000;
+  static constexpr uint32_t queue_num_max = 256;
+  static constexpr uint32_t sector_size = 512;
+
+  VirtioBlk() = default;
+  VirtioBlk(const VirtioBlk &) = delete;
+  VirtioBlk &operator=(const VirtioBlk &) = delete;
+  ~VirtioBlk() override;
+
+  void open(const std::string &path);
+
+  bool is_open() const { return image_ != nullptr; }
+
+  void attach(PhysicalMemory *mem, InterruptLines *irq);
+
+  uint64_t read(uint32_t offset, int size) override;
+
+  void write(uint32_t offset, uint64_t value, int size) override;
+};
+} // namespace sim
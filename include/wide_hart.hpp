@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "vector_kernels.hpp"
+#include "xlen.hpp"
+
+namespace sim {
+template <int XLEN> class Machine;
+
+// Runs the same program on up to max_lanes copies of a machine in lock-step.
+// Registers are kept as structure of arrays, one array of lanes per
+// register, so an ALU instruction is decoded once and computed for all lanes
+// by a host SIMD kernel. Each lane keeps its own memory and scalar hart.
+// A lane is split off into its scalar hart when its control flow leaves the
+// others, and all lanes are when an instruction outside RV32IM/RV64IM
+// (except for ecall and fence) comes up. Split lanes are resumed afterwards.
+template <int XLEN> class WideHart final {
+public:
+  static constexpr std::size_t max_lanes = 16;
+
+private:
+  using register_t = typename Xlen<XLEN>::reg;
+  using sregister_t = typename Xlen<XLEN>::sreg;
+  using Lanes = std::array<register_t, max_lanes>;
+
+  enum class Kind : uint8_t {
+    op,      // vector kernel on rs1 and rs2
+    op_imm,  // vector kernel on rs1 and imm
+    slt,     // set if less than rs2, or imm without use_rs2
+    sltu,
+    muldiv,  // mulh*, div* and rem* by funct3
+    word,    // RV64 addw, subw and shifts, by funct3
+    muldivw, // RV64 mulw, div*w and rem*w, by funct3
+    lui,
+    auipc,
+    jal,
+    jalr,
+    branch,
+    load,
+    store,
+    ecall,
+    nop,
+    scalar   // anything else: every lane has to split
+  };
+
+  struct Instruction {
+    Kind kind = Kind::scalar;
+    VectorOp op = VectorOp::add;
+    uint8_t rd = 0;
+    uint8_t rs1 = 0;
+    uint8_t rs2 = 0;
+    uint8_t funct3 = 0;
+    bool use_rs2 = false;
+    bool alt = false; // sub, sra and their word forms
+    uint32_t length = 4;
+    register_t imm = 0;
+  };
+
+  alignas(32) std::array<Lanes, 32> x_{};
+  alignas(32) Lanes operand_{};
+  std::vector<Machine<XLEN> *> lanes_;
+  // Lanes still running in lock-step, one bit each
+  uint32_t active_ = 0;
+  register_t pc_ = 0;
+  long n_instructions_ = 0;
+  long lane_instructions_ = 0;
+  std::vector<std::size_t> split_;
+  std::unordered_map<register_t, Instruction> decoded_;
+  const VectorKernels &kernels_ = vector_kernels();
+
+  // The decoded instruction at pc_, or nullptr if it is outside RAM
+  const Instruction *fetch();
+  static Instruction decode(uint32_t bits, uint32_t length);
+
+  // Hands a lane over to its scalar hart, which continues at pc
+  void split(std::size_t lane, register_t pc);
+  void split_all();
+  void retire();
+  // Keeps the lanes whose next pc is the most common one in lock-step
+  void diverge(const Lanes &next_pc);
+
+  // Returns false if the instruction cannot run in lock-step, before it
+  // has changed anything
+  bool execute(const Instruction &instr);
+  static bool branch_taken(uint32_t funct3, register_t a, register_t b);
+  void muldiv(const Instruction &instr, Lanes &rd, const Lanes &rs1,
+              const Lanes &rs2);
+  void word(const Instruction &instr, Lanes &rd, const Lanes &rs1,
+            const Lanes &rs2);
+  bool memory(const Instruction &instr);
+  void ecall();
+
+public:
+  // Each lane is a loaded machine that has been prepared but not run. All
+  // of them must start at the same pc.
+  explicit WideHart(std::vector<Machine<XLEN> *> lanes);
+
+  // Runs until every lane has exited or split off
+  void run();
+
+  // Lanes that have to be resumed by their scalar harts
+  const std::vector<std::size_t> &split_lanes() const { return split_; }
+
+  // Instructions dispatched in lock-step, and retired summed over lanes
+  long dispatched() const { return n_instructions_; }
+  long lane_instructions() const { return lane_instructions_; }
+};
+} // namespace sim
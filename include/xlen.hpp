@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sim {
+// Register width of a hart. Everything that depends on it is templated on
+// XLEN and instantiated separately for RV32 and RV64, so RV32 runs do not pay
+// for 64-bit registers.
+template <int XLEN> struct Xlen;
+
+// Double-width types hold the full product of two registers for MULH*
+__extension__ typedef unsigned __int128 uint128_t;
+__extension__ typedef __int128 int128_t;
+
+template <> struct Xlen<32> {
+  using reg = uint32_t;
+  using sreg = int32_t;
+  using dreg = uint64_t;
+  using sdreg = int64_t;
+};
+
+template <> struct Xlen<64> {
+  using reg = uint64_t;
+  using sreg = int64_t;
+  using dreg = uint128_t;
+  using sdreg = int128_t;
+};
+} // namespace sim
@@ -0,0 +1,190 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace sim {
+void BatchRunner::read_manifest(const std::string &path) {
+  std::ifstream manifest(path);
+  if (!manifest) {
+    throw std::runtime_error("Cannot open manifest: " + path);
+  }
+
+  std::string line;
+  while (std::getline(manifest, line)) {
+    std::istringstream fields(line);
+    BatchJob job;
+    if (!(fields >> job.elf) || job.elf[0] == '#') {
+      continue;
+    }
+    if (!(fields >> job.instruction_limit)) {
+      throw std::runtime_error("Missing instruction limit in: " + line);
+    }
+    for (std::string option; fields >> option;) {
+      job.options.push_back(option);
+    }
+    if (!images_.count(job.elf)) {
+      images_[job.elf] = ElfImage::read(job.elf, false);
+    }
+    jobs_.push_back(std::move(job));
+  }
+  results_.assign(jobs_.size(), BatchResult{});
+}
+
+bool BatchRunner::take(std::size_t worker, std::size_t &job) {
+  {
+    Worker &own = *workers_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      job = own.jobs.back();
+      own.jobs.pop_back();
+      return true;
+    }
+  }
+  // No job is queued once the workers start, so empty deques stay empty
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    Worker &victim = *workers_[(worker + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<Loader> BatchRunner::load_job(std::size_t index) const {
+  const BatchJob &job = jobs_[index];
+  auto loader = std::make_unique<Loader>();
+  loader->parse_options(job.options);
+  loader->set_instruction_limit(job.instruction_limit);
+  loader->set_quiet(true);
+  loader->load(*images_.at(job.elf), false);
+  return loader;
+}
+
+void BatchRunner::finish_job(std::size_t index, const MachineBase &machine,
+                             int exit_code) {
+  BatchResult &result = results_[index];
+  result.exit_code = exit_code;
+  result.instructions = machine.instructions();
+  result.status = machine.out_of_budget() ? "limit" : "exit";
+}
+
+void BatchRunner::run_job(std::size_t index) {
+  BatchResult &result = results_[index];
+  auto start = std::chrono::steady_clock::now();
+  try {
+    std::unique_ptr<Loader> loader = load_job(index);
+    int exit_code = loader->run();
+    finish_job(index, loader->machine(), exit_code);
+  } catch (const std::exception &e) {
+    result.status = std::string("error: ") + e.what();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+}
+
+void BatchRunner::run_cooperative(std::size_t worker) {
+  std::vector<Guest> guests;
+  bool more = true;
+  std::size_t job;
+  while (more || !guests.empty()) {
+    while (guests.size() < max_guests && (more = take(worker, job))) {
+      try {
+        Guest guest{job, load_job(job)};
+        guest.loader->machine().start();
+        guests.push_back(std::move(guest));
+      } catch (const std::exception &e) {
+        results_[job].status = std::string("error: ") + e.what();
+      }
+    }
+
+    bool progress = false;
+    for (std::size_t i = 0; i < guests.size();) {
+      Guest &guest = guests[i];
+      MachineBase &machine = guest.loader->machine();
+      auto start = std::chrono::steady_clock::now();
+      Yield reason = Yield::exited;
+      try {
+        reason = machine.slice(budget_);
+        if (reason == Yield::exited || reason == Yield::stopped) {
+          finish_job(guest.job, machine, machine.exit_code());
+        }
+      } catch (const std::exception &e) {
+        results_[guest.job].status = std::string("error: ") + e.what();
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      guest.seconds += elapsed.count();
+
+      if (reason == Yield::exited || reason == Yield::stopped) {
+        results_[guest.job].seconds = guest.seconds;
+        guests[i] = std::move(guests.back());
+        guests.pop_back();
+        progress = true;
+        continue;
+      }
+      progress |= reason == Yield::budget;
+      ++i;
+    }
+    // Every guest waits for input or an interrupt from another hart
+    if (!progress && !guests.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void BatchRunner::run(std::size_t n_workers) {
+  if (n_workers == 0) {
+    n_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers_.clear();
+  for (std::size_t i = 0; i < n_workers; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (std::size_t job = 0; job < jobs_.size(); ++job) {
+    workers_[job % n_workers]->jobs.push_back(job);
+  }
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < n_workers; ++i) {
+    threads.emplace_back([this, i] {
+      if (budget_ != 0) {
+        run_cooperative(i);
+        return;
+      }
+      std::size_t job;
+      while (take(i, job)) {
+        run_job(job);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void BatchRunner::write_results(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("Cannot open results file: " + path);
+  }
+  out << "# elf\tstatus\texit_code\tinstructions\tseconds\tmips\n";
+  for (std::size_t i = 0; i < jobs_.size(); ++i) {
+    const BatchResult &result = results_[i];
+    double mips = result.seconds > 0
+                      ? result.instructions / (result.seconds * 1e6)
+                      : 0;
+    out << jobs_[i].elf << '\t' << result.status << '\t' << result.exit_code
+        << '\t' << result.instructions << '\t' << result.seconds << '\t'
+        << mips << '\n';
+  }
+}
+} // namespace sim
@@ -1,91 +1,201 @@
 #include "cached.hpp"
+#include "compressed.hpp"
 #include "generated_instructions.hpp"
 #include "hart.hpp"
 #include "memory.hpp"
 
 namespace sim {
-bool Cached::cache_it(register_t pc) {
-  std::vector<InstructionHandler> block;
-  register_t cur_pc = pc;
+template <int XLEN>
+typename Cached<XLEN>::CachedPage *Cached<XLEN>::find_page(uint32_t paddr,
+                                                          bool create) {
+  uint32_t frame = paddr >> page_shift;
+  if (frame == last_frame_) {
+    return last_page_;
+  }
 
-  while (true) {
-    uint32_t instr = hart_->mem_->read_word(cur_pc);
-    DecodedInstruction decoded = decode(instr);
+  auto it = pages_.find(frame);
+  if (it == pages_.end()) {
+    if (!create) {
+      return nullptr;
+    }
+    it = pages_.emplace(frame, std::make_unique<CachedPage>()).first;
+  }
+  last_frame_ = frame;
+  last_page_ = it->second.get();
+  return last_page_;
+}
 
-    block.push_back(decoded.first);
+template <int XLEN> void Cached<XLEN>::copy_from(const Cached &other) {
+  pages_.clear();
+  for (const auto &page : other.pages_) {
+    pages_.emplace(page.first, std::make_unique<CachedPage>(*page.second));
+  }
+  last_frame_ = ~0u;
+  last_page_ = nullptr;
+}
 
-    if (decoded.second) {
-      cached_[pc] = block;
-      return true;
+template <int XLEN> bool Cached<XLEN>::cache_it(uint32_t paddr) {
+  std::vector<CachedInstruction<XLEN>> block;
+  uint32_t previous = 0;
+  uint32_t cur = paddr;
+  uint32_t page_end = (paddr | ((1 << page_shift) - 1)) + 1;
+
+  while (true) {
+    uint32_t instr = hart_->mem_->read_physical_half(cur);
+    uint32_t length = instruction_length(instr);
+    // An instruction straddling the page is left to the uncached path
+    if (cur + length > page_end) {
+      break;
     }
+    if (length == 4) {
+      instr |= static_cast<uint32_t>(hart_->mem_->read_physical_half(cur + 2))
+               << 16;
+    }
+    DecodedInstruction<XLEN> decoded = decode<XLEN>(instr);
 
-    cur_pc += 4;
+    InstructionHandler<XLEN> fused;
+    if (!block.empty() && block.back().count == 1) {
+      fused = fuse<XLEN>(previous, block.back().length, instr);
+    }
+    if (fused) {
+      block.back().handler = std::move(fused);
+      block.back().length += length;
+      block.back().count = 2;
+    } else {
+      block.push_back({std::move(decoded.first), length});
+    }
+    previous = instr;
+    cur += length;
 
-    if (block.size() >= 100) {
-      cached_[pc] = block;
-      return true;
+    if (decoded.second || block.size() >= 100 || cur == page_end) {
+      break;
     }
   }
+
+  if (block.empty()) {
+    return false;
+  }
+  CachedPage *page = find_page(paddr, true);
+  page->blocks[(paddr >> 1) & (halfwords_per_page - 1)] = std::move(block);
+  return true;
 }
 
-bool Cached::execute_from_cache(register_t &pc) {
-  auto it = cached_.find(pc);
-  if (it != cached_.end()) {
+template <int XLEN>
+bool Cached<XLEN>::execute_from_cache(register_t &pc, uint32_t paddr) {
+  CachedPage *page = find_page(paddr, false);
+  if (!page) {
+    return false;
+  }
+
+  auto &block = page->blocks[(paddr >> 1) & (halfwords_per_page - 1)];
+  if (block.empty()) {
+    return false;
+  }
 
-    for (auto &handler : it->second) {
-      ++hart_->n_instructions;
-      handler(hart_);
-      pc += 4;
+  for (auto &instr : block) {
+    hart_->n_instructions += instr.count;
+    register_t next = pc + instr.length;
+    hart_->next_pc = next;
+    instr.handler(hart_);
+    pc = hart_->next_pc;
+    if (pc != next) {
+      break;
     }
-    return true;
   }
-  return false;
+  return true;
 }
 
-DecodedInstruction decode(uint32_t instr) {
+template <int XLEN> DecodedInstruction<XLEN> decode(uint32_t instr) {
+  using H = Hart<XLEN>;
+  using I = Instructions<XLEN>;
+  using V = VectorInstructions<XLEN>;
+  if (instruction_length(instr) == 2) {
+    instr = expand_compressed<XLEN>(static_cast<uint16_t>(instr));
+  }
   uint8_t opcode = instr & 0x7F;
   uint8_t funct3 = (instr >> 12) & 0x7;
   uint8_t funct7 = (instr >> 25) & 0x7F;
+  // RV64 immediate shifts have a 6-bit shamt, leaving funct6 above it
+  uint8_t shift_funct = XLEN == 64 ? funct7 & ~1 : funct7;
+  bool rv64 = XLEN == 64;
 
   bool is_control_flow = false;
-  InstructionHandler handler;
+  InstructionHandler<XLEN> handler;
 
   switch (opcode) {
   case 0x03: {
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_lb(hart, instr); };
+      handler = [instr](H *hart) { I::exec_lb(hart, instr); };
       break;
     case 0x1:
-      handler = [instr](Hart *hart) { exec_lh(hart, instr); };
+      handler = [instr](H *hart) { I::exec_lh(hart, instr); };
       break;
     case 0x2:
-      handler = [instr](Hart *hart) { exec_lw(hart, instr); };
+      handler = [instr](H *hart) { I::exec_lw(hart, instr); };
       break;
     case 0x3:
-      handler = [instr](Hart *hart) { exec_ld(hart, instr); };
+      if (!rv64) {
+        throw std::runtime_error("Illegal instruction (LOAD)");
+      }
+      handler = [instr](H *hart) { I::exec_ld(hart, instr); };
       break;
     case 0x4:
-      handler = [instr](Hart *hart) { exec_lbu(hart, instr); };
+      handler = [instr](H *hart) { I::exec_lbu(hart, instr); };
       break;
     case 0x5:
-      handler = [instr](Hart *hart) { exec_lhu(hart, instr); };
+      handler = [instr](H *hart) { I::exec_lhu(hart, instr); };
       break;
     case 0x6:
-      handler = [instr](Hart *hart) { exec_lwu(hart, instr); };
+      if (!rv64) {
+        throw std::runtime_error("Illegal instruction (LOAD)");
+      }
+      handler = [instr](H *hart) { I::exec_lwu(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (LOAD)");
     }
     break;
   }
+  case 0x07: {
+    switch (funct3) {
+    case 0x2:
+      handler = [instr](H *hart) { I::exec_flw(hart, instr); };
+      break;
+    case 0x3:
+      handler = [instr](H *hart) { I::exec_fld(hart, instr); };
+      break;
+    case 0x0:
+    case 0x5:
+    case 0x6:
+    case 0x7: {
+      // Unit-stride and strided vector loads without segments: nf and mew
+      // are zero
+      uint32_t mop = (instr >> 26) & 0x3;
+      if ((instr >> 28) != 0) {
+        throw std::runtime_error("Illegal instruction (vector load)");
+      }
+      if (mop == 0x0 && ((instr >> 20) & 0x1F) == 0) {
+        handler = [instr](H *hart) { V::exec_vle(hart, instr); };
+      } else if (mop == 0x2) {
+        handler = [instr](H *hart) { V::exec_vlse(hart, instr); };
+      } else {
+        throw std::runtime_error("Illegal instruction (vector load)");
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Illegal instruction (LOAD-FP)");
+    }
+    break;
+  }
   case 0x0F: {
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_fence(hart, instr); };
+      handler = [instr](H *hart) { I::exec_fence(hart, instr); };
       break;
     case 0x1:
-      handler = [instr](Hart *hart) { exec_fence_i(hart, instr); };
+      handler = [instr](H *hart) { I::exec_fence_i(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (FENCE)");
@@ -95,32 +205,66 @@ DecodedInstruction decode(uint32_t instr) {
   case 0x13: {
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_addi(hart, instr); };
+      handler = [instr](H *hart) { I::exec_addi(hart, instr); };
       break;
     case 0x1: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_slli(hart, instr); };
+      if (shift_funct == 0x0) {
+        handler = [instr](H *hart) { I::exec_slli(hart, instr); };
+      } else if (funct7 == 0x30) {
+        // Zbb unary operations, selected by the rs2 field
+        switch ((instr >> 20) & 0x1F) {
+        case 0x0:
+          handler = [instr](H *hart) { I::exec_clz(hart, instr); };
+          break;
+        case 0x1:
+          handler = [instr](H *hart) { I::exec_ctz(hart, instr); };
+          break;
+        case 0x2:
+          handler = [instr](H *hart) { I::exec_cpop(hart, instr); };
+          break;
+        case 0x4:
+          handler = [instr](H *hart) { I::exec_sext_b(hart, instr); };
+          break;
+        case 0x5:
+          handler = [instr](H *hart) { I::exec_sext_h(hart, instr); };
+          break;
+        default:
+          throw std::runtime_error("Illegal instruction (OP-IMM)");
+        }
       } else {
         throw std::runtime_error("Illegal instruction (wrong funct7)");
       }
       break;
     }
     case 0x2:
-      handler = [instr](Hart *hart) { exec_slti(hart, instr); };
+      handler = [instr](H *hart) { I::exec_slti(hart, instr); };
       break;
     case 0x3:
-      handler = [instr](Hart *hart) { exec_sltiu(hart, instr); };
+      handler = [instr](H *hart) { I::exec_sltiu(hart, instr); };
       break;
     case 0x4:
-      handler = [instr](Hart *hart) { exec_xori(hart, instr); };
+      handler = [instr](H *hart) { I::exec_xori(hart, instr); };
       break;
     case 0x5: {
-      switch (funct7) {
+      // orc.b and rev8 have fixed immediates
+      uint32_t imm = instr >> 20;
+      if (imm == 0x287) {
+        handler = [instr](H *hart) { I::exec_orc_b(hart, instr); };
+        break;
+      }
+      if (imm == (rv64 ? 0x6B8u : 0x698u)) {
+        handler = [instr](H *hart) { I::exec_rev8(hart, instr); };
+        break;
+      }
+      switch (shift_funct) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_srli(hart, instr); };
+        handler = [instr](H *hart) { I::exec_srli(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_srai(hart, instr); };
+        handler = [instr](H *hart) { I::exec_srai(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_rori(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -128,10 +272,10 @@ DecodedInstruction decode(uint32_t instr) {
       break;
     }
     case 0x6:
-      handler = [instr](Hart *hart) { exec_ori(hart, instr); };
+      handler = [instr](H *hart) { I::exec_ori(hart, instr); };
       break;
     case 0x7:
-      handler = [instr](Hart *hart) { exec_andi(hart, instr); };
+      handler = [instr](H *hart) { I::exec_andi(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (OP-IMM)");
@@ -139,17 +283,38 @@ DecodedInstruction decode(uint32_t instr) {
     break;
   }
   case 0x17: {
-    handler = [instr](Hart *hart) { exec_auipc(hart, instr); };
+    handler = [instr](H *hart) { I::exec_auipc(hart, instr); };
     break;
   }
   case 0x1B: {
+    if (!rv64) {
+      handler = [instr](H *hart) { I::exec_ill(hart, instr); };
+      is_control_flow = true;
+      break;
+    }
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_addiw(hart, instr); };
+      handler = [instr](H *hart) { I::exec_addiw(hart, instr); };
       break;
     case 0x1: {
       if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_slliw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_slliw(hart, instr); };
+      } else if (shift_funct == 0x04) {
+        handler = [instr](H *hart) { I::exec_slli_uw(hart, instr); };
+      } else if (funct7 == 0x30) {
+        switch ((instr >> 20) & 0x1F) {
+        case 0x0:
+          handler = [instr](H *hart) { I::exec_clzw(hart, instr); };
+          break;
+        case 0x1:
+          handler = [instr](H *hart) { I::exec_ctzw(hart, instr); };
+          break;
+        case 0x2:
+          handler = [instr](H *hart) { I::exec_cpopw(hart, instr); };
+          break;
+        default:
+          throw std::runtime_error("Illegal instruction (OP-IMM-32)");
+        }
       } else {
         throw std::runtime_error("Illegal instruction (wrong funct7)");
       }
@@ -158,10 +323,13 @@ DecodedInstruction decode(uint32_t instr) {
     case 0x5: {
       switch (funct7) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_srliw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_srliw(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_sraiw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_sraiw(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_roriw(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -176,31 +344,185 @@ DecodedInstruction decode(uint32_t instr) {
   case 0x23: {
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_sb(hart, instr); };
+      handler = [instr](H *hart) { I::exec_sb(hart, instr); };
       break;
     case 0x1:
-      handler = [instr](Hart *hart) { exec_sh(hart, instr); };
+      handler = [instr](H *hart) { I::exec_sh(hart, instr); };
       break;
     case 0x2:
-      handler = [instr](Hart *hart) { exec_sw(hart, instr); };
+      handler = [instr](H *hart) { I::exec_sw(hart, instr); };
       break;
     case 0x3:
-      handler = [instr](Hart *hart) { exec_sd(hart, instr); };
+      if (!rv64) {
+        throw std::runtime_error("Illegal instruction (STORE)");
+      }
+      handler = [instr](H *hart) { I::exec_sd(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (STORE)");
     }
     break;
   }
+  case 0x27: {
+    switch (funct3) {
+    case 0x2:
+      handler = [instr](H *hart) { I::exec_fsw(hart, instr); };
+      break;
+    case 0x3:
+      handler = [instr](H *hart) { I::exec_fsd(hart, instr); };
+      break;
+    case 0x0:
+    case 0x5:
+    case 0x6:
+    case 0x7: {
+      // Unit-stride and strided vector stores without segments: nf and mew
+      // are zero
+      uint32_t mop = (instr >> 26) & 0x3;
+      if ((instr >> 28) != 0) {
+        throw std::runtime_error("Illegal instruction (vector store)");
+      }
+      if (mop == 0x0 && ((instr >> 20) & 0x1F) == 0) {
+        handler = [instr](H *hart) { V::exec_vse(hart, instr); };
+      } else if (mop == 0x2) {
+        handler = [instr](H *hart) { V::exec_vsse(hart, instr); };
+      } else {
+        throw std::runtime_error("Illegal instruction (vector store)");
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Illegal instruction (STORE-FP)");
+    }
+    break;
+  }
+  case 0x2F: {
+    // aq and rl are not decoded, as every host atomic used is sequentially
+    // consistent. LR has no rs2.
+    uint32_t funct5 = instr >> 27;
+    if (funct5 == 0x02 && ((instr >> 20) & 0x1F) != 0) {
+      throw std::runtime_error("Illegal instruction (AMO)");
+    }
+    if (funct3 == 0x2) {
+      switch (funct5) {
+      case 0x02:
+        handler = [instr](H *hart) { I::exec_lr_w(hart, instr); };
+        break;
+      case 0x03:
+        handler = [instr](H *hart) { I::exec_sc_w(hart, instr); };
+        break;
+      case 0x01:
+        handler = [instr](H *hart) { I::exec_amoswap_w(hart, instr); };
+        break;
+      case 0x00:
+        handler = [instr](H *hart) { I::exec_amoadd_w(hart, instr); };
+        break;
+      case 0x04:
+        handler = [instr](H *hart) { I::exec_amoxor_w(hart, instr); };
+        break;
+      case 0x0C:
+        handler = [instr](H *hart) { I::exec_amoand_w(hart, instr); };
+        break;
+      case 0x08:
+        handler = [instr](H *hart) { I::exec_amoor_w(hart, instr); };
+        break;
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_amomin_w(hart, instr); };
+        break;
+      case 0x14:
+        handler = [instr](H *hart) { I::exec_amomax_w(hart, instr); };
+        break;
+      case 0x18:
+        handler = [instr](H *hart) { I::exec_amominu_w(hart, instr); };
+        break;
+      case 0x1C:
+        handler = [instr](H *hart) { I::exec_amomaxu_w(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (AMO)");
+      }
+    } else if (funct3 == 0x3 && rv64) {
+      switch (funct5) {
+      case 0x02:
+        handler = [instr](H *hart) { I::exec_lr_d(hart, instr); };
+        break;
+      case 0x03:
+        handler = [instr](H *hart) { I::exec_sc_d(hart, instr); };
+        break;
+      case 0x01:
+        handler = [instr](H *hart) { I::exec_amoswap_d(hart, instr); };
+        break;
+      case 0x00:
+        handler = [instr](H *hart) { I::exec_amoadd_d(hart, instr); };
+        break;
+      case 0x04:
+        handler = [instr](H *hart) { I::exec_amoxor_d(hart, instr); };
+        break;
+      case 0x0C:
+        handler = [instr](H *hart) { I::exec_amoand_d(hart, instr); };
+        break;
+      case 0x08:
+        handler = [instr](H *hart) { I::exec_amoor_d(hart, instr); };
+        break;
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_amomin_d(hart, instr); };
+        break;
+      case 0x14:
+        handler = [instr](H *hart) { I::exec_amomax_d(hart, instr); };
+        break;
+      case 0x18:
+        handler = [instr](H *hart) { I::exec_amominu_d(hart, instr); };
+        break;
+      case 0x1C:
+        handler = [instr](H *hart) { I::exec_amomaxu_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (AMO)");
+      }
+    } else {
+      throw std::runtime_error("Illegal instruction (AMO)");
+    }
+    break;
+  }
   case 0x33: {
+    if (funct7 == 0x01) {
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_mul(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_mulh(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_mulhsu(hart, instr); };
+        break;
+      case 0x3:
+        handler = [instr](H *hart) { I::exec_mulhu(hart, instr); };
+        break;
+      case 0x4:
+        handler = [instr](H *hart) { I::exec_div(hart, instr); };
+        break;
+      case 0x5:
+        handler = [instr](H *hart) { I::exec_divu(hart, instr); };
+        break;
+      case 0x6:
+        handler = [instr](H *hart) { I::exec_rem(hart, instr); };
+        break;
+      case 0x7:
+        handler = [instr](H *hart) { I::exec_remu(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP)");
+      }
+      break;
+    }
     switch (funct3) {
     case 0x0: {
       switch (funct7) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_add(hart, instr); };
+        handler = [instr](H *hart) { I::exec_add(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_sub(hart, instr); };
+        handler = [instr](H *hart) { I::exec_sub(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -208,44 +530,78 @@ DecodedInstruction decode(uint32_t instr) {
       break;
     }
     case 0x1: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_sll(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_sll(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_rol(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x2: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_slt(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_slt(hart, instr); };
+        break;
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh1add(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x3: {
       if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_sltu(hart, instr); };
+        handler = [instr](H *hart) { I::exec_sltu(hart, instr); };
       } else {
         throw std::runtime_error("Illegal instruction (wrong funct7)");
       }
       break;
     }
     case 0x4: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_xor(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_xor(hart, instr); };
+        break;
+      case 0x20:
+        handler = [instr](H *hart) { I::exec_xnor(hart, instr); };
+        break;
+      case 0x05:
+        handler = [instr](H *hart) { I::exec_min(hart, instr); };
+        break;
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh2add(hart, instr); };
+        break;
+      case 0x04:
+        // zext.h is the rs2 = 0 case of RV64's pack
+        if (rv64 || ((instr >> 20) & 0x1F) != 0) {
+          throw std::runtime_error("Illegal instruction (OP)");
+        }
+        handler = [instr](H *hart) { I::exec_zext_h(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x5: {
       switch (funct7) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_srl(hart, instr); };
+        handler = [instr](H *hart) { I::exec_srl(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_sra(hart, instr); };
+        handler = [instr](H *hart) { I::exec_sra(hart, instr); };
+        break;
+      case 0x05:
+        handler = [instr](H *hart) { I::exec_minu(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_ror(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -253,18 +609,37 @@ DecodedInstruction decode(uint32_t instr) {
       break;
     }
     case 0x6: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_or(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_or(hart, instr); };
+        break;
+      case 0x20:
+        handler = [instr](H *hart) { I::exec_orn(hart, instr); };
+        break;
+      case 0x05:
+        handler = [instr](H *hart) { I::exec_max(hart, instr); };
+        break;
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh3add(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x7: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_and(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_and(hart, instr); };
+        break;
+      case 0x20:
+        handler = [instr](H *hart) { I::exec_andn(hart, instr); };
+        break;
+      case 0x05:
+        handler = [instr](H *hart) { I::exec_maxu(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
@@ -274,18 +649,48 @@ DecodedInstruction decode(uint32_t instr) {
     break;
   }
   case 0x37: {
-    handler = [instr](Hart *hart) { exec_lui(hart, instr); };
+    handler = [instr](H *hart) { I::exec_lui(hart, instr); };
     break;
   }
   case 0x3B: {
+    if (!rv64) {
+      handler = [instr](H *hart) { I::exec_ill(hart, instr); };
+      is_control_flow = true;
+      break;
+    }
+    if (funct7 == 0x01) {
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_mulw(hart, instr); };
+        break;
+      case 0x4:
+        handler = [instr](H *hart) { I::exec_divw(hart, instr); };
+        break;
+      case 0x5:
+        handler = [instr](H *hart) { I::exec_divuw(hart, instr); };
+        break;
+      case 0x6:
+        handler = [instr](H *hart) { I::exec_remw(hart, instr); };
+        break;
+      case 0x7:
+        handler = [instr](H *hart) { I::exec_remuw(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-32)");
+      }
+      break;
+    }
     switch (funct3) {
     case 0x0: {
       switch (funct7) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_addw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_addw(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_subw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_subw(hart, instr); };
+        break;
+      case 0x04:
+        handler = [instr](H *hart) { I::exec_add_uw(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -293,44 +698,55 @@ DecodedInstruction decode(uint32_t instr) {
       break;
     }
     case 0x1: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_sllw(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_sllw(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_rolw(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x2: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_sltw(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
-      }
-      break;
-    }
-    case 0x3: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_sltuw(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh1add_uw(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x4: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_xorw(hart, instr); };
-      } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+      switch (funct7) {
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh2add_uw(hart, instr); };
+        break;
+      case 0x04:
+        // zext.h is the rs2 = 0 case of packw
+        if (((instr >> 20) & 0x1F) != 0) {
+          throw std::runtime_error("Illegal instruction (OP-32)");
+        }
+        handler = [instr](H *hart) { I::exec_zext_h(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
       }
       break;
     }
     case 0x5: {
       switch (funct7) {
       case 0x0:
-        handler = [instr](Hart *hart) { exec_srlw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_srlw(hart, instr); };
         break;
       case 0x20:
-        handler = [instr](Hart *hart) { exec_sraw(hart, instr); };
+        handler = [instr](H *hart) { I::exec_sraw(hart, instr); };
+        break;
+      case 0x30:
+        handler = [instr](H *hart) { I::exec_rorw(hart, instr); };
         break;
       default:
         throw std::runtime_error("Illegal instruction (no funct7 match)");
@@ -338,23 +754,362 @@ DecodedInstruction decode(uint32_t instr) {
       break;
     }
     case 0x6: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_orw(hart, instr); };
+      switch (funct7) {
+      case 0x10:
+        handler = [instr](H *hart) { I::exec_sh3add_uw(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (no funct7 match)");
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Illegal instruction (OP-32)");
+    }
+    break;
+  }
+  case 0x43:
+  case 0x47:
+  case 0x4B:
+  case 0x4F: {
+    uint32_t fmt = (instr >> 25) & 0x3;
+    if (fmt > 1 || funct3 == 0x5 || funct3 == 0x6) {
+      throw std::runtime_error("Illegal instruction (FMA)");
+    }
+    switch (opcode) {
+    case 0x43:
+      if (fmt == 0) {
+        handler = [instr](H *hart) { I::exec_fmadd_s(hart, instr); };
       } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+        handler = [instr](H *hart) { I::exec_fmadd_d(hart, instr); };
+      }
+      break;
+    case 0x47:
+      if (fmt == 0) {
+        handler = [instr](H *hart) { I::exec_fmsub_s(hart, instr); };
+      } else {
+        handler = [instr](H *hart) { I::exec_fmsub_d(hart, instr); };
+      }
+      break;
+    case 0x4B:
+      if (fmt == 0) {
+        handler = [instr](H *hart) { I::exec_fnmsub_s(hart, instr); };
+      } else {
+        handler = [instr](H *hart) { I::exec_fnmsub_d(hart, instr); };
+      }
+      break;
+    case 0x4F:
+      if (fmt == 0) {
+        handler = [instr](H *hart) { I::exec_fnmadd_s(hart, instr); };
+      } else {
+        handler = [instr](H *hart) { I::exec_fnmadd_d(hart, instr); };
       }
       break;
     }
-    case 0x7: {
-      if (funct7 == 0x0) {
-        handler = [instr](Hart *hart) { exec_andw(hart, instr); };
+    break;
+  }
+  case 0x53: {
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    // Operations that round take rm in funct3, where 5 and 6 are reserved
+    bool bad_rm = funct3 == 0x5 || funct3 == 0x6;
+    switch (funct7) {
+    case 0x00:
+      handler = [instr](H *hart) { I::exec_fadd_s(hart, instr); };
+      break;
+    case 0x01:
+      handler = [instr](H *hart) { I::exec_fadd_d(hart, instr); };
+      break;
+    case 0x04:
+      handler = [instr](H *hart) { I::exec_fsub_s(hart, instr); };
+      break;
+    case 0x05:
+      handler = [instr](H *hart) { I::exec_fsub_d(hart, instr); };
+      break;
+    case 0x08:
+      handler = [instr](H *hart) { I::exec_fmul_s(hart, instr); };
+      break;
+    case 0x09:
+      handler = [instr](H *hart) { I::exec_fmul_d(hart, instr); };
+      break;
+    case 0x0C:
+      handler = [instr](H *hart) { I::exec_fdiv_s(hart, instr); };
+      break;
+    case 0x0D:
+      handler = [instr](H *hart) { I::exec_fdiv_d(hart, instr); };
+      break;
+    case 0x2C:
+      handler = [instr](H *hart) { I::exec_fsqrt_s(hart, instr); };
+      break;
+    case 0x2D:
+      handler = [instr](H *hart) { I::exec_fsqrt_d(hart, instr); };
+      break;
+    case 0x10:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fsgnj_s(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fsgnjn_s(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fsgnjx_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x11:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fsgnj_d(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fsgnjn_d(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fsgnjx_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x14:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fmin_s(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fmax_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x15:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fmin_d(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fmax_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x20:
+      switch (rs2) {
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fcvt_s_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x21:
+      switch (rs2) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fcvt_d_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x50:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fle_s(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_flt_s(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_feq_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x51:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fle_d(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_flt_d(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_feq_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x60:
+      if (rs2 > 0x1 && !rv64) {
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      switch (rs2) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fcvt_w_s(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fcvt_wu_s(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fcvt_l_s(hart, instr); };
+        break;
+      case 0x3:
+        handler = [instr](H *hart) { I::exec_fcvt_lu_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x61:
+      if (rs2 > 0x1 && !rv64) {
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      switch (rs2) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fcvt_w_d(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fcvt_wu_d(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fcvt_l_d(hart, instr); };
+        break;
+      case 0x3:
+        handler = [instr](H *hart) { I::exec_fcvt_lu_d(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x68:
+      if (rs2 > 0x1 && !rv64) {
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      switch (rs2) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fcvt_s_w(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fcvt_s_wu(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fcvt_s_l(hart, instr); };
+        break;
+      case 0x3:
+        handler = [instr](H *hart) { I::exec_fcvt_s_lu(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x69:
+      if (rs2 > 0x1 && !rv64) {
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      switch (rs2) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fcvt_d_w(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fcvt_d_wu(hart, instr); };
+        break;
+      case 0x2:
+        handler = [instr](H *hart) { I::exec_fcvt_d_l(hart, instr); };
+        break;
+      case 0x3:
+        handler = [instr](H *hart) { I::exec_fcvt_d_lu(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x70:
+      switch (funct3) {
+      case 0x0:
+        handler = [instr](H *hart) { I::exec_fmv_x_w(hart, instr); };
+        break;
+      case 0x1:
+        handler = [instr](H *hart) { I::exec_fclass_s(hart, instr); };
+        break;
+      default:
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x71:
+      if (funct3 == 0x0 && rv64) {
+        handler = [instr](H *hart) { I::exec_fmv_x_d(hart, instr); };
+      } else if (funct3 == 0x1) {
+        handler = [instr](H *hart) { I::exec_fclass_d(hart, instr); };
       } else {
-        throw std::runtime_error("Illegal instruction (wrong funct7)");
+        throw std::runtime_error("Illegal instruction (OP-FP)");
+      }
+      break;
+    case 0x78:
+      handler = [instr](H *hart) { I::exec_fmv_w_x(hart, instr); };
+      break;
+    case 0x79:
+      if (!rv64) {
+        throw std::runtime_error("Illegal instruction (OP-FP)");
       }
+      handler = [instr](H *hart) { I::exec_fmv_d_x(hart, instr); };
       break;
+    default:
+      throw std::runtime_error("Illegal instruction (OP-FP)");
+    }
+    bool rounds = funct7 < 0x10 || (funct7 & ~1) == 0x2C ||
+                  (funct7 & ~1) == 0x20 || (funct7 & ~1) == 0x60 ||
+                  (funct7 & ~1) == 0x68;
+    if (rounds && bad_rm) {
+      throw std::runtime_error("Illegal instruction (rounding mode)");
+    }
+    break;
+  }
+  case 0x57: {
+    uint32_t funct6 = instr >> 26;
+    uint8_t vs1 = (instr >> 15) & 0x1F;
+    if (funct3 != OPCFG && !VectorUnit::implemented(funct3, funct6)) {
+      throw std::runtime_error("Illegal instruction (OP-V)");
     }
+    switch (funct3) {
+    case OPIVV:
+      handler = [instr](H *hart) { V::exec_opivv(hart, instr); };
+      break;
+    case OPIVX:
+      handler = [instr](H *hart) { V::exec_opivx(hart, instr); };
+      break;
+    case OPIVI:
+      handler = [instr](H *hart) { V::exec_opivi(hart, instr); };
+      break;
+    case OPMVV:
+      // vmv.x.s, vcpop.m and vfirst.m; vid.v
+      if ((funct6 == 0x10 && vs1 != 0x00 && vs1 != 0x10 && vs1 != 0x11) ||
+          (funct6 == 0x14 && vs1 != 0x11)) {
+        throw std::runtime_error("Illegal instruction (OP-V)");
+      }
+      handler = [instr](H *hart) { V::exec_opmvv(hart, instr); };
+      break;
+    case OPMVX:
+      handler = [instr](H *hart) { V::exec_opmvx(hart, instr); };
+      break;
+    case OPCFG:
+      if (!(instr >> 31)) {
+        handler = [instr](H *hart) { V::exec_vsetvli(hart, instr); };
+      } else if ((instr >> 30) == 0x3) {
+        handler = [instr](H *hart) { V::exec_vsetivli(hart, instr); };
+      } else if (funct7 == 0x40) {
+        handler = [instr](H *hart) { V::exec_vsetvl(hart, instr); };
+      } else {
+        throw std::runtime_error("Illegal instruction (OP-V)");
+      }
+      break;
     default:
-      throw std::runtime_error("Illegal instruction (OP-32)");
+      throw std::runtime_error("Illegal instruction (OP-V)");
     }
     break;
   }
@@ -362,22 +1117,22 @@ DecodedInstruction decode(uint32_t instr) {
     is_control_flow = true;
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_beq(hart, instr); };
+      handler = [instr](H *hart) { I::exec_beq(hart, instr); };
       break;
     case 0x1:
-      handler = [instr](Hart *hart) { exec_bne(hart, instr); };
+      handler = [instr](H *hart) { I::exec_bne(hart, instr); };
       break;
     case 0x4:
-      handler = [instr](Hart *hart) { exec_blt(hart, instr); };
+      handler = [instr](H *hart) { I::exec_blt(hart, instr); };
       break;
     case 0x5:
-      handler = [instr](Hart *hart) { exec_bge(hart, instr); };
+      handler = [instr](H *hart) { I::exec_bge(hart, instr); };
       break;
     case 0x6:
-      handler = [instr](Hart *hart) { exec_bltu(hart, instr); };
+      handler = [instr](H *hart) { I::exec_bltu(hart, instr); };
       break;
     case 0x7:
-      handler = [instr](Hart *hart) { exec_bgeu(hart, instr); };
+      handler = [instr](H *hart) { I::exec_bgeu(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (BRANCH)");
@@ -388,7 +1143,7 @@ DecodedInstruction decode(uint32_t instr) {
     is_control_flow = true;
     switch (funct3) {
     case 0x0:
-      handler = [instr](Hart *hart) { exec_jalr(hart, instr); };
+      handler = [instr](H *hart) { I::exec_jalr(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (JALR)");
@@ -397,56 +1152,135 @@ DecodedInstruction decode(uint32_t instr) {
   }
   case 0x6F: {
     is_control_flow = true;
-    handler = [instr](Hart *hart) { exec_jal(hart, instr); };
+    handler = [instr](H *hart) { I::exec_jal(hart, instr); };
     break;
   }
   case 0x73: {
     switch (funct3) {
     case 0x0: {
-      switch (funct7) {
-      case 0x09:
-        handler = [instr](Hart *hart) { exec_sfence_vma(hart, instr); };
+      if (funct7 == 0x09) {
+        handler = [instr](H *hart) { I::exec_sfence_vma(hart, instr); };
+        break;
+      }
+      switch (instr >> 20) {
+      case 0x000:
+        handler = [instr](H *hart) { I::exec_ecall(hart, instr); };
+        break;
+      case 0x001:
+        handler = [instr](H *hart) { I::exec_ebreak(hart, instr); };
+        break;
+      case 0x105:
+        handler = [instr](H *hart) { I::exec_wfi(hart, instr); };
+        break;
+      case 0x302:
+        handler = [instr](H *hart) { I::exec_mret(hart, instr); };
         break;
       default:
-        throw std::runtime_error("Illegal instruction (no funct7 match)");
+        throw std::runtime_error("Illegal instruction (no funct12 match)");
       }
       break;
     }
     case 0x1:
-      handler = [instr](Hart *hart) { exec_csrrw(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrw(hart, instr); };
       break;
     case 0x2:
-      handler = [instr](Hart *hart) { exec_csrrs(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrs(hart, instr); };
       break;
     case 0x3:
-      handler = [instr](Hart *hart) { exec_csrrc(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrc(hart, instr); };
       break;
     case 0x5:
-      handler = [instr](Hart *hart) { exec_csrrwi(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrwi(hart, instr); };
       break;
     case 0x6:
-      handler = [instr](Hart *hart) { exec_csrrsi(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrsi(hart, instr); };
       break;
     case 0x7:
-      handler = [instr](Hart *hart) { exec_csrrci(hart, instr); };
+      handler = [instr](H *hart) { I::exec_csrrci(hart, instr); };
       break;
     default:
       throw std::runtime_error("Illegal instruction (SYSTEM)");
     }
 
     uint32_t csr_addr = (instr >> 20) & 0xFFF;
-    if (funct3 == 0x0 || csr_addr == 0x302 || csr_addr == 0x304 ||
-        csr_addr == 0x305 || csr_addr == 0x341 || csr_addr == 0x342) {
+    if (funct3 == 0x0 || csr_addr == 0x180 || csr_addr == 0x300 ||
+        csr_addr == 0x302 || csr_addr == 0x304 || csr_addr == 0x305 ||
+        csr_addr == 0x341 || csr_addr == 0x342 || csr_addr == 0x344) {
       is_control_flow = true;
     }
     break;
   }
   default:
-    handler = [instr](Hart *hart) { exec_ill(hart, instr); };
-    break;
+    handler = [instr](H *hart) { I::exec_ill(hart, instr); };
     is_control_flow = true;
+    break;
   }
 
   return std::make_pair(handler, is_control_flow);
 }
+
+template <int XLEN>
+InstructionHandler<XLEN> fuse(uint32_t first, uint32_t first_length,
+                              uint32_t second) {
+  using H = Hart<XLEN>;
+  using I = Instructions<XLEN>;
+  using Exec = void (*)(H *, uint32_t);
+  if (instruction_length(first) == 2) {
+    first = expand_compressed<XLEN>(static_cast<uint16_t>(first));
+  }
+  if (instruction_length(second) == 2) {
+    second = expand_compressed<XLEN>(static_cast<uint16_t>(second));
+  }
+  uint8_t rd = (first >> 7) & 0x1F;
+  uint8_t funct3 = (first >> 12) & 0x7;
+  bool shift_add = (first & 0x7F) == 0x33 && (first >> 25) == 0x10 &&
+                   (funct3 == 0x2 || funct3 == 0x4 || funct3 == 0x6);
+  if (!shift_add || rd == 0 || (second & 0x7F) != 0x03 ||
+      ((second >> 15) & 0x1F) != rd) {
+    return {};
+  }
+
+  Exec add = funct3 == 0x2   ? I::exec_sh1add
+             : funct3 == 0x4 ? I::exec_sh2add
+                             : I::exec_sh3add;
+  Exec load;
+  switch ((second >> 12) & 0x7) {
+  case 0x0:
+    load = I::exec_lb;
+    break;
+  case 0x1:
+    load = I::exec_lh;
+    break;
+  case 0x2:
+    load = I::exec_lw;
+    break;
+  case 0x3:
+    load = I::exec_ld;
+    break;
+  case 0x4:
+    load = I::exec_lbu;
+    break;
+  case 0x5:
+    load = I::exec_lhu;
+    break;
+  case 0x6:
+    load = I::exec_lwu;
+    break;
+  default:
+    return {};
+  }
+  return [add, load, first, second, first_length](H *hart) {
+    add(hart, first);
+    // A faulting load must report its own pc
+    hart->pc += first_length;
+    load(hart, second);
+  };
+}
+
+template class Cached<32>;
+template class Cached<64>;
+template DecodedInstruction<32> decode<32>(uint32_t instr);
+template DecodedInstruction<64> decode<64>(uint32_t instr);
+template InstructionHandler<32> fuse<32>(uint32_t, uint32_t, uint32_t);
+template InstructionHandler<64> fuse<64>(uint32_t, uint32_t, uint32_t);
 }; // namespace sim
@@ -0,0 +1,145 @@
+#include "clint.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sim {
+namespace {
+uint64_t merge(uint64_t old_value, uint32_t offset, uint64_t value,
+               int size) {
+  if (size == 8) {
+    return value;
+  }
+  uint32_t shift = (offset & 0x7) * 8;
+  uint64_t mask = ((uint64_t{1} << (size * 8)) - 1) << shift;
+  return (old_value & ~mask) | ((value << shift) & mask);
+}
+
+uint64_t extract(uint64_t value, uint32_t offset, int size) {
+  value >>= (offset & 0x7) * 8;
+  return size == 8 ? value : value & ((uint64_t{1} << (size * 8)) - 1);
+}
+
+// Instruction counts belong to hart threads, which bump them without
+// synchronization; a stale count only makes a timer a little late
+long load_instret(const long *instret) {
+  return instret ? __atomic_load_n(instret, __ATOMIC_RELAXED) : 0;
+}
+} // namespace
+
+void Clint::attach(InterruptLines *lines, const long *instret) {
+  if (targets_.empty()) {
+    instret_ = instret;
+  }
+  targets_.push_back({lines, instret, std::numeric_limits<uint64_t>::max()});
+}
+
+uint64_t Clint::mtime() const {
+  return instret_ ? static_cast<uint64_t>(load_instret(instret_) +
+                                          time_offset_.load())
+                  : 0;
+}
+
+void Clint::update_deadline(Target &target) {
+  // The deadline is counted in instructions of the target hart itself
+  long instret = load_instret(target.instret);
+  uint64_t now = mtime();
+  long deadline = instret;
+  if (target.mtimecmp > now) {
+    uint64_t delta = target.mtimecmp - now;
+    deadline = delta < static_cast<uint64_t>(InterruptLines::never - instret)
+                   ? instret + static_cast<long>(delta)
+                   : InterruptLines::never;
+  }
+  target.lines->timer_deadline.store(deadline);
+  target.lines->next_event.store(0);
+}
+
+void Clint::copy_from(const Clint &other) {
+  time_offset_.store(other.time_offset_.load());
+  for (std::size_t i = 0; i < targets_.size() && i < other.targets_.size();
+       ++i) {
+    targets_[i].mtimecmp = other.targets_[i].mtimecmp;
+    update_deadline(targets_[i]);
+  }
+}
+
+void Clint::save(StateWriter &out) const {
+  out.put(time_offset_.load());
+  out.put(targets_.size());
+  for (const Target &target : targets_) {
+    out.put(target.mtimecmp);
+  }
+}
+
+void Clint::restore(StateReader &in) {
+  time_offset_.store(in.get<long>());
+  if (in.get<std::size_t>() != targets_.size()) {
+    throw std::runtime_error("Snapshot has a different number of harts");
+  }
+  for (Target &target : targets_) {
+    in.get(target.mtimecmp);
+    update_deadline(target);
+  }
+}
+
+bool Clint::fast_forward(unsigned hart_id) {
+  if (targets_.size() != 1 || !instret_) {
+    return false;
+  }
+  long deadline = targets_[hart_id].lines->timer_deadline.load();
+  if (deadline == InterruptLines::never) {
+    return false;
+  }
+  if (deadline > *instret_) {
+    time_offset_ += deadline - *instret_;
+    for (auto &target : targets_) {
+      update_deadline(target);
+    }
+  }
+  return true;
+}
+
+uint64_t Clint::read(uint32_t offset, int size) {
+  if (offset < mtimecmp_offset) {
+    unsigned hart_id = offset / 4;
+    if (hart_id < targets_.size()) {
+      return (targets_[hart_id].lines->pending.load() & MIP_MSIP) ? 1 : 0;
+    }
+  } else if (offset >= mtime_offset) {
+    return extract(mtime(), offset, size);
+  } else {
+    unsigned hart_id = (offset - mtimecmp_offset) / 8;
+    if (hart_id < targets_.size()) {
+      return extract(targets_[hart_id].mtimecmp, offset, size);
+    }
+  }
+  return 0;
+}
+
+void Clint::write(uint32_t offset, uint64_t value, int size) {
+  if (offset < mtimecmp_offset) {
+    unsigned hart_id = offset / 4;
+    if (hart_id < targets_.size()) {
+      if (value & 1) {
+        targets_[hart_id].lines->raise(MIP_MSIP);
+      } else {
+        targets_[hart_id].lines->lower(MIP_MSIP);
+      }
+    }
+  } else if (offset >= mtime_offset) {
+    uint64_t now = merge(mtime(), offset, value, size);
+    time_offset_ = static_cast<long>(now) - load_instret(instret_);
+    for (auto &target : targets_) {
+      update_deadline(target);
+    }
+  } else {
+    unsigned hart_id = (offset - mtimecmp_offset) / 8;
+    if (hart_id < targets_.size()) {
+      Target &target = targets_[hart_id];
+      target.mtimecmp = merge(target.mtimecmp, offset, value, size);
+      update_deadline(target);
+    }
+  }
+}
+} // namespace sim
@@ -0,0 +1,251 @@
+#include "compressed.hpp"
+
+namespace sim {
+namespace {
+constexpr uint32_t op_load = 0x03;
+constexpr uint32_t op_load_fp = 0x07;
+constexpr uint32_t op_imm = 0x13;
+constexpr uint32_t op_imm_32 = 0x1B;
+constexpr uint32_t op_store = 0x23;
+constexpr uint32_t op_store_fp = 0x27;
+constexpr uint32_t op = 0x33;
+constexpr uint32_t op_lui = 0x37;
+constexpr uint32_t op_32 = 0x3B;
+constexpr uint32_t op_branch = 0x63;
+constexpr uint32_t op_jalr = 0x67;
+constexpr uint32_t op_jal = 0x6F;
+constexpr uint32_t ebreak = 0x00100073;
+constexpr uint32_t illegal = 0;
+
+uint32_t bits(uint32_t value, int hi, int lo) {
+  return (value >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+int32_t sign_extend(uint32_t value, int width) {
+  return static_cast<int32_t>(value << (32 - width)) >> (32 - width);
+}
+
+uint32_t r_type(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1,
+                uint32_t rs2, uint32_t funct7) {
+  return opcode | rd << 7 | funct3 << 12 | rs1 << 15 | rs2 << 20 |
+         funct7 << 25;
+}
+
+uint32_t i_type(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1,
+                int32_t imm) {
+  return opcode | rd << 7 | funct3 << 12 | rs1 << 15 |
+         (static_cast<uint32_t>(imm) & 0xFFF) << 20;
+}
+
+uint32_t s_type(uint32_t opcode, uint32_t funct3, uint32_t rs1, uint32_t rs2,
+                int32_t imm) {
+  uint32_t u = static_cast<uint32_t>(imm);
+  return opcode | bits(u, 4, 0) << 7 | funct3 << 12 | rs1 << 15 | rs2 << 20 |
+         bits(u, 11, 5) << 25;
+}
+
+uint32_t b_type(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+  uint32_t u = static_cast<uint32_t>(imm);
+  return op_branch | bits(u, 11, 11) << 7 | bits(u, 4, 1) << 8 |
+         funct3 << 12 | rs1 << 15 | rs2 << 20 | bits(u, 10, 5) << 25 |
+         bits(u, 12, 12) << 31;
+}
+
+uint32_t j_type(uint32_t rd, int32_t imm) {
+  uint32_t u = static_cast<uint32_t>(imm);
+  return op_jal | rd << 7 | bits(u, 19, 12) << 12 | bits(u, 11, 11) << 20 |
+         bits(u, 10, 1) << 21 | bits(u, 20, 20) << 31;
+}
+
+// Register fields of the CIW/CL/CS/CA/CB formats name x8-x15
+uint32_t reg_prime(uint32_t field) { return 8 + field; }
+
+// Scaled offsets of the word and doubleword loads and stores
+uint32_t offset_w(uint32_t c) {
+  return bits(c, 12, 10) << 3 | bits(c, 6, 6) << 2 | bits(c, 5, 5) << 6;
+}
+uint32_t offset_d(uint32_t c) {
+  return bits(c, 12, 10) << 3 | bits(c, 6, 5) << 6;
+}
+uint32_t offset_lwsp(uint32_t c) {
+  return bits(c, 12, 12) << 5 | bits(c, 6, 4) << 2 | bits(c, 3, 2) << 6;
+}
+uint32_t offset_ldsp(uint32_t c) {
+  return bits(c, 12, 12) << 5 | bits(c, 6, 5) << 3 | bits(c, 4, 2) << 6;
+}
+uint32_t offset_swsp(uint32_t c) {
+  return bits(c, 12, 9) << 2 | bits(c, 8, 7) << 6;
+}
+uint32_t offset_sdsp(uint32_t c) {
+  return bits(c, 12, 10) << 3 | bits(c, 9, 7) << 6;
+}
+
+int32_t imm6(uint32_t c) {
+  return sign_extend(bits(c, 12, 12) << 5 | bits(c, 6, 2), 6);
+}
+
+int32_t jump_offset(uint32_t c) {
+  return sign_extend(bits(c, 12, 12) << 11 | bits(c, 11, 11) << 4 |
+                         bits(c, 10, 9) << 8 | bits(c, 8, 8) << 10 |
+                         bits(c, 7, 7) << 6 | bits(c, 6, 6) << 7 |
+                         bits(c, 5, 3) << 1 | bits(c, 2, 2) << 5,
+                     12);
+}
+
+int32_t branch_offset(uint32_t c) {
+  return sign_extend(bits(c, 12, 12) << 8 | bits(c, 11, 10) << 3 |
+                         bits(c, 6, 5) << 6 | bits(c, 4, 3) << 1 |
+                         bits(c, 2, 2) << 5,
+                     9);
+}
+
+template <int XLEN> uint32_t expand_quadrant0(uint32_t c) {
+  uint32_t rd = reg_prime(bits(c, 4, 2));
+  uint32_t rs1 = reg_prime(bits(c, 9, 7));
+  switch (bits(c, 15, 13)) {
+  case 0: { // c.addi4spn
+    uint32_t imm = bits(c, 12, 11) << 4 | bits(c, 10, 7) << 6 |
+                   bits(c, 6, 6) << 2 | bits(c, 5, 5) << 3;
+    return imm ? i_type(op_imm, rd, 0, 2, imm) : illegal;
+  }
+  case 1: // c.fld
+    return i_type(op_load_fp, rd, 3, rs1, offset_d(c));
+  case 2: // c.lw
+    return i_type(op_load, rd, 2, rs1, offset_w(c));
+  case 3: // c.flw / c.ld
+    return XLEN == 32 ? i_type(op_load_fp, rd, 2, rs1, offset_w(c))
+                      : i_type(op_load, rd, 3, rs1, offset_d(c));
+  case 5: // c.fsd
+    return s_type(op_store_fp, 3, rs1, rd, offset_d(c));
+  case 6: // c.sw
+    return s_type(op_store, 2, rs1, rd, offset_w(c));
+  case 7: // c.fsw / c.sd
+    return XLEN == 32 ? s_type(op_store_fp, 2, rs1, rd, offset_w(c))
+                      : s_type(op_store, 3, rs1, rd, offset_d(c));
+  default:
+    return illegal;
+  }
+}
+
+template <int XLEN> uint32_t expand_quadrant1(uint32_t c) {
+  uint32_t rd = bits(c, 11, 7);
+  uint32_t rd_p = reg_prime(bits(c, 9, 7));
+  uint32_t rs2_p = reg_prime(bits(c, 4, 2));
+  switch (bits(c, 15, 13)) {
+  case 0: // c.addi, c.nop
+    return i_type(op_imm, rd, 0, rd, imm6(c));
+  case 1: // c.jal / c.addiw
+    if (XLEN == 32) {
+      return j_type(1, jump_offset(c));
+    }
+    return rd ? i_type(op_imm_32, rd, 0, rd, imm6(c)) : illegal;
+  case 2: // c.li
+    return i_type(op_imm, rd, 0, 0, imm6(c));
+  case 3: {
+    if (rd == 2) { // c.addi16sp
+      int32_t imm = sign_extend(bits(c, 12, 12) << 9 | bits(c, 6, 6) << 4 |
+                                    bits(c, 5, 5) << 6 | bits(c, 4, 3) << 7 |
+                                    bits(c, 2, 2) << 5,
+                                10);
+      return imm ? i_type(op_imm, 2, 0, 2, imm) : illegal;
+    }
+    // c.lui
+    int32_t imm = imm6(c);
+    return imm && rd ? op_lui | rd << 7 | (static_cast<uint32_t>(imm) << 12)
+                     : illegal;
+  }
+  case 4: {
+    uint32_t shamt = bits(c, 12, 12) << 5 | bits(c, 6, 2);
+    switch (bits(c, 11, 10)) {
+    case 0: // c.srli
+      return XLEN == 32 && shamt >> 5 ? illegal
+                                      : i_type(op_imm, rd_p, 5, rd_p, shamt);
+    case 1: // c.srai
+      return XLEN == 32 && shamt >> 5
+                 ? illegal
+                 : i_type(op_imm, rd_p, 5, rd_p, shamt | 0x400);
+    case 2: // c.andi
+      return i_type(op_imm, rd_p, 7, rd_p, imm6(c));
+    default:
+      break;
+    }
+    if (!bits(c, 12, 12)) {
+      static const uint32_t funct3[] = {0, 4, 6, 7}; // sub, xor, or, and
+      uint32_t sel = bits(c, 6, 5);
+      return r_type(op, rd_p, funct3[sel], rd_p, rs2_p, sel == 0 ? 0x20 : 0);
+    }
+    if (XLEN == 32 || bits(c, 6, 6)) {
+      return illegal;
+    }
+    // c.subw, c.addw
+    return r_type(op_32, rd_p, 0, rd_p, rs2_p, bits(c, 5, 5) ? 0 : 0x20);
+  }
+  case 5: // c.j
+    return j_type(0, jump_offset(c));
+  case 6: // c.beqz
+    return b_type(0, rd_p, 0, branch_offset(c));
+  case 7: // c.bnez
+    return b_type(1, rd_p, 0, branch_offset(c));
+  default:
+    return illegal;
+  }
+}
+
+template <int XLEN> uint32_t expand_quadrant2(uint32_t c) {
+  uint32_t rd = bits(c, 11, 7);
+  uint32_t rs2 = bits(c, 6, 2);
+  switch (bits(c, 15, 13)) {
+  case 0: { // c.slli
+    uint32_t shamt = bits(c, 12, 12) << 5 | rs2;
+    return XLEN == 32 && shamt >> 5 ? illegal
+                                    : i_type(op_imm, rd, 1, rd, shamt);
+  }
+  case 1: // c.fldsp
+    return i_type(op_load_fp, rd, 3, 2, offset_ldsp(c));
+  case 2: // c.lwsp
+    return rd ? i_type(op_load, rd, 2, 2, offset_lwsp(c)) : illegal;
+  case 3: // c.flwsp / c.ldsp
+    if (XLEN == 32) {
+      return i_type(op_load_fp, rd, 2, 2, offset_lwsp(c));
+    }
+    return rd ? i_type(op_load, rd, 3, 2, offset_ldsp(c)) : illegal;
+  case 4:
+    if (!bits(c, 12, 12)) {
+      if (!rs2) { // c.jr
+        return rd ? i_type(op_jalr, 0, 0, rd, 0) : illegal;
+      }
+      return r_type(op, rd, 0, 0, rs2, 0); // c.mv
+    }
+    if (!rs2) { // c.ebreak, c.jalr
+      return rd ? i_type(op_jalr, 1, 0, rd, 0) : ebreak;
+    }
+    return r_type(op, rd, 0, rd, rs2, 0); // c.add
+  case 5: // c.fsdsp
+    return s_type(op_store_fp, 3, 2, rs2, offset_sdsp(c));
+  case 6: // c.swsp
+    return s_type(op_store, 2, 2, rs2, offset_swsp(c));
+  case 7: // c.fswsp / c.sdsp
+    return XLEN == 32 ? s_type(op_store_fp, 2, 2, rs2, offset_swsp(c))
+                      : s_type(op_store, 3, 2, rs2, offset_sdsp(c));
+  default:
+    return illegal;
+  }
+}
+} // namespace
+
+template <int XLEN> uint32_t expand_compressed(uint16_t instr) {
+  switch (instr & 3) {
+  case 0:
+    return expand_quadrant0<XLEN>(instr);
+  case 1:
+    return expand_quadrant1<XLEN>(instr);
+  case 2:
+    return expand_quadrant2<XLEN>(instr);
+  default:
+    return illegal;
+  }
+}
+
+template uint32_t expand_compressed<32>(uint16_t instr);
+template uint32_t expand_compressed<64>(uint16_t instr);
+} // namespace sim
@@ -32,6 +32,9 @@ class Instruction:
     is_system: bool = False
     is_csr: bool = False
     is_w_instruction: bool = False
+    is_fp: bool = False
+    is_bitmanip: bool = False
+    is_amo: bool = False
 
 def clean_code(code: str) -> str:
     lines = []
@@ -64,6 +67,69 @@ def parse_encoding(encoding_str: str) -> tuple:
                 funct7 = '0x0'
             return instr_type, '0x33', funct3, funct7
     
+    elif '*format_r_muldiv' in encoding_str:
+        instr_type = InstructionType.R_TYPE
+        match = re.search(r'format_r_muldiv\(:(\w+)\)', encoding_str)
+        if match:
+            op_name = match.group(1)
+            funct3_map = {
+                'mul': '0x0', 'mulh': '0x1', 'mulhsu': '0x2', 'mulhu': '0x3',
+                'div': '0x4', 'divu': '0x5', 'rem': '0x6', 'remu': '0x7',
+                'mulw': '0x0', 'divw': '0x4', 'divuw': '0x5', 'remw': '0x6',
+                'remuw': '0x7'
+            }
+            opcode = '0x3B' if op_name.endswith('w') else '0x33'
+            return instr_type, opcode, funct3_map.get(op_name, '0x0'), '0x01'
+    
+    elif '*format_r_bitmanip' in encoding_str:
+        instr_type = InstructionType.R_TYPE
+        match = re.search(r'format_r_bitmanip\(:(\w+)\)', encoding_str)
+        if match:
+            op_name = match.group(1)
+            encodings = {
+                'sh1add': ('0x33', '0x2', '0x10'), 'sh2add': ('0x33', '0x4', '0x10'),
+                'sh3add': ('0x33', '0x6', '0x10'), 'andn': ('0x33', '0x7', '0x20'),
+                'orn': ('0x33', '0x6', '0x20'), 'xnor': ('0x33', '0x4', '0x20'),
+                'min': ('0x33', '0x4', '0x05'), 'minu': ('0x33', '0x5', '0x05'),
+                'max': ('0x33', '0x6', '0x05'), 'maxu': ('0x33', '0x7', '0x05'),
+                'rol': ('0x33', '0x1', '0x30'), 'ror': ('0x33', '0x5', '0x30'),
+                'zext_h': ('0x33', '0x4', '0x04'), 'add_uw': ('0x3B', '0x0', '0x04'),
+                'sh1add_uw': ('0x3B', '0x2', '0x10'), 'sh2add_uw': ('0x3B', '0x4', '0x10'),
+                'sh3add_uw': ('0x3B', '0x6', '0x10'), 'rolw': ('0x3B', '0x1', '0x30'),
+                'rorw': ('0x3B', '0x5', '0x30'),
+            }
+            opcode, funct3, funct7 = encodings[op_name]
+            return instr_type, opcode, funct3, funct7
+    
+    elif '*format_i_bitmanip' in encoding_str:
+        instr_type = InstructionType.I_TYPE
+        match = re.search(r'format_i_bitmanip\(:(\w+)\)', encoding_str)
+        if match:
+            op_name = match.group(1)
+            funct3 = '0x5' if op_name in ['rori', 'roriw', 'orc_b', 'rev8'] else '0x1'
+            opcode = '0x1B' if op_name.endswith('w') or op_name == 'slli_uw' else '0x13'
+            return instr_type, opcode, funct3, None
+    
+    elif '*format_amo' in encoding_str:
+        instr_type = InstructionType.R_TYPE
+        match = re.search(r'format_amo\(:(\w+)\)', encoding_str)
+        if match:
+            funct3 = '0x3' if match.group(1).endswith('_d') else '0x2'
+            return instr_type, '0x2F', funct3, None
+    
+    elif '*format_fp' in encoding_str:
+        instr_type = InstructionType.R_TYPE
+        match = re.search(r'format_fp\(:(\w+)\)', encoding_str)
+        if match:
+            op_name = match.group(1)
+            opcode_map = {
+                'flw': '0x07', 'fld': '0x07', 'fsw': '0x27', 'fsd': '0x27',
+                'fmadd': '0x43', 'fmsub': '0x47', 'fnmsub': '0x4B',
+                'fnmadd': '0x4F'
+            }
+            opcode = opcode_map.get(op_name, opcode_map.get(op_name[:-2], '0x53'))
+            return instr_type, opcode, None, None
+    
     elif '*format_i' in encoding_str:
         instr_type = InstructionType.I_TYPE
         match = re.search(r'format_i\((\w+),\s*(\w+)\)', encoding_str)
@@ -146,6 +212,21 @@ def parse_pseudocode(pseudocode: str) -> List[Instruction]:
             code=code
         )
         
+        if '*format_fp' in encoding:
+            instr.is_fp = True
+            instructions.append(instr)
+            continue
+        
+        if '*format_amo' in encoding:
+            instr.is_amo = True
+            instructions.append(instr)
+            continue
+        
+        if '_bitmanip' in encoding:
+            instr.is_bitmanip = True
+            instructions.append(instr)
+            continue
+        
         if instr.type == InstructionType.I_TYPE:
             instr.has_imm = True
             if name in ['slli', 'srli', 'srai', 'slliw', 'srliw', 'sraiw']:
@@ -189,11 +270,12 @@ def generate_header_file(instructions: List[Instruction]) -> str:
     header = """#pragma once
 
 #include <cstdint>
-#include "hart.hpp"
+#include <type_traits>
+#include "xlen.hpp"
 
 namespace sim {
-    using register_t = uint32_t;
-    
+    template <int XLEN> class Hart;
+
     template<typename T>
     T sign_extend(T value, int bits) {
         T sign_bit = (value >> (bits - 1)) & 1;
@@ -203,24 +285,110 @@ namespace sim {
         }
         return value;
     }
-    
+
+    template<typename T>
+    T count_leading_zeros(T value) {
+        if (value == 0) return sizeof(T) * 8;
+        if constexpr (sizeof(T) == 8) return __builtin_clzll(value);
+        else return __builtin_clz(value);
+    }
+
+    template<typename T>
+    T count_trailing_zeros(T value) {
+        if (value == 0) return sizeof(T) * 8;
+        if constexpr (sizeof(T) == 8) return __builtin_ctzll(value);
+        else return __builtin_ctz(value);
+    }
+
+    template<typename T>
+    T count_ones(T value) {
+        if constexpr (sizeof(T) == 8) return __builtin_popcountll(value);
+        else return __builtin_popcount(value);
+    }
+
+    template<typename T>
+    T byte_swap(T value) {
+        if constexpr (sizeof(T) == 8) return __builtin_bswap64(value);
+        else return __builtin_bswap32(value);
+    }
+
+    // Both rotates compile to a single host rotate instruction
+    template<typename T>
+    T rotate_left(T value, unsigned shift) {
+        return (value << shift) | (value >> (-shift & (sizeof(T) * 8 - 1)));
+    }
+
+    template<typename T>
+    T rotate_right(T value, unsigned shift) {
+        return (value >> shift) | (value << (-shift & (sizeof(T) * 8 - 1)));
+    }
+
+    // orc.b: every non-zero byte becomes 0xFF. Adding 0x7F to the low seven
+    // bits of a byte carries into its top bit unless they are all zero.
+    template<typename T>
+    T or_combine(T value) {
+        T high = (~T{0} / 0xFF) << 7;
+        T nonzero = (((value & ~high) + ~high) | value) & high;
+        return (nonzero >> 7) * 0xFF;
+    }
+
+    // Read-modify-write operations of the A extension
+    enum class AmoOp { swap, add, xor_, and_, or_, min, max, minu, maxu };
+
+    // Applies op to the naturally aligned *ptr with one host atomic operation
+    // and returns the old value. T is uint32_t or uint64_t. Everything is
+    // sequentially consistent whatever aq and rl say, which is what a locked
+    // x86 instruction costs anyway.
+    template<typename T>
+    T atomic_fetch_op(AmoOp op, T* ptr, T value) {
+        switch (op) {
+            case AmoOp::swap: return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::add: return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::xor_: return __atomic_fetch_xor(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::and_: return __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST);
+            case AmoOp::or_: return __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST);
+            default: break;
+        }
+        // The host has no fetch-min or fetch-max, so retry a compare-and-swap
+        using S = std::make_signed_t<T>;
+        T old = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+        T next;
+        do {
+            bool replace = op == AmoOp::min ? S(value) < S(old)
+                : op == AmoOp::max ? S(value) > S(old)
+                : op == AmoOp::minu ? value < old : value > old;
+            next = replace ? value : old;
+        } while (!__atomic_compare_exchange_n(ptr, &old, next, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+        return old;
+    }
+
+    // Instruction handlers for one register width, instantiated for RV32 and
+    // RV64 in generated_instructions.cpp. decode() in cached.cpp picks them.
+    template <int XLEN> struct Instructions final {
+        using register_t = typename Xlen<XLEN>::reg;
+        using sregister_t = typename Xlen<XLEN>::sreg;
+        using dregister_t = typename Xlen<XLEN>::dreg;
+        using sdregister_t = typename Xlen<XLEN>::sdreg;
+        static constexpr uint32_t shamt_mask = XLEN - 1;
+
 """
 
     generated_count = 0
     for instr in instructions:
         if instr.opcode:
-            header += f"    void exec_{instr.name}(Hart* hart, uint32_t instr);\n"
+            header += f"        static void exec_{instr.name}(Hart<XLEN>* hart, uint32_t instr);\n"
             generated_count += 1
     
-    header += """
-    bool decode_and_execute(Hart* hart, uint32_t instr);
-    
+    header += """        static void exec_ill(Hart<XLEN>* hart, uint32_t instr);
+    };
 } 
 """
     return header, generated_count
 
 def extract_imm_for_i_type(instr_name: str) -> str:
-    if instr_name in ['slli', 'srli', 'srai', 'slliw', 'srliw', 'sraiw']:
+    if instr_name in ['slli', 'srli', 'srai']:
+        return "    uint8_t shamt = (instr >> 20) & shamt_mask;"
+    elif instr_name in ['slliw', 'srliw', 'sraiw']:
         return "    uint8_t shamt = (instr >> 20) & 0x1F;"
     else:
         return """    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
@@ -234,7 +402,11 @@ def generate_extraction_code(instr: Instruction) -> str:
     if instr.type == InstructionType.R_TYPE:
         code += "    uint8_t rd = (instr >> 7) & 0x1F;\n"
         code += "    uint8_t rs1 = (instr >> 15) & 0x1F;\n"
-        code += "    uint8_t rs2 = (instr >> 20) & 0x1F;\n"
+        if instr.name in ['slliw', 'srliw', 'sraiw']:
+            # The W shifts by an immediate are encoded as R-type
+            code += "    uint8_t shamt = (instr >> 20) & 0x1F;\n"
+        else:
+            code += "    uint8_t rs2 = (instr >> 20) & 0x1F;\n"
         if instr.funct7:
             code += f"    uint32_t funct7 = (instr >> 25) & 0x7F;\n"
         
@@ -267,7 +439,7 @@ def generate_extraction_code(instr: Instruction) -> str:
         code += "    int32_t imm = ((instr & 0x80000000) >> 11) |"
         code += " ((instr >> 20) & 0x7FE) |"
         code += " ((instr & 0x100000) >> 9) |"
-        code += " ((instr & 0x7FE00000) >> 20);"
+        code += " (instr & 0xFF000);"
         code += "\n    if (imm & 0x100000) imm |= 0xFFE00000;\n"
     
     return code
@@ -284,7 +456,10 @@ def memory_read_code(addr_expr: str, bits: str, sign_extend: bool = True) -> str
         else:
             return f"static_cast<uint16_t>(hart->mem_->read_halfword({addr_expr}))"
     elif bits == '31':
-        return f"hart->mem_->read_word({addr_expr})"
+        if sign_extend:
+            return f"static_cast<int32_t>(hart->mem_->read_word({addr_expr}))"
+        else:
+            return f"hart->mem_->read_word({addr_expr})"
     elif bits == '63':
         return f"hart->mem_->read_doubleword({addr_expr})"
     else:
@@ -357,13 +532,13 @@ def translate_pseudocode_to_cpp(code: str, instr: Instruction) -> Tuple[str, boo
         sign_extend = (signed_str == 'true')
         read_code = memory_read_code(addr_expr, bits, sign_extend)
         
-        if result_bits != bits:
+        if int(result_bits) != int(bits) + 1:
             if sign_extend:
                 read_code = f"sign_extend<register_t>({read_code}, {result_bits})"
             else:
                 read_code = f"{read_code} & ((1ULL << {result_bits}) - 1)"
         
-        code = f"{var_name} = {read_code}"
+        code = read_code
         needs_result_var = True
         return code, needs_result_var
     
@@ -378,20 +553,20 @@ def translate_pseudocode_to_cpp(code: str, instr: Instruction) -> Tuple[str, boo
             
             if instr.name in ['blt', 'bge']:
                 if ' < ' in condition:
-                    condition = f"((int32_t)rs1_val < (int32_t)rs2_val)"
+                    condition = f"((sregister_t)rs1_val < (sregister_t)rs2_val)"
                 elif ' >= ' in condition:
-                    condition = f"((int32_t)rs1_val >= (int32_t)rs2_val)"
+                    condition = f"((sregister_t)rs1_val >= (sregister_t)rs2_val)"
             elif instr.name in ['bltu', 'bgeu']:
                 if ' < ' in condition:
-                    condition = f"((uint32_t)rs1_val < (uint32_t)rs2_val)"
+                    condition = f"(rs1_val < rs2_val)"
                 elif ' >= ' in condition:
-                    condition = f"((uint32_t)rs1_val >= (uint32_t)rs2_val)"
+                    condition = f"(rs1_val >= rs2_val)"
             elif '==' in condition:
                 condition = condition.replace('==', '==')
             elif '!=' in condition:
                 condition = condition.replace('!=', '!=')
             
-            return f"if ({condition}) {{\n    hart->pc += imm;\n}}", False
+            return f"if ({condition}) {{\n        hart->next_pc = hart->pc + imm;\n    }}", False
     
     if instr.name == 'jal':
         return code, True
@@ -403,7 +578,7 @@ def translate_pseudocode_to_cpp(code: str, instr: Instruction) -> Tuple[str, boo
     
     if instr.is_system:
         if instr.name == 'ecall':
-            return 'std::cerr << "ECALL instruction" << std::endl; std::exit(1);', False
+            return 'hart->sys_->handle(hart);', False
         elif instr.name == 'ebreak':
             return 'std::cerr << "EBREAK instruction" << std::endl; std::exit(1);', False
         elif instr.name == 'uret':
@@ -411,8 +586,16 @@ def translate_pseudocode_to_cpp(code: str, instr: Instruction) -> Tuple[str, boo
         elif instr.name == 'sret':
             return '// Return from exception/trap', False
         elif instr.name == 'mret':
-            return '// Return from exception/trap', False
-        elif instr.name in ['fence', 'fence_i', 'wfi', 'sfence_vma']:
+            return 'hart->mret();', False
+        elif instr.name == 'wfi':
+            return 'hart->wait_for_interrupt();', False
+        elif instr.name == 'sfence_vma':
+            return 'hart->sfence_vma(rs1, rs2);', False
+        elif instr.name == 'fence':
+            # Guest loads and stores are plain host accesses, so a full host
+            # fence orders them for the other harts
+            return 'std::atomic_thread_fence(std::memory_order_seq_cst);', False
+        elif instr.name == 'fence_i':
             return '// No-op in basic simulator', False
     
     replacements = [
@@ -445,19 +628,221 @@ def translate_pseudocode_to_cpp(code: str, instr: Instruction) -> Tuple[str, boo
         needs_result_var = True
     
     if instr.is_csr:
-        code = re.sub(r'csr\[imm_11_0\]', 'hart->csr_[imm & 0xFFF]', code)
+        code = re.sub(r'csr\[imm\]\s*=\s*(.*)', r'hart->set_csr(imm & 0xFFF, \1)', code)
+        code = re.sub(r'csr\[imm\]', 'hart->get_csr(imm & 0xFFF)', code)
         code = re.sub(r'csr\[0x(\w+)\]', r'hart->csr_[0x\1]', code)
-        code = re.sub(r'csr\[imm\]', 'hart->csr_[imm & 0xFFF]', code)
-        code = re.sub(r'csr\[(\w+)\]', r'hart->csr_[\1 & 0xFFF]', code)
         if instr.name in ['csrrwi', 'csrrsi', 'csrrci']:
-            code = re.sub(r'\brs1\b', '(rs1 & 0x1F)', code)
+            # rs1 field holds the zero-extended 5-bit immediate
+            code = re.sub(r'\brs1_val\b', 'rs1', code)
     
     return code, needs_result_var
 
+# M extension: each instruction maps onto one host multiply or divide. The
+# divide-by-zero and overflow results are the ones the spec mandates.
+MULDIV_EXPRS = {
+    'mul': 'rs1_val * rs2_val',
+    'mulh': 'static_cast<register_t>((static_cast<sdregister_t>(static_cast<sregister_t>(rs1_val)) * static_cast<sregister_t>(rs2_val)) >> XLEN)',
+    'mulhsu': 'static_cast<register_t>((static_cast<sdregister_t>(static_cast<sregister_t>(rs1_val)) * static_cast<sdregister_t>(rs2_val)) >> XLEN)',
+    'mulhu': 'static_cast<register_t>((static_cast<dregister_t>(rs1_val) * rs2_val) >> XLEN)',
+    'div': 'rs2_val == 0 ? ~register_t{0} : static_cast<sregister_t>(rs2_val) == -1 ? register_t{0} - rs1_val : static_cast<register_t>(static_cast<sregister_t>(rs1_val) / static_cast<sregister_t>(rs2_val))',
+    'divu': 'rs2_val == 0 ? ~register_t{0} : rs1_val / rs2_val',
+    'rem': 'rs2_val == 0 ? rs1_val : static_cast<sregister_t>(rs2_val) == -1 ? register_t{0} : static_cast<register_t>(static_cast<sregister_t>(rs1_val) % static_cast<sregister_t>(rs2_val))',
+    'remu': 'rs2_val == 0 ? rs1_val : rs1_val % rs2_val',
+    'mulw': 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) * static_cast<uint32_t>(rs2_val))))',
+    'divw': 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs2_val) == 0 ? -1 : static_cast<int32_t>(rs2_val) == -1 ? static_cast<int32_t>(0u - static_cast<uint32_t>(rs1_val)) : static_cast<int32_t>(rs1_val) / static_cast<int32_t>(rs2_val)))',
+    'divuw': 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs2_val) == 0 ? ~0u : static_cast<uint32_t>(rs1_val) / static_cast<uint32_t>(rs2_val))))',
+    'remw': 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs2_val) == 0 ? static_cast<int32_t>(rs1_val) : static_cast<int32_t>(rs2_val) == -1 ? 0 : static_cast<int32_t>(rs1_val) % static_cast<int32_t>(rs2_val)))',
+    'remuw': 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs2_val) == 0 ? static_cast<uint32_t>(rs1_val) : static_cast<uint32_t>(rs1_val) % static_cast<uint32_t>(rs2_val))))',
+}
+
+# F and D extensions: the handlers run on the host FPU through the hart's Fpu,
+# so each body is emitted as is. Values are (fields, body).
+def fp_handler_bodies() -> Dict[str, Tuple[List[str], str]]:
+    bodies = {}
+    types = {'s': 'float', 'd': 'double'}
+    r4 = ['rd', 'rs1', 'rs2', 'rs3', 'rm']
+    r_rm = ['rd', 'rs1', 'rs2', 'rm']
+    r = ['rd', 'rs1', 'rs2']
+    r1_rm = ['rd', 'rs1', 'rm']
+    r1 = ['rd', 'rs1']
+    bodies['flw'] = ('load', 'fpu.set_bits<float>(rd, hart->mem_->read_word(rs1_val + imm));')
+    bodies['fld'] = ('load', 'fpu.set_bits<double>(rd, hart->mem_->read_doubleword(rs1_val + imm));')
+    bodies['fsw'] = ('store', 'hart->mem_->write_word(static_cast<uint32_t>(fpu.get_bits<double>(rs2)), rs1_val + imm);')
+    bodies['fsd'] = ('store', 'hart->mem_->write_doubleword(fpu.get_bits<double>(rs2), rs1_val + imm);')
+    for p, t in types.items():
+        for name, a, c in (('fmadd', '', ''), ('fmsub', '', '-'),
+                           ('fnmsub', '-', ''), ('fnmadd', '-', '-')):
+            bodies[f'{name}_{p}'] = (r4, f'fpu.round(rm);\n    fpu.set<{t}>(rd, std::fma({a}fpu.get<{t}>(rs1), fpu.get<{t}>(rs2), {c}fpu.get<{t}>(rs3)));')
+        for name, op in (('fadd', '+'), ('fsub', '-'), ('fmul', '*'), ('fdiv', '/')):
+            bodies[f'{name}_{p}'] = (r_rm, f'fpu.round(rm);\n    fpu.set<{t}>(rd, fpu.get<{t}>(rs1) {op} fpu.get<{t}>(rs2));')
+        bodies[f'fsqrt_{p}'] = (r1_rm, f'fpu.round(rm);\n    fpu.set<{t}>(rd, std::sqrt(fpu.get<{t}>(rs1)));')
+        sign = '0x80000000u' if p == 's' else '0x8000000000000000ULL'
+        for name, e in (('fsgnj', '(a & ~sign) | (b & sign)'),
+                        ('fsgnjn', '(a & ~sign) | (~b & sign)'),
+                        ('fsgnjx', 'a ^ (b & sign)')):
+            bodies[f'{name}_{p}'] = (r, f'uint64_t sign = {sign};\n    uint64_t a = fpu.get_bits<{t}>(rs1);\n    uint64_t b = fpu.get_bits<{t}>(rs2);\n    fpu.set_bits<{t}>(rd, {e});')
+        for name, is_max in (('fmin', 'false'), ('fmax', 'true')):
+            bodies[f'{name}_{p}'] = (r, f'fpu.set<{t}>(rd, fpu.min_max(fpu.get<{t}>(rs1), fpu.get<{t}>(rs2), {is_max}));')
+        for name, args in (('feq', 'false, true, false'), ('flt', 'true, false, true'),
+                           ('fle', 'true, true, true')):
+            bodies[f'{name}_{p}'] = (r, f'register_t result = fpu.compare(fpu.get<{t}>(rs1), fpu.get<{t}>(rs2), {args});')
+        bodies[f'fclass_{p}'] = (r1, f'register_t result = Fpu::classify(fpu.get<{t}>(rs1));')
+        for it, ity in (('w', 'int32_t'), ('wu', 'uint32_t'), ('l', 'int64_t'), ('lu', 'uint64_t')):
+            conv = f'fpu.to_int<{ity}>(fpu.get<{t}>(rs1), rm)'
+            if it in ('w', 'wu'):
+                conv = f'static_cast<sregister_t>(static_cast<int32_t>({conv}))'
+            bodies[f'fcvt_{it}_{p}'] = (r1_rm, f'register_t result = static_cast<register_t>({conv});')
+            bodies[f'fcvt_{p}_{it}'] = (r1_rm, f'fpu.round(rm);\n    fpu.set<{t}>(rd, static_cast<{t}>(static_cast<{ity}>(rs1_val)));')
+    bodies['fcvt_s_d'] = (r1_rm, 'fpu.round(rm);\n    fpu.set<float>(rd, static_cast<float>(fpu.get<double>(rs1)));')
+    bodies['fcvt_d_s'] = (r1, 'fpu.set<double>(rd, fpu.get<float>(rs1));')
+    bodies['fmv_x_w'] = (r1, 'register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.get_bits<double>(rs1))));')
+    bodies['fmv_w_x'] = (r1, 'fpu.set_bits<float>(rd, rs1_val);')
+    bodies['fmv_x_d'] = (r1, 'register_t result = static_cast<register_t>(fpu.get_bits<double>(rs1));')
+    bodies['fmv_d_x'] = (r1, 'fpu.set_bits<double>(rd, rs1_val);')
+    return bodies
+
+FP_BODIES = fp_handler_bodies()
+
+FP_FIELDS = {
+    'rd': 'uint8_t rd = (instr >> 7) & 0x1F;',
+    'rs1': 'uint8_t rs1 = (instr >> 15) & 0x1F;',
+    'rs2': 'uint8_t rs2 = (instr >> 20) & 0x1F;',
+    'rs3': 'uint8_t rs3 = (instr >> 27) & 0x1F;',
+    'rm': 'uint32_t rm = (instr >> 12) & 0x7;',
+}
+
+def generate_fp_function(instr: Instruction) -> str:
+    fields, body = FP_BODIES[instr.name]
+    code = f"\ntemplate <int XLEN>\nvoid Instructions<XLEN>::exec_{instr.name}(Hart<XLEN>* hart, uint32_t instr) {{\n"
+    if fields == 'load':
+        code += f"    {FP_FIELDS['rd']}\n    {FP_FIELDS['rs1']}\n"
+        code += "    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;\n"
+    elif fields == 'store':
+        code += f"    {FP_FIELDS['rs1']}\n    {FP_FIELDS['rs2']}\n"
+        code += "    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);\n"
+        code += "    if (imm & 0x800) imm |= 0xFFFFF000;\n"
+    else:
+        code += ''.join(f"    {FP_FIELDS[f]}\n" for f in fields)
+    code += "\n"
+    if fields in ('load', 'store') or 'rs1_val' in body:
+        code += "    register_t rs1_val = hart->gpr_[rs1];\n"
+    code += "    Fpu& fpu = hart->fpu_;\n"
+    code += f"    {body}\n"
+    if 'register_t result' in body:
+        code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
+    code += "}\n"
+    return code
+
+# Zba and Zbb: the counts, byte swaps and rotates use the helpers in
+# generated_instructions.hpp, which map onto host builtins. Values are
+# (fields, expression), where fields is 'r' (rs1, rs2), 'r1' (rs1 only),
+# 'i1' (rs1 only, fixed immediate) or 'is' (rs1 and shamt).
+BITMANIP_EXPRS = {
+    'sh1add': ('r', '(rs1_val << 1) + rs2_val'),
+    'sh2add': ('r', '(rs1_val << 2) + rs2_val'),
+    'sh3add': ('r', '(rs1_val << 3) + rs2_val'),
+    'andn': ('r', 'rs1_val & ~rs2_val'),
+    'orn': ('r', 'rs1_val | ~rs2_val'),
+    'xnor': ('r', '~(rs1_val ^ rs2_val)'),
+    'min': ('r', 'static_cast<sregister_t>(rs1_val) < static_cast<sregister_t>(rs2_val) ? rs1_val : rs2_val'),
+    'minu': ('r', 'rs1_val < rs2_val ? rs1_val : rs2_val'),
+    'max': ('r', 'static_cast<sregister_t>(rs1_val) > static_cast<sregister_t>(rs2_val) ? rs1_val : rs2_val'),
+    'maxu': ('r', 'rs1_val > rs2_val ? rs1_val : rs2_val'),
+    'rol': ('r', 'rotate_left(rs1_val, rs2_val & shamt_mask)'),
+    'ror': ('r', 'rotate_right(rs1_val, rs2_val & shamt_mask)'),
+    'zext_h': ('r1', 'rs1_val & 0xFFFF'),
+    'clz': ('i1', 'count_leading_zeros(rs1_val)'),
+    'ctz': ('i1', 'count_trailing_zeros(rs1_val)'),
+    'cpop': ('i1', 'count_ones(rs1_val)'),
+    'sext_b': ('i1', 'static_cast<register_t>(static_cast<sregister_t>(static_cast<int8_t>(rs1_val)))'),
+    'sext_h': ('i1', 'static_cast<register_t>(static_cast<sregister_t>(static_cast<int16_t>(rs1_val)))'),
+    'rori': ('is', 'rotate_right(rs1_val, shamt)'),
+    'orc_b': ('i1', 'or_combine(rs1_val)'),
+    'rev8': ('i1', 'byte_swap(rs1_val)'),
+    'add_uw': ('r', 'static_cast<register_t>(static_cast<uint32_t>(rs1_val)) + rs2_val'),
+    'sh1add_uw': ('r', '(static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 1) + rs2_val'),
+    'sh2add_uw': ('r', '(static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 2) + rs2_val'),
+    'sh3add_uw': ('r', '(static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 3) + rs2_val'),
+    'slli_uw': ('is', 'static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << shamt'),
+    'clzw': ('i1', 'count_leading_zeros(static_cast<uint32_t>(rs1_val))'),
+    'ctzw': ('i1', 'count_trailing_zeros(static_cast<uint32_t>(rs1_val))'),
+    'cpopw': ('i1', 'count_ones(static_cast<uint32_t>(rs1_val))'),
+    'rolw': ('r', 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_left(static_cast<uint32_t>(rs1_val), rs2_val & 0x1F))))'),
+    'rorw': ('r', 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_right(static_cast<uint32_t>(rs1_val), rs2_val & 0x1F))))'),
+    'roriw': ('is', 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_right(static_cast<uint32_t>(rs1_val), shamt & 0x1F))))'),
+}
+
+def generate_bitmanip_function(instr: Instruction) -> str:
+    fields, expr = BITMANIP_EXPRS[instr.name]
+    code = f"\ntemplate <int XLEN>\nvoid Instructions<XLEN>::exec_{instr.name}(Hart<XLEN>* hart, uint32_t instr) {{\n"
+    code += "    uint8_t rd = (instr >> 7) & 0x1F;\n"
+    code += "    uint8_t rs1 = (instr >> 15) & 0x1F;\n"
+    if fields == 'r':
+        code += "    uint8_t rs2 = (instr >> 20) & 0x1F;\n"
+    elif fields == 'is':
+        code += "    uint8_t shamt = (instr >> 20) & shamt_mask;\n"
+    code += "\n    register_t rs1_val = hart->gpr_[rs1];\n"
+    if fields == 'r':
+        code += "    register_t rs2_val = hart->gpr_[rs2];\n"
+    code += f"    register_t result = {expr};\n"
+    code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
+    code += "}\n"
+    return code
+
+# The A extension: host atomics on a pointer into guest RAM, see
+# atomic_fetch_op in generated_instructions.hpp and Reservation in hart.hpp
+AMO_OPS = {
+    'swap': 'swap', 'add': 'add', 'xor': 'xor_', 'and': 'and_', 'or': 'or_',
+    'min': 'min', 'max': 'max', 'minu': 'minu', 'maxu': 'maxu',
+}
+
+def generate_amo_function(instr: Instruction) -> str:
+    op, width = instr.name.rsplit('_', 1)
+    size, t = (8, 'uint64_t') if width == 'd' else (4, 'uint32_t')
+    ptr = f"reinterpret_cast<{t}*>(ptr)"
+    access = 'ACCESS_READ' if op == 'lr' else 'ACCESS_WRITE'
+    code = f"\ntemplate <int XLEN>\nvoid Instructions<XLEN>::exec_{instr.name}(Hart<XLEN>* hart, uint32_t instr) {{\n"
+    code += "    uint8_t rd = (instr >> 7) & 0x1F;\n"
+    code += "    uint8_t rs1 = (instr >> 15) & 0x1F;\n"
+    if op != 'lr':
+        code += "    uint8_t rs2 = (instr >> 20) & 0x1F;\n"
+    code += "\n    register_t rs1_val = hart->gpr_[rs1];\n"
+    if op != 'lr':
+        code += "    register_t rs2_val = hart->gpr_[rs2];\n"
+    code += "    uint8_t* ptr;\n"
+    code += f"    if (!hart->mem_->atomic_ptr(rs1_val, {size}, {access}, ptr)) return;\n"
+    code += "    if (!ptr) {\n        exec_ill(hart, instr);\n        return;\n    }\n"
+    def extend(value):
+        return f"static_cast<int32_t>({value})" if width == 'w' else value
+    if op == 'lr':
+        code += f"    {t} value = __atomic_load_n({ptr}, __ATOMIC_SEQ_CST);\n"
+        code += f"    hart->reservation_ = {{ptr, {size}, value}};\n"
+        code += f"    register_t result = {extend('value')};\n"
+    elif op == 'sc':
+        code += "    Reservation reservation = hart->reservation_;\n"
+        code += "    hart->reservation_ = {};\n"
+        code += f"    {t} expected = static_cast<{t}>(reservation.value);\n"
+        code += f"    bool stored = reservation.ptr == ptr && reservation.size == {size} &&\n"
+        code += f"        __atomic_compare_exchange_n({ptr}, &expected, static_cast<{t}>(rs2_val), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);\n"
+        code += "    register_t result = stored ? 0 : 1;\n"
+    else:
+        amo_op = AMO_OPS[op[len('amo'):]]
+        code += f"    register_t result = {extend(f'atomic_fetch_op(AmoOp::{amo_op}, {ptr}, static_cast<{t}>(rs2_val))')};\n"
+    code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
+    code += "}\n"
+    return code
+
 def generate_cpp_function(instr: Instruction) -> str:
+    if instr.is_fp:
+        return generate_fp_function(instr)
+    if instr.is_bitmanip:
+        return generate_bitmanip_function(instr)
+    if instr.is_amo:
+        return generate_amo_function(instr)
+    
     func_name = f"exec_{instr.name}"
     
-    code = f"\nvoid exec_{instr.name}(Hart* hart, uint32_t instr) {{\n"
+    code = f"\ntemplate <int XLEN>\nvoid Instructions<XLEN>::exec_{instr.name}(Hart<XLEN>* hart, uint32_t instr) {{\n"
     
     code += generate_extraction_code(instr)
     
@@ -467,8 +852,9 @@ def generate_cpp_function(instr: Instruction) -> str:
         if instr.type in [InstructionType.R_TYPE, InstructionType.I_TYPE, 
                          InstructionType.B_TYPE, InstructionType.S_TYPE]:
             code += f"    register_t rs1_val = hart->gpr_[rs1];\n"
-        if instr.type in [InstructionType.R_TYPE, InstructionType.B_TYPE, 
-                         InstructionType.S_TYPE]:
+        if (instr.type in [InstructionType.R_TYPE, InstructionType.B_TYPE,
+                          InstructionType.S_TYPE] and
+                instr.name not in ['slliw', 'srliw', 'sraiw']):
             code += f"    register_t rs2_val = hart->gpr_[rs2];\n"
     
     cpp_code, needs_result_var = translate_pseudocode_to_cpp(instr.code, instr)
@@ -489,12 +875,12 @@ def generate_cpp_function(instr: Instruction) -> str:
     
     elif instr.name in ['jal', 'jalr']:
         if instr.name == 'jal':
-            code += "    register_t result = hart->pc + 4;\n"
-            code += "    hart->pc += imm;\n"
+            code += "    register_t result = hart->next_pc;\n"
+            code += "    hart->next_pc = hart->pc + imm;\n"
             code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
         elif instr.name == 'jalr':
-            code += "    register_t result = hart->pc + 4;\n"
-            code += "    hart->pc = (rs1_val + imm) & ~1;\n"
+            code += "    register_t result = hart->next_pc;\n"
+            code += "    hart->next_pc = (rs1_val + imm) & ~1;\n"
             code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
     
     elif instr.name in ['lui', 'auipc']:
@@ -505,14 +891,14 @@ def generate_cpp_function(instr: Instruction) -> str:
         code += "    if (rd != 0) hart->gpr_[rd] = result;\n"
     
     elif instr.is_csr:
-        if 'hart->csr_' in cpp_code or 'tmp =' in cpp_code:
+        if 'hart->set_csr' in cpp_code or 'tmp =' in cpp_code:
             csr_lines = cpp_code.split('\n')
             for line in csr_lines:
                 line = line.strip()
                 if line:
                     if 'tmp =' in line:
                         code += f"    register_t tmp = {line.split('=')[1].strip()};\n"
-                    elif 'hart->csr_' in line and not line.startswith('//'):
+                    elif 'hart->set_csr' in line and not line.startswith('//'):
                         code += f"    {line};\n"
                     elif 'rd[] =' in line or 'result =' in line:
                         pass
@@ -541,53 +927,48 @@ def generate_cpp_function(instr: Instruction) -> str:
                 expr = re.sub(r'imm_11_0', 'imm', expr)
                 expr = re.sub(r'shamt', 'shamt', expr)
                 
-                if ' < ' in expr and instr.name in ['slt', 'slti', 'sltu', 'sltiu', 'sltw', 'sltuw']:
-                    left, right = expr.split(' < ')
-                    left = left.strip()
-                    right = right.strip()
+                compare = re.match(r'\((\w+) < (\w+)\) \? 1 : 0$', expr.strip())
+                if compare and instr.name in ['slt', 'slti', 'sltu', 'sltiu']:
+                    left, right = compare.groups()
                     
-                    if instr.name in ['slt', 'slti', 'sltw']:
-                        expr = f"((int32_t){left}) < (int32_t)({right})"
-                    elif instr.name in ['sltu', 'sltiu', 'sltuw']:
-                        expr = f"((uint32_t){left}) < (int32_t)({right})"
+                    if instr.name in ['slt', 'slti']:
+                        expr = f"static_cast<sregister_t>({left}) < static_cast<sregister_t>({right}) ? 1 : 0"
+                    elif instr.name in ['sltu', 'sltiu']:
+                        expr = f"{left} < static_cast<register_t>({right}) ? 1 : 0"
                 elif ' >= ' in expr:
                     pass
                 elif instr.name == 'sra':
-                    expr = f"static_cast<int32_t>(rs1_val) >> (rs2_val & 0x1F)"
+                    expr = f"static_cast<sregister_t>(rs1_val) >> (rs2_val & shamt_mask)"
                 elif instr.name == 'srai':
-                    expr = f"static_cast<int32_t>(rs1_val) >> shamt"
+                    expr = f"static_cast<sregister_t>(rs1_val) >> shamt"
                 elif instr.name == 'srl':
-                    expr = f"static_cast<uint32_t>(rs1_val) >> (rs2_val & 0x1F)"
+                    expr = f"rs1_val >> (rs2_val & shamt_mask)"
                 elif instr.name == 'srli':
-                    expr = f"static_cast<uint32_t>(rs1_val) >> shamt"
+                    expr = f"rs1_val >> shamt"
                 elif instr.name == 'sll':
-                    expr = f"rs1_val << (rs2_val & 0x1F)"
+                    expr = f"rs1_val << (rs2_val & shamt_mask)"
                 elif instr.name == 'slli':
                     expr = f"rs1_val << shamt"
                 elif instr.name == 'addiw':
-                    expr = 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) + imm))'
+                    expr = 'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) + imm)))'
                 elif instr.name == 'slliw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) << shamt))'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) << shamt)))'
                 elif instr.name == 'srliw':
-                    expr = f'static_cast<register_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) >> shamt)'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) >> shamt)))'
                 elif instr.name == 'sraiw':
                     expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> shamt))'
                 elif instr.name == 'addw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) + static_cast<int32_t>(rs2_val & 0xFFFFFFFF)))'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) + static_cast<uint32_t>(rs2_val))))'
                 elif instr.name == 'subw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) - static_cast<int32_t>(rs2_val & 0xFFFFFFFF)))'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) - static_cast<uint32_t>(rs2_val))))'
                 elif instr.name == 'sllw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) << (rs2_val & 0x1F)))'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) << (rs2_val & 0x1F))))'
                 elif instr.name == 'srlw':
-                    expr = f'static_cast<register_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) >> (rs2_val & 0x1F))'
+                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) >> (rs2_val & 0x1F))))'
                 elif instr.name == 'sraw':
                     expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> (rs2_val & 0x1F)))'
-                elif instr.name == 'xorw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) ^ static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)))'
-                elif instr.name == 'orw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) | static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)))'
-                elif instr.name == 'andw':
-                    expr = f'static_cast<register_t>(static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) & static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)))'
+                elif instr.name in MULDIV_EXPRS:
+                    expr = MULDIV_EXPRS[instr.name]
                 elif instr.name in ['addi', 'add', 'sub', 'xor', 'or', 'and']:
                     pass
                 
@@ -637,133 +1018,9 @@ def transform_generated_code(impl_text: str) -> str:
             line = line.replace('((uint32_t)(rs1_val) < (int32_t)(imm) ? 1 : 0)',
                                '((uint32_t)(rs1_val < (uint32_t)imm) ? 1 : 0)')
         
-        if 'hart->pc += imm;' in line and not 'hart->pc += imm - 4;' in lines[i-1] and not 'hart->pc += imm - 4;' in lines[i+1]:
-            if any(x in ''.join(lines[max(0, i-5):i]) for x in ['exec_beq', 'exec_bne', 'exec_blt', 'exec_bge', 
-                                                                'exec_bltu', 'exec_bgeu', 'exec_jal', 'exec_jalr']):
-                line = line.replace('hart->pc += imm;', 'hart->pc += imm - 4;')
-        
         if 'rs1_val + imm + imm' in line:
             line = line.replace('rs1_val + imm + imm', 'rs1_val + imm')
         
-        if 'exec_jal(hart, instr)' in line and i > 0 and 'case' in lines[i-1]:
-            for j in range(i, max(0, i-50), -1):
-                if 'void exec_jal(Hart* hart, uint32_t instr)' in lines[j]:
-                    start_j = j
-                    while lines[start_j].strip() != '}':
-                        start_j += 1
-                    
-                    transformed_lines.extend(lines[:j])
-                    
-                    jal_fixed = '''void exec_jal(Hart* hart, uint32_t instr) {
-    uint8_t rd = (instr >> 7) & 0x1F;
-    
-    uint32_t imm_20    = (instr >> 31) & 0x1;
-    uint32_t imm_10_1  = (instr >> 21) & 0x3FF;
-    uint32_t imm_11    = (instr >> 20) & 0x1;
-    uint32_t imm_19_12 = (instr >> 12) & 0xFF;
-    
-    uint32_t imm_unsigned = (imm_20    << 20) |
-                            (imm_19_12 << 12) |
-                            (imm_11    << 11) |
-                            (imm_10_1  << 1);
-
-    int32_t imm;
-    if (imm_20) {
-        imm = imm_unsigned | 0xFFE00000;
-    } else {
-        imm = imm_unsigned;
-    }
-
-    register_t result = hart->pc;
-    hart->pc += imm - 4;
-    
-    if (rd != 0) {
-        hart->gpr_[rd] = result;
-    }
-}'''
-                    transformed_lines.append(jal_fixed)
-                    
-                    i = start_j + 1
-                    continue
-        
-        if 'exec_jalr(hart, instr)' in line and i > 0 and 'case' in lines[i-1]:
-            for j in range(i, max(0, i-50), -1):
-                if 'void exec_jalr(Hart* hart, uint32_t instr)' in lines[j]:
-                    start_j = j
-                    while lines[start_j].strip() != '}':
-                        start_j += 1
-                    
-                    transformed_lines.extend(lines[:j])
-                    
-                    jalr_fixed = '''void exec_jalr(Hart* hart, uint32_t instr) {
-    uint8_t rd = (instr >> 7) & 0x1F;
-    uint8_t rs1 = (instr >> 15) & 0x1F;
-    
-    uint32_t imm_11_0 = (instr >> 20) & 0xFFF;
-    
-    uint32_t imm_unsigned = imm_11_0;
-    
-    int32_t imm;
-    if (imm_11_0 & 0x800) {
-        imm = imm_unsigned | 0xFFFFF000;
-    } else {
-        imm = imm_unsigned;
-    }
-
-    register_t rs1_val = hart->gpr_[rs1];
-    register_t result = hart->pc;
-    hart->pc = (rs1_val + imm) & ~1;
-    
-    if (rd != 0) {
-        hart->gpr_[rd] = result;
-    }
-}'''
-                    transformed_lines.append(jalr_fixed)
-                    
-                    i = start_j + 1
-                    continue
-        
-        if 'exec_sltw' in line or 'exec_sltuw' in line:
-            for j in range(i, len(lines)):
-                if 'void exec_sltw' in lines[j] or 'void exec_sltuw' in lines[j]:
-                    func_start = j
-                    func_end = j
-                    while func_end < len(lines) and lines[func_end].strip() != '}':
-                        func_end += 1
-                    
-                    func_lines = lines[func_start:func_end+1]
-                    func_text = '\n'.join(func_lines)
-                    
-                    if 'exec_sltw' in line:
-                        fixed_sltw = '''void exec_sltw(Hart* hart, uint32_t instr) {
-    uint8_t rd = (instr >> 7) & 0x1F;
-    uint8_t rs1 = (instr >> 15) & 0x1F;
-    uint8_t rs2 = (instr >> 20) & 0x1F;
-    uint32_t funct7 = (instr >> 25) & 0x7F;
-
-    register_t rs1_val = hart->gpr_[rs1];
-    register_t rs2_val = hart->gpr_[rs2];
-    register_t result = (static_cast<int32_t>((rs1_val & 0xFFFFFFFF) < static_cast<int32_t>(rs2_val) ? 1 : 0 & 0xFFFFFFFF)) ? 1 : 0;
-    if (rd != 0) hart->gpr_[rd] = result;
-}'''
-                        transformed_lines.append(fixed_sltw)
-                    else:
-                        fixed_sltuw = '''void exec_sltuw(Hart* hart, uint32_t instr) {
-    uint8_t rd = (instr >> 7) & 0x1F;
-    uint8_t rs1 = (instr >> 15) & 0x1F;
-    uint8_t rs2 = (instr >> 20) & 0x1F;
-    uint32_t funct7 = (instr >> 25) & 0x7F;
-
-    register_t rs1_val = hart->gpr_[rs1];
-    register_t rs2_val = hart->gpr_[rs2];
-    register_t result = (static_cast<uint32_t>((rs1_val & 0xFFFFFFFF) < static_cast<uint32_t>(rs2_val) ? 1 : 0 & 0xFFFFFFFF)) ? 1 : 0;
-    if (rd != 0) hart->gpr_[rd] = result;
-}'''
-                        transformed_lines.append(fixed_sltuw)
-                    
-                    i = func_end + 1
-                    continue
-        
         if 'int32_t imm = instr & 0xFFFFF000;' in line and not '// imm[31:12] << 12' in line:
             line = line.replace('int32_t imm = instr & 0xFFFFF000;',
                                'int32_t imm = instr & 0xFFFFF000;  // imm[31:12] << 12')
@@ -780,40 +1037,38 @@ def transform_generated_code(impl_text: str) -> str:
         transformed_lines.append(line)
         i += 1
     
-    result = '\n'.join(transformed_lines)
-    
-    decode_pattern = r'case 0x0:[\s\n]*exec_(\w+)'
-    def add_comment_to_case(match):
-        instr_name = match.group(1)
-        if instr_name in ['srli', 'srai', 'srl', 'sra', 'add', 'sub', 'addw', 'subw', 
-                         'srlw', 'sraw', 'srliw', 'sraiw']:
-            return f'case 0x0: // {instr_name}'
-        return match.group(0)
-    
-    result = re.sub(decode_pattern, add_comment_to_case, result)
-    
-    decode_pattern2 = r'case 0x20:[\s\n]*exec_(\w+)'
-    def add_comment_to_case2(match):
-        instr_name = match.group(1)
-        if instr_name in ['srai', 'sra', 'sub', 'sraw', 'sraiw', 'subw']:
-            return f'case 0x20: // {instr_name}'
-        return match.group(0)
-    
-    result = re.sub(decode_pattern2, add_comment_to_case2, result)
-    
-    decode_pattern3 = r'case 0x09:[\s\n]*exec_(\w+)'
-    def add_comment_to_case3(match):
-        instr_name = match.group(1)
-        if instr_name == 'sfence_vma':
-            return f'case 0x09: // {instr_name}'
-        return match.group(0)
-    
-    result = re.sub(decode_pattern3, add_comment_to_case3, result)
-    
-    return result
+    return '\n'.join(transformed_lines)
+
+# A field and, for immediates, the sign extension that follows it
+FIELD_DECLARATION = re.compile(
+    r'^    \w+ (rd|rs1|rs2|funct7|shamt|imm|rs1_val|rs2_val) = [^;\n]*;\n'
+    r'(?:    if \(imm & \w+\) (?:\{\n        )?imm \|= \w+;\n(?:    \}\n)?)?',
+    re.MULTILINE)
+
+def drop_unused_fields(function: str) -> str:
+    # Every handler starts from the same field extraction, so the fields its
+    # body never reads are dropped to build warning-free. rs1_val going can
+    # leave rs1 unused in turn.
+    while True:
+        for match in FIELD_DECLARATION.finditer(function):
+            name = rf'\b{match.group(1)}\b'
+            if (len(re.findall(name, function)) ==
+                    len(re.findall(name, match.group(0)))):
+                function = function[:match.start()] + function[match.end():]
+                break
+        else:
+            break
+    body = function.split('{', 1)[1]
+    for param in ('Hart<XLEN>* hart', 'uint32_t instr'):
+        if not re.search(rf'\b{param.split()[-1]}\b', body):
+            function = function.replace(param, f'[[maybe_unused]] {param}', 1)
+    return function
 
 def generate_implementation_file(instructions: List[Instruction]) -> str:
     impl = """#include "generated_instructions.hpp"
+#include "hart.hpp"
+#include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <cstdlib>
@@ -825,125 +1080,19 @@ namespace sim {
     generated_count = 0
     for instr in instructions:
         if instr.opcode:
-            impl += generate_cpp_function(instr)
+            impl += drop_unused_fields(generate_cpp_function(instr))
             generated_count += 1
     
+    # Instructions are decoded by decode() in cached.cpp, which also reaches
+    # the compressed and vector handlers
     impl += """
-bool decode_and_execute(Hart* hart, uint32_t instr) {
-    if (!hart || !hart->mem_) return false;
-    
-    uint8_t opcode = instr & 0x7F;
-    uint8_t funct3 = (instr >> 12) & 0x7;
-    uint8_t funct7 = (instr >> 25) & 0x7F;
-    
-    switch (opcode) {
-"""
-    
-    opcode_groups = {}
-    for instr in instructions:
-        if instr.opcode:
-            if instr.opcode.startswith('0x'):
-                opcode_key = instr.opcode
-            else:
-                try:
-                    opcode_key = f'0x{int(instr.opcode):02X}'
-                except ValueError:
-                    opcode_key = f'0x{instr.opcode}'
-            
-            if opcode_key not in opcode_groups:
-                opcode_groups[opcode_key] = []
-            opcode_groups[opcode_key].append(instr)
-    
-    for opcode_key in sorted(opcode_groups.keys()):
-        instr_list = opcode_groups[opcode_key]
-        impl += f"        case {opcode_key}: {{\n"
-        
-        if len(instr_list) == 1 and instr_list[0].funct3 is None:
-            instr = instr_list[0]
-            impl += f"            exec_{instr.name}(hart, instr);\n"
-            impl += f"            break;\n"
-            impl += f"            }}\n"
-            continue
-        
-        impl += f"            switch (funct3) {{\n"
-        
-        funct3_groups = {}
-        for instr in instr_list:
-            if instr.funct3 is not None:
-                if instr.funct3.startswith('0x'):
-                    funct3_key = instr.funct3
-                else:
-                    try:
-                        funct3_key = f'0x{int(instr.funct3):01X}'
-                    except ValueError:
-                        funct3_key = f'0x{instr.funct3}'
-                
-                if funct3_key not in funct3_groups:
-                    funct3_groups[funct3_key] = []
-                funct3_groups[funct3_key].append(instr)
-        
-        if not funct3_groups:
-            impl += "                default:\n"
-            impl += '                    std::cerr << "Illegal instruction (no funct3 match)" << std::endl;\n'
-            impl += "                    std::exit(1);\n"
-        else:
-            for funct3_key in sorted(funct3_groups.keys()):
-                sub_instr_list = funct3_groups[funct3_key]
-                impl += f"                case {funct3_key}: {{\n"
-                
-                if len(sub_instr_list) == 1:
-                    instr = sub_instr_list[0]
-                    if instr.funct7 is None:
-                        impl += f"                    exec_{instr.name}(hart, instr);\n"
-                    else:
-                        if instr.funct7.startswith('0x'):
-                            funct7_val = instr.funct7
-                        else:
-                            try:
-                                funct7_val = f'0x{int(instr.funct7):02X}'
-                            except ValueError:
-                                funct7_val = f'0x{instr.funct7}'
-                        
-                        impl += f"                    if (funct7 == {funct7_val}) {{\n"
-                        impl += f"                        exec_{instr.name}(hart, instr);\n"
-                        impl += f"                    }} else {{\n"
-                        impl += f'                        std::cerr << "Illegal instruction (wrong funct7)" << std::endl;\n'
-                        impl += f"                        std::exit(1);\n"
-                        impl += f"                    }}\n"
-                else:
-                    impl += "                    switch (funct7) {\n"
-                    for instr in sub_instr_list:
-                        if instr.funct7 is not None:
-                            if instr.funct7.startswith('0x'):
-                                funct7_val = instr.funct7
-                            else:
-                                try:
-                                    funct7_val = f'0x{int(instr.funct7):02X}'
-                                except ValueError:
-                                    funct7_val = f'0x{instr.funct7}'
-                            
-                            impl += f"                        case {funct7_val}: \n"
-                            impl += f"                            exec_{instr.name}(hart, instr);\n"
-                            impl += f"                            break;\n"
-                    impl += "                        default:\n"
-                    impl += '                            std::cerr << "Illegal instruction (no funct7 match)" << std::endl;\n'
-                    impl += "                            std::exit(1);\n"
-                    impl += "                    }\n"
-                
-                impl += "                    break;\n"
-                impl += "                }\n"
-        
-        impl += "            }\n"
-        impl += "            break;\n"
-        impl += "        }\n"
-    
-    impl += """        default:
-            return false;
-    }
-    
-    return true;
+template <int XLEN>
+void Instructions<XLEN>::exec_ill(Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    hart->next_pc = memory_size + 1;
 }
 
+template struct Instructions<32>;
+template struct Instructions<64>;
 } 
 """
     
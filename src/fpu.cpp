@@ -0,0 +1,208 @@
+#include "fpu.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace sim {
+namespace {
+constexpr uint64_t box = 0xFFFFFFFF00000000ULL;
+
+template <typename T>
+using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+template <typename T> Bits<T> to_bits(T value) {
+  Bits<T> bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+template <typename T> T from_bits(Bits<T> bits) {
+  T value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+template <typename T> Bits<T> canonical_nan() {
+  return sizeof(T) == 4 ? 0x7FC00000u : 0x7FF8000000000000ULL;
+}
+
+template <typename T> bool is_signaling(T value) {
+  constexpr Bits<T> quiet = Bits<T>{1}
+                            << (std::numeric_limits<T>::digits - 2);
+  return std::isnan(value) && !(to_bits(value) & quiet);
+}
+} // namespace
+
+template <typename T> uint64_t Fpu::get_bits(uint8_t reg) const {
+  uint64_t raw = fpr_[reg];
+  if (sizeof(T) == 4 && (raw & box) != box) {
+    return canonical_nan<T>();
+  }
+  return sizeof(T) == 4 ? static_cast<uint32_t>(raw) : raw;
+}
+
+template <typename T> void Fpu::set_bits(uint8_t reg, uint64_t bits) {
+  fpr_[reg] = sizeof(T) == 4 ? box | static_cast<uint32_t>(bits) : bits;
+}
+
+template <typename T> T Fpu::get(uint8_t reg) const {
+  return from_bits<T>(static_cast<Bits<T>>(get_bits<T>(reg)));
+}
+
+template <typename T> void Fpu::set(uint8_t reg, T value) {
+  set_bits<T>(reg, std::isnan(value) ? canonical_nan<T>() : to_bits(value));
+}
+
+uint32_t Fpu::fflags() const {
+  int raised = std::fetestexcept(FE_ALL_EXCEPT);
+  return fflags_ | (raised & FE_INEXACT ? FFLAG_NX : 0) |
+         (raised & FE_UNDERFLOW ? FFLAG_UF : 0) |
+         (raised & FE_OVERFLOW ? FFLAG_OF : 0) |
+         (raised & FE_DIVBYZERO ? FFLAG_DZ : 0) |
+         (raised & FE_INVALID ? FFLAG_NV : 0);
+}
+
+void Fpu::set_fflags(uint32_t flags) {
+  std::feclearexcept(FE_ALL_EXCEPT);
+  fflags_ = flags & 0x1F;
+}
+
+void Fpu::round(uint32_t rm) {
+  int mode;
+  switch (effective_rm(rm)) {
+  case RM_RTZ:
+    mode = FE_TOWARDZERO;
+    break;
+  case RM_RDN:
+    mode = FE_DOWNWARD;
+    break;
+  case RM_RUP:
+    mode = FE_UPWARD;
+    break;
+  default:
+    mode = FE_TONEAREST;
+    break;
+  }
+  if (mode != host_rounding_) {
+    std::fesetround(mode);
+    host_rounding_ = mode;
+  }
+}
+
+void Fpu::sync() {
+  fflags_ = fflags();
+  std::feclearexcept(FE_ALL_EXCEPT);
+  round(RM_RNE);
+}
+
+void Fpu::discard_host_flags() { std::feclearexcept(FE_ALL_EXCEPT); }
+
+void Fpu::save(StateWriter &out) const {
+  out.put(fpr_);
+  out.put(fflags_);
+  out.put(frm_);
+}
+
+void Fpu::restore(StateReader &in) {
+  in.get(fpr_);
+  in.get(fflags_);
+  in.get(frm_);
+}
+
+template <typename T> T Fpu::min_max(T a, T b, bool max) {
+  if (is_signaling(a) || is_signaling(b)) {
+    raise(FFLAG_NV);
+  }
+  if (std::isnan(a)) {
+    return std::isnan(b) ? from_bits<T>(canonical_nan<T>()) : b;
+  }
+  if (std::isnan(b)) {
+    return a;
+  }
+  if (a == b) {
+    // -0.0 is smaller than +0.0
+    return std::signbit(a) == max ? b : a;
+  }
+  return (a < b) == max ? b : a;
+}
+
+template <typename T>
+bool Fpu::compare(T a, T b, bool less, bool equal, bool signaling) {
+  if (std::isnan(a) || std::isnan(b)) {
+    if (signaling || is_signaling(a) || is_signaling(b)) {
+      raise(FFLAG_NV);
+    }
+    return false;
+  }
+  return (less && a < b) || (equal && a == b);
+}
+
+template <typename T> uint32_t Fpu::classify(T value) {
+  bool negative = std::signbit(value);
+  switch (std::fpclassify(value)) {
+  case FP_INFINITE:
+    return negative ? 1 << 0 : 1 << 7;
+  case FP_NORMAL:
+    return negative ? 1 << 1 : 1 << 6;
+  case FP_SUBNORMAL:
+    return negative ? 1 << 2 : 1 << 5;
+  case FP_ZERO:
+    return negative ? 1 << 3 : 1 << 4;
+  default:
+    return is_signaling(value) ? 1 << 8 : 1 << 9;
+  }
+}
+
+template <typename I, typename T> I Fpu::to_int(T value, uint32_t rm) {
+  if (std::isnan(value)) {
+    raise(FFLAG_NV);
+    return std::numeric_limits<I>::max();
+  }
+
+  T rounded;
+  if (effective_rm(rm) == RM_RMM) {
+    rounded = std::round(value);
+  } else {
+    Fpu::round(rm);
+    rounded = std::nearbyint(value);
+  }
+
+  // Both bounds are powers of two, so they are exact in T
+  T upper = std::ldexp(T{1}, std::numeric_limits<I>::digits);
+  T lower = std::is_signed_v<I> ? -upper : T{0};
+  if (rounded < lower || rounded >= upper) {
+    raise(FFLAG_NV);
+    return value < 0 ? std::numeric_limits<I>::min()
+                     : std::numeric_limits<I>::max();
+  }
+  if (rounded != value) {
+    raise(FFLAG_NX);
+  }
+  return static_cast<I>(rounded);
+}
+
+template float Fpu::get<float>(uint8_t) const;
+template double Fpu::get<double>(uint8_t) const;
+template void Fpu::set<float>(uint8_t, float);
+template void Fpu::set<double>(uint8_t, double);
+template uint64_t Fpu::get_bits<float>(uint8_t) const;
+template uint64_t Fpu::get_bits<double>(uint8_t) const;
+template void Fpu::set_bits<float>(uint8_t, uint64_t);
+template void Fpu::set_bits<double>(uint8_t, uint64_t);
+template float Fpu::min_max<float>(float, float, bool);
+template double Fpu::min_max<double>(double, double, bool);
+template bool Fpu::compare<float>(float, float, bool, bool, bool);
+template bool Fpu::compare<double>(double, double, bool, bool, bool);
+template uint32_t Fpu::classify<float>(float);
+template uint32_t Fpu::classify<double>(double);
+template int32_t Fpu::to_int<int32_t, float>(float, uint32_t);
+template uint32_t Fpu::to_int<uint32_t, float>(float, uint32_t);
+template int64_t Fpu::to_int<int64_t, float>(float, uint32_t);
+template uint64_t Fpu::to_int<uint64_t, float>(float, uint32_t);
+template int32_t Fpu::to_int<int32_t, double>(double, uint32_t);
+template uint32_t Fpu::to_int<uint32_t, double>(double, uint32_t);
+template int64_t Fpu::to_int<int64_t, double>(double, uint32_t);
+template uint64_t Fpu::to_int<uint64_t, double>(double, uint32_t);
+} // namespace sim
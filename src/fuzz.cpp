@@ -0,0 +1,263 @@
+#include "fuzz.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string_view>
+
+namespace sim {
+namespace {
+// Instructions per execution when no --limit is given
+constexpr long default_limit = 1000000;
+constexpr std::uint64_t ram_size = memory_size;
+
+// Hit counts of an edge fall into classes, one bit each, so that a loop
+// running a few more times is new only when it crosses into another class
+const std::array<std::uint8_t, 256> &hit_classes() {
+  static const std::array<std::uint8_t, 256> classes = [] {
+    std::array<std::uint8_t, 256> table{};
+    for (std::size_t count = 1; count < table.size(); ++count) {
+      table[count] = count <= 2    ? static_cast<std::uint8_t>(count)
+                     : count == 3  ? 4
+                     : count < 8   ? 8
+                     : count < 16  ? 16
+                     : count < 32  ? 32
+                     : count < 128 ? 64
+                                   : 128;
+    }
+    return table;
+  }();
+  return classes;
+}
+} // namespace
+
+Fuzzer::Fuzzer(std::uint64_t entry, std::filesystem::path corpus_dir,
+               std::size_t runs, long limit)
+    : entry_(entry), corpus_dir_(std::move(corpus_dir)), runs_(runs),
+      limit_(limit > 0 ? limit : default_limit), trace_(coverage_size),
+      seen_(coverage_size), seen_crashes_(coverage_size) {}
+
+void Fuzzer::read_corpus() {
+  std::filesystem::create_directories(corpus_dir_ / "crashes");
+  std::vector<std::filesystem::path> files;
+  for (const auto &entry : std::filesystem::directory_iterator(corpus_dir_)) {
+    if (entry.is_regular_file()) {
+      files.push_back(entry.path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  for (const auto &path : files) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<std::uint8_t> input((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+    input.resize(std::min<std::uint64_t>(input.size(), capacity_));
+    corpus_.push_back(std::move(input));
+  }
+  if (corpus_.empty()) {
+    corpus_.emplace_back();
+  }
+}
+
+std::vector<std::uint8_t> Fuzzer::mutate() {
+  auto below = [this](std::size_t n) {
+    return static_cast<std::size_t>(random_() % n);
+  };
+  static constexpr std::uint8_t interesting[] = {0,   1,   16,  32, 64,
+                                                 100, 127, 128, 255};
+
+  std::vector<std::uint8_t> input = corpus_[below(corpus_.size())];
+  std::size_t n_mutations = std::size_t{1} << below(4);
+  for (std::size_t i = 0; i < n_mutations; ++i) {
+    std::size_t pos = input.empty() ? 0 : below(input.size());
+    std::size_t op = below(7);
+    if (input.empty() && op < 5) {
+      op = 5;
+    }
+    switch (op) {
+    case 0:
+      input[pos] ^= static_cast<std::uint8_t>(1u << below(8));
+      break;
+    case 1:
+      input[pos] = static_cast<std::uint8_t>(random_());
+      break;
+    case 2:
+      input[pos] = interesting[below(std::size(interesting))];
+      break;
+    case 3:
+      input[pos] = static_cast<std::uint8_t>(input[pos] + below(33) - 16);
+      break;
+    case 4: {
+      std::size_t n = 1 + below(std::min<std::size_t>(input.size(), 8));
+      auto first = input.begin() + below(input.size() - n + 1);
+      input.erase(first, first + n);
+      break;
+    }
+    case 5: {
+      std::size_t n = 1 + below(8);
+      input.insert(input.begin() + below(input.size() + 1), n,
+                   static_cast<std::uint8_t>(random_()));
+      break;
+    }
+    default: {
+      // A piece of another input
+      const auto &other = corpus_[below(corpus_.size())];
+      if (other.empty()) {
+        break;
+      }
+      std::size_t n = 1 + below(other.size());
+      auto first = other.begin() + below(other.size() - n + 1);
+      input.insert(input.begin() + below(input.size() + 1), first,
+                   first + n);
+      break;
+    }
+    }
+  }
+  input.resize(std::min<std::uint64_t>(input.size(), capacity_));
+  return input;
+}
+
+Fuzzer::Outcome Fuzzer::execute(MachineBase &machine,
+                                const std::vector<std::uint8_t> &input,
+                                std::string &reason) {
+  machine.reset();
+  std::memcpy(machine.memory().writable_ptr(
+                  static_cast<std::uint32_t>(buffer_), input.size()),
+              input.data(), input.size());
+  machine.set_register(11, input.size());
+  try {
+    machine.resume();
+  } catch (const std::exception &e) {
+    reason = e.what();
+    return Outcome::crash;
+  }
+  if (machine.pc() == return_) {
+    return Outcome::ok;
+  }
+  if (machine.out_of_budget()) {
+    return Outcome::hang;
+  }
+  if (machine.pc() >= ram_size) {
+    reason = "jump outside RAM";
+    return Outcome::crash;
+  }
+  if (machine.exit_code() != 0) {
+    reason = "exit code " + std::to_string(machine.exit_code());
+    return Outcome::crash;
+  }
+  return Outcome::ok;
+}
+
+bool Fuzzer::merge(std::vector<std::uint8_t> &seen) {
+  const auto &classes = hit_classes();
+  bool found = false;
+  // Most of the map is untouched, so it is skipped 64 bytes at a time
+  for (std::size_t i = 0; i < coverage_size; i += 64) {
+    std::uint64_t words[8];
+    std::memcpy(words, &trace_[i], sizeof(words));
+    std::uint64_t any = 0;
+    for (std::uint64_t word : words) {
+      any |= word;
+    }
+    if (any == 0) {
+      continue;
+    }
+    for (std::size_t k = i; k < i + 64; ++k) {
+      std::uint8_t hits = classes[trace_[k]];
+      if (hits & ~seen[k]) {
+        seen[k] |= hits;
+        found = true;
+      }
+    }
+    std::memset(&trace_[i], 0, sizeof(words));
+  }
+  return found;
+}
+
+void Fuzzer::save(const std::filesystem::path &dir,
+                  const std::vector<std::uint8_t> &input) {
+  std::string_view bytes(reinterpret_cast<const char *>(input.data()),
+                         input.size());
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0')
+       << std::hash<std::string_view>{}(bytes);
+  std::filesystem::path path = dir / name.str();
+  std::ofstream file(path, std::ios::binary);
+  file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    throw std::runtime_error("Cannot write " + path.string());
+  }
+}
+
+int Fuzzer::run(MachineBase &machine) {
+  if (machine.harts() != 1) {
+    throw std::invalid_argument("Fuzzing runs single-hart programs");
+  }
+  machine.set_quiet(true);
+  machine.set_instruction_limit(std::numeric_limits<long>::max());
+  machine.set_breakpoint(entry_);
+  int exit_code = machine.run();
+  if (machine.pc() != entry_) {
+    std::cout << "Program exited after " << machine.instructions()
+              << " instructions, before the fuzzed function" << std::endl;
+    return exit_code;
+  }
+  buffer_ = machine.get_register(10);
+  capacity_ = machine.get_register(11);
+  return_ = machine.get_register(1);
+  if (buffer_ >= ram_size || capacity_ > ram_size - buffer_) {
+    throw std::runtime_error("The buffer of the fuzzed function is not in "
+                             "RAM");
+  }
+  machine.set_breakpoint(return_);
+  machine.set_instruction_limit(machine.instructions() + limit_);
+  machine.set_coverage(trace_.data());
+  machine.set_baseline();
+  read_corpus();
+
+  auto start = std::chrono::steady_clock::now();
+  std::size_t n_seeds = corpus_.size();
+  long crashes = 0;
+  long saved_crashes = 0;
+  long hangs = 0;
+  for (std::size_t i = 0; i < runs_; ++i) {
+    std::vector<std::uint8_t> input = i < n_seeds ? corpus_[i] : mutate();
+    std::string reason;
+    Outcome outcome = execute(machine, input, reason);
+    if (outcome == Outcome::hang) {
+      ++hangs;
+      std::fill(trace_.begin(), trace_.end(), 0);
+    } else if (outcome == Outcome::crash) {
+      ++crashes;
+      if (merge(seen_crashes_)) {
+        ++saved_crashes;
+        save(corpus_dir_ / "crashes", input);
+        std::cout << "Crash in run " << i + 1 << ": " << reason << std::endl;
+      }
+    } else if (merge(seen_) && i >= n_seeds) {
+      save(corpus_dir_, input);
+      corpus_.push_back(std::move(input));
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::size_t edges =
+      seen_.size() - static_cast<std::size_t>(
+                         std::count(seen_.begin(), seen_.end(), 0));
+  std::cout << "Runs: " << runs_ << " in " << elapsed.count() << " s, "
+            << static_cast<double>(runs_) / elapsed.count() << " per second"
+            << std::endl;
+  std::cout << "Coverage: " << edges << " edges, " << corpus_.size()
+            << " inputs in the corpus" << std::endl;
+  std::cout << "Crashes: " << crashes << ", " << saved_crashes
+            << " saved; hangs: " << hangs << std::endl;
+  return 0;
+}
+} // namespace sim
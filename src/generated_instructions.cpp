@@ -1,1234 +1,2380 @@
 #include "generated_instructions.hpp"
 #include "hart.hpp"
+#include <atomic>
+#include <cmath>
 #include <cstdint>
-#include <cstdlib>
 #include <iostream>
+#include <cstdlib>
 
 namespace sim {
 
-// ADD instruction
-void exec_add(Hart *hart, uint32_t instr) {
-  // std::cout << "ADD instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val + rs2_val;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SUB instruction
-void exec_sub(Hart *hart, uint32_t instr) {
-  // std::cout << "SUB instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val - rs2_val;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLL instruction
-void exec_sll(Hart *hart, uint32_t instr) {
-  // std::cout << "SLL instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val << (rs2_val & 0x1F);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLT instruction
-void exec_slt(Hart *hart, uint32_t instr) {
-  // std::cout << "SLT instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = ((int32_t)(rs1_val < (int32_t)rs2_val) ? 1 : 0) ? 1 : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLTU instruction
-void exec_sltu(Hart *hart, uint32_t instr) {
-  // std::cout << "SLTU instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = ((uint32_t)(rs1_val < (uint32_t)rs2_val) ? 1 : 0) ? 1 : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// XOR instruction
-void exec_xor(Hart *hart, uint32_t instr) {
-  // std::cout << "XOR instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val ^ rs2_val;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRL instruction
-void exec_srl(Hart *hart, uint32_t instr) {
-  // std::cout << "SRL instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<uint32_t>(rs1_val) >> (rs2_val & 0x1F);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRA instruction
-void exec_sra(Hart *hart, uint32_t instr) {
-  // std::cout << "SRA instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<int32_t>(rs1_val) >> (rs2_val & 0x1F);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// OR instruction
-void exec_or(Hart *hart, uint32_t instr) {
-  // std::cout << "OR instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val | rs2_val;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// AND instruction
-void exec_and(Hart *hart, uint32_t instr) {
-  // std::cout << "AND instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = rs1_val & rs2_val;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ADDI instruction
-void exec_addi(Hart *hart, uint32_t instr) {
-  // std::cout << "ADDI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = rs1_val + imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLTI instruction
-void exec_slti(Hart *hart, uint32_t instr) {
-  // std::cout << "SLTI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = ((int32_t)(rs1_val < (int32_t)imm) ? 1 : 0) ? 1 : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLTIU instruction
-void exec_sltiu(Hart *hart, uint32_t instr) {
-  // std::cout << "SLTIU instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = ((uint32_t)(rs1_val < (uint32_t)imm) ? 1 : 0) ? 1 : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// XORI instruction
-void exec_xori(Hart *hart, uint32_t instr) {
-  // std::cout << "XORI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = rs1_val ^ imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ORI instruction
-void exec_ori(Hart *hart, uint32_t instr) {
-  // std::cout << "ORI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = rs1_val | imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ANDI instruction
-void exec_andi(Hart *hart, uint32_t instr) {
-  // std::cout << "ANDI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = rs1_val & imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLLI instruction
-void exec_slli(Hart *hart, uint32_t instr) {
-  // std::cout << "SLLI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = rs1_val << shamt;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRLI instruction
-void exec_srli(Hart *hart, uint32_t instr) {
-  // std::cout << "SRLI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<uint32_t>(rs1_val) >> shamt;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRAI instruction
-void exec_srai(Hart *hart, uint32_t instr) {
-  // std::cout << "SRAI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<int32_t>(rs1_val) >> shamt;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LB instruction
-void exec_lb(Hart *hart, uint32_t instr) {
-  // std::cout << "LB instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<int8_t>(hart->mem_->read_byte(rs1_val + imm));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LH instruction
-void exec_lh(Hart *hart, uint32_t instr) {
-  // std::cout << "LH instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result =
-      static_cast<int16_t>(hart->mem_->read_halfword(rs1_val + imm));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LW instruction
-void exec_lw(Hart *hart, uint32_t instr) {
-  // std::cout << "LW instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = hart->mem_->read_word(rs1_val + imm);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LBU instruction
-void exec_lbu(Hart *hart, uint32_t instr) {
-  // std::cout << "LBU instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result =
-      static_cast<uint8_t>(hart->mem_->read_byte(rs1_val + imm));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LHU instruction
-void exec_lhu(Hart *hart, uint32_t instr) {
-  // std::cout << "LHU instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result =
-      static_cast<uint16_t>(hart->mem_->read_halfword(rs1_val + imm));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SB instruction
-void exec_sb(Hart *hart, uint32_t instr) {
-  // std::cout << "SB instruction" << std::endl;
-  // S-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
-  if (imm & 0x800)
-    imm |= 0xFFFFF000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  hart->mem_->write_byte(rs2_val & 0xFF, rs1_val + imm);
-}
-
-// SH instruction
-void exec_sh(Hart *hart, uint32_t instr) {
-  // std::cout << "SH instruction" << std::endl;
-  // S-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
-  if (imm & 0x800)
-    imm |= 0xFFFFF000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  hart->mem_->write_halfword(rs2_val & 0xFFFF, rs1_val + imm);
-}
-
-// SW instruction
-void exec_sw(Hart *hart, uint32_t instr) {
-  // std::cout << "SW instruction" << std::endl;
-  // S-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
-  if (imm & 0x800)
-    imm |= 0xFFFFF000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  hart->mem_->write_word(rs2_val, rs1_val + imm);
-}
-
-// BEQ instruction
-void exec_beq(Hart *hart, uint32_t instr) {
-  // std::cout << "BEQ instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (rs1_val == rs2_val) {
-    hart->pc += imm - 4;
-  }
-}
-
-// BNE instruction
-void exec_bne(Hart *hart, uint32_t instr) {
-  // std::cout << "BNE instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (rs1_val != rs2_val) {
-    hart->pc += imm - 4;
-  }
-}
-
-// BLT instruction
-void exec_blt(Hart *hart, uint32_t instr) {
-  // std::cout << "BLT instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (((int32_t)rs1_val < (int32_t)rs2_val)) {
-    hart->pc += imm - 4;
-  }
-}
-
-// BGE instruction
-void exec_bge(Hart *hart, uint32_t instr) {
-  // std::cout << "BGE instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (((int32_t)rs1_val >= (int32_t)rs2_val)) {
-    hart->pc += imm - 4;
-  }
-}
-
-// BLTU instruction
-void exec_bltu(Hart *hart, uint32_t instr) {
-  // std::cout << "BLTU instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (((uint32_t)rs1_val < (uint32_t)rs2_val)) {
-    hart->pc += imm - 4;
-  }
-}
-
-// BGEU instruction
-void exec_bgeu(Hart *hart, uint32_t instr) {
-  // std::cout << "BGEU instruction" << std::endl;
-  // B-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) |
-                ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
-  if (imm & 0x1000)
-    imm |= 0xFFFFE000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  if (((uint32_t)rs1_val >= (uint32_t)rs2_val)) {
-    hart->pc += imm - 4;
-  }
-}
-
-// JAL instruction
-void exec_jal(Hart *hart, uint32_t instr) {
-  // std::cout << "JAL instruction" << std::endl;
-
-  uint8_t rd = (instr >> 7) & 0x1F;
-
-  uint32_t imm_20 = (instr >> 31) & 0x1;
-  uint32_t imm_10_1 = (instr >> 21) & 0x3FF;
-  uint32_t imm_11 = (instr >> 20) & 0x1;
-  uint32_t imm_19_12 = (instr >> 12) & 0xFF;
-
-  uint32_t imm_unsigned =
-      (imm_20 << 20) | (imm_19_12 << 12) | (imm_11 << 11) | (imm_10_1 << 1);
-
-  int32_t imm;
-  if (imm_20) {
-    imm = imm_unsigned | 0xFFE00000;
-  } else {
-    imm = imm_unsigned;
-  }
-
-  register_t result = hart->pc;
-  hart->pc += imm - 4;
-
-  if (rd != 0) {
-    hart->gpr_[rd] = result;
-  }
-}
-
-// JALR instruction
-void exec_jalr(Hart *hart, uint32_t instr) {
-  // std::cout << "JALR instruction" << std::endl;
-
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-
-  uint32_t imm_11_0 = (instr >> 20) & 0xFFF;
-
-  uint32_t imm_unsigned = imm_11_0;
-
-  int32_t imm;
-  if (imm_11_0 & 0x800) {
-    imm = imm_unsigned | 0xFFFFF000;
-  } else {
-    imm = imm_unsigned;
-  }
-
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = hart->pc;
-  hart->pc = (rs1_val + imm) & ~1;
-
-  if (rd != 0) {
-    hart->gpr_[rd] = result;
-  }
-}
-
-// LUI instruction
-void exec_lui(Hart *hart, uint32_t instr) {
-  // std::cout << "LUI instruction" << std::endl;
-  // U-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  int32_t imm = instr & 0xFFFFF000; // imm[31:12] << 12
-  register_t result = imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// AUIPC instruction
-void exec_auipc(Hart *hart, uint32_t instr) {
-  // std::cout << "AUIPC instruction" << std::endl;
-  // U-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  int32_t imm = instr & 0xFFFFF000; // imm[31:12] << 12
-  register_t result = hart->pc + imm;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// FENCE instruction
-void exec_fence(Hart *hart, uint32_t instr) {
-  // std::cout << "FENCE instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-}
-
-// FENCE_I instruction
-void exec_fence_i(Hart *hart, uint32_t instr) {
-  // std::cout << "FENCE_I instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-}
-
-// CSRRW instruction
-void exec_csrrw(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRW instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// CSRRS instruction
-void exec_csrrs(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRS instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = tmp | rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// CSRRC instruction
-void exec_csrrc(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRC instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = tmp & ~rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// CSRRWI instruction
-void exec_csrrwi(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRWI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// CSRRSI instruction
-void exec_csrrsi(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRSI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = tmp | rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// CSRRCI instruction
-void exec_csrrci(Hart *hart, uint32_t instr) {
-  // std::cout << "CSRRCI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t tmp = hart->csr_[imm & 0xFFF];
-  hart->csr_[imm & 0xFFF] = tmp & ~rs1_val;
-  if (rd != 0)
-    hart->gpr_[rd] = tmp;
-}
-
-// ECALL instruction
-void exec_ecall(Hart *hart, uint32_t instr) {
-  // std::cout << "ECALL instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  std::cerr << "ECALL instruction" << std::endl;
-  std::exit(1);
-}
-
-// EBREAK instruction
-void exec_ebreak(Hart *hart, uint32_t instr) {
-  // std::cout << "EBREAK instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  std::cerr << "EBREAK instruction" << std::endl;
-  std::exit(1);
-}
-
-// URET instruction
-void exec_uret(Hart *hart, uint32_t instr) {
-  // std::cout << "URET instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  std::cerr << "URET instruction (not implemented)" << std::endl;
-  std::exit(1);
-}
-
-// SRET instruction
-void exec_sret(Hart *hart, uint32_t instr) {
-  // std::cout << "SRET instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-}
-
-// MRET instruction
-void exec_mret(Hart *hart, uint32_t instr) {
-  // std::cout << "MRET instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-}
-
-// WFI instruction
-void exec_wfi(Hart *hart, uint32_t instr) {
-  // std::cout << "WFI instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-}
-
-// SFENCE_VMA instruction
-void exec_sfence_vma(Hart *hart, uint32_t instr) {
-  // std::cout << "SFENCE_VMA instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-}
-
-// ADDIW instruction
-void exec_addiw(Hart *hart, uint32_t instr) {
-  // std::cout << "ADDIW instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) + imm));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLLIW instruction
-void exec_slliw(Hart *hart, uint32_t instr) {
-  // std::cout << "SLLIW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<register_t>(static_cast<int64_t>(
-      static_cast<int32_t>(rs1_val & 0xFFFFFFFF) << shamt));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRLIW instruction
-void exec_srliw(Hart *hart, uint32_t instr) {
-  // std::cout << "SRLIW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<register_t>(
-      static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) >> shamt);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRAIW instruction
-void exec_sraiw(Hart *hart, uint32_t instr) {
-  // std::cout << "SRAIW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t shamt = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = static_cast<register_t>(static_cast<int64_t>(
-      static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> shamt));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ADDW instruction
-void exec_addw(Hart *hart, uint32_t instr) {
-  // std::cout << "ADDW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) +
-                           static_cast<int32_t>(rs2_val & 0xFFFFFFFF)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SUBW instruction
-void exec_subw(Hart *hart, uint32_t instr) {
-  // std::cout << "SUBW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) -
-                           static_cast<int32_t>(rs2_val & 0xFFFFFFFF)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLLW instruction
-void exec_sllw(Hart *hart, uint32_t instr) {
-  // std::cout << "SLLW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(static_cast<int64_t>(
-      static_cast<int32_t>(rs1_val & 0xFFFFFFFF) << (rs2_val & 0x1F)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRLW instruction
-void exec_srlw(Hart *hart, uint32_t instr) {
-  // std::cout << "SRLW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) >> (rs2_val & 0x1F));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SRAW instruction
-void exec_sraw(Hart *hart, uint32_t instr) {
-  // std::cout << "SRAW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(static_cast<int64_t>(
-      static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> (rs2_val & 0x1F)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLTW instruction
-void exec_sltw(Hart *hart, uint32_t instr) {
-  // std::cout << "SLTW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = (static_cast<int32_t>(
-                          (rs1_val & 0xFFFFFFFF) < static_cast<int32_t>(rs2_val)
-                              ? 1
-                              : 0 & 0xFFFFFFFF))
-                          ? 1
-                          : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SLTUW instruction
-void exec_sltuw(Hart *hart, uint32_t instr) {
-  // std::cout << "SLTUW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result =
-      (static_cast<uint32_t>((rs1_val & 0xFFFFFFFF) <
-                                     static_cast<uint32_t>(rs2_val)
-                                 ? 1
-                                 : 0 & 0xFFFFFFFF))
-          ? 1
-          : 0;
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// XORW instruction
-void exec_xorw(Hart *hart, uint32_t instr) {
-  // std::cout << "XORW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) ^
-                           static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ORW instruction
-void exec_orw(Hart *hart, uint32_t instr) {
-  // std::cout << "ORW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) |
-                           static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// ANDW instruction
-void exec_andw(Hart *hart, uint32_t instr) {
-  // std::cout << "ANDW instruction" << std::endl;
-  // R-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  uint32_t funct7 = (instr >> 25) & 0x7F;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  register_t result = static_cast<register_t>(
-      static_cast<int64_t>(static_cast<uint32_t>(rs1_val & 0xFFFFFFFF) &
-                           static_cast<uint32_t>(rs2_val & 0xFFFFFFFF)));
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LD instruction
-void exec_ld(Hart *hart, uint32_t instr) {
-  // std::cout << "LD instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = hart->mem_->read_doubleword(rs1_val + imm);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// LWU instruction
-void exec_lwu(Hart *hart, uint32_t instr) {
-  // std::cout << "LWU instruction" << std::endl;
-  // I-type instruction fields
-  uint8_t rd = (instr >> 7) & 0x1F;
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
-  if (imm & 0x800) {
-    imm |= 0xFFFFF000;
-  }
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t result = hart->mem_->read_word(rs1_val + imm) & ((1ULL << 32) - 1);
-  if (rd != 0)
-    hart->gpr_[rd] = result;
-}
-
-// SD instruction
-void exec_sd(Hart *hart, uint32_t instr) {
-  // std::cout << "SD instruction" << std::endl;
-  // S-type instruction fields
-  uint8_t rs1 = (instr >> 15) & 0x1F;
-  uint8_t rs2 = (instr >> 20) & 0x1F;
-  int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
-  if (imm & 0x800)
-    imm |= 0xFFFFF000;
-
-  // Get register values
-  register_t rs1_val = hart->gpr_[rs1];
-  register_t rs2_val = hart->gpr_[rs2];
-  hart->mem_->write_doubleword(rs2_val, rs1_val + imm);
-}
-
-void exec_ill(Hart *hart, uint32_t instr) { hart->pc = memory_size + 1; }
-} // namespace sim
\ No newline at end of file
+
+template <int XLEN>
+void Instructions<XLEN>::exec_add(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sub(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val - rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sll(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val << (rs2_val & shamt_mask);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_slt(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<sregister_t>(rs1_val) < static_cast<sregister_t>(rs2_val) ? 1 : 0;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sltu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val < static_cast<register_t>(rs2_val) ? 1 : 0;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_xor(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val ^ rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_srl(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val >> (rs2_val & shamt_mask);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sra(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<sregister_t>(rs1_val) >> (rs2_val & shamt_mask);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_or(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val | rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_and(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val & rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_addi(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val + imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_slti(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<sregister_t>(rs1_val) < static_cast<sregister_t>(imm) ? 1 : 0;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sltiu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val < static_cast<register_t>(imm) ? 1 : 0;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_xori(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val ^ imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ori(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val | imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_andi(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val & imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_slli(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val << shamt;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_srli(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val >> shamt;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_srai(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<sregister_t>(rs1_val) >> shamt;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lb(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<int8_t>(hart->mem_->read_byte(rs1_val + imm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lh(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<int16_t>(hart->mem_->read_halfword(rs1_val + imm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<int32_t>(hart->mem_->read_word(rs1_val + imm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lbu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<uint8_t>(hart->mem_->read_byte(rs1_val + imm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lhu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<uint16_t>(hart->mem_->read_halfword(rs1_val + imm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sb(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    hart->mem_->write_byte(rs2_val & 0xFF, rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    hart->mem_->write_halfword(rs2_val & 0xFFFF, rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    hart->mem_->write_word(rs2_val, rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_beq(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if (rs1_val == rs2_val) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_bne(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if (rs1_val != rs2_val) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_blt(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if (((sregister_t)rs1_val < (sregister_t)rs2_val)) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_bge(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if (((sregister_t)rs1_val >= (sregister_t)rs2_val)) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_bltu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if ((rs1_val < rs2_val)) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_bgeu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 19) | ((instr >> 20) & 0x7E0) | ((instr >> 7) & 0x1E) | ((instr & 0x80) << 4);
+    if (imm & 0x1000) imm |= 0xFFFFE000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    if ((rs1_val >= rs2_val)) {
+        hart->next_pc = hart->pc + imm;
+    }
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_jal(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    int32_t imm = ((instr & 0x80000000) >> 11) | ((instr >> 20) & 0x7FE) | ((instr & 0x100000) >> 9) | (instr & 0xFF000);
+    if (imm & 0x100000) imm |= 0xFFE00000;
+    register_t result = hart->next_pc;
+    hart->next_pc = hart->pc + imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_jalr(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = hart->next_pc;
+    hart->next_pc = (rs1_val + imm) & ~1;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lui(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    int32_t imm = instr & 0xFFFFF000;  // imm[31:12] << 12
+    register_t result = imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_auipc(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    int32_t imm = instr & 0xFFFFF000;  // imm[31:12] << 12
+    register_t result = hart->pc + imm;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fence([[maybe_unused]] Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fence_i([[maybe_unused]] Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, rs1_val);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrs(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, tmp | rs1_val);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrc(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, tmp & ~rs1_val);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrwi(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, rs1);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrsi(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, tmp | rs1);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_csrrci(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t tmp = hart->get_csr(imm & 0xFFF);
+    hart->set_csr(imm & 0xFFF, tmp & ~rs1);
+    if (rd != 0) hart->gpr_[rd] = tmp;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ecall(Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    hart->sys_->handle(hart);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ebreak([[maybe_unused]] Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    std::cerr << "EBREAK instruction" << std::endl; std::exit(1);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_uret([[maybe_unused]] Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    std::cerr << "URET instruction (not implemented)" << std::endl; std::exit(1);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sret([[maybe_unused]] Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mret(Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    hart->mret();
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_wfi(Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    hart->wait_for_interrupt();
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sfence_vma(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    hart->sfence_vma(rs1, rs2);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_addiw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) + imm)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_slliw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) << shamt)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_srliw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) >> shamt)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sraiw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> shamt));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_addw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) + static_cast<uint32_t>(rs2_val))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_subw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) - static_cast<uint32_t>(rs2_val))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sllw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) << (rs2_val & 0x1F))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_srlw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) >> (rs2_val & 0x1F))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sraw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs1_val & 0xFFFFFFFF) >> (rs2_val & 0x1F)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ld(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = hart->mem_->read_doubleword(rs1_val + imm);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lwu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = hart->mem_->read_word(rs1_val + imm);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sd(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    hart->mem_->write_doubleword(rs2_val, rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mul(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val * rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mulh(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>((static_cast<sdregister_t>(static_cast<sregister_t>(rs1_val)) * static_cast<sregister_t>(rs2_val)) >> XLEN);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mulhsu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>((static_cast<sdregister_t>(static_cast<sregister_t>(rs1_val)) * static_cast<sdregister_t>(rs2_val)) >> XLEN);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mulhu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>((static_cast<dregister_t>(rs1_val) * rs2_val) >> XLEN);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_div(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs2_val == 0 ? ~register_t{0} : static_cast<sregister_t>(rs2_val) == -1 ? register_t{0} - rs1_val : static_cast<register_t>(static_cast<sregister_t>(rs1_val) / static_cast<sregister_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_divu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs2_val == 0 ? ~register_t{0} : rs1_val / rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rem(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs2_val == 0 ? rs1_val : static_cast<sregister_t>(rs2_val) == -1 ? register_t{0} : static_cast<register_t>(static_cast<sregister_t>(rs1_val) % static_cast<sregister_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_remu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs2_val == 0 ? rs1_val : rs1_val % rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_mulw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs1_val) * static_cast<uint32_t>(rs2_val))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_divw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs2_val) == 0 ? -1 : static_cast<int32_t>(rs2_val) == -1 ? static_cast<int32_t>(0u - static_cast<uint32_t>(rs1_val)) : static_cast<int32_t>(rs1_val) / static_cast<int32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_divuw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs2_val) == 0 ? ~0u : static_cast<uint32_t>(rs1_val) / static_cast<uint32_t>(rs2_val))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_remw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rs2_val) == 0 ? static_cast<int32_t>(rs1_val) : static_cast<int32_t>(rs2_val) == -1 ? 0 : static_cast<int32_t>(rs1_val) % static_cast<int32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_remuw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(rs2_val) == 0 ? static_cast<uint32_t>(rs1_val) : static_cast<uint32_t>(rs1_val) % static_cast<uint32_t>(rs2_val))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_flw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.set_bits<float>(rd, hart->mem_->read_word(rs1_val + imm));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    hart->mem_->write_word(static_cast<uint32_t>(fpu.get_bits<double>(rs2)), rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fld(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    int32_t imm = static_cast<int32_t>(instr & 0xFFF00000) >> 20;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.set_bits<double>(rd, hart->mem_->read_doubleword(rs1_val + imm));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsd(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    int32_t imm = ((instr >> 25) << 5) | ((instr >> 7) & 0x1F);
+    if (imm & 0x800) imm |= 0xFFFFF000;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    hart->mem_->write_doubleword(fpu.get_bits<double>(rs2), rs1_val + imm);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmadd_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, std::fma(fpu.get<float>(rs1), fpu.get<float>(rs2), fpu.get<float>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmsub_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, std::fma(fpu.get<float>(rs1), fpu.get<float>(rs2), -fpu.get<float>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fnmsub_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, std::fma(-fpu.get<float>(rs1), fpu.get<float>(rs2), fpu.get<float>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fnmadd_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, std::fma(-fpu.get<float>(rs1), fpu.get<float>(rs2), -fpu.get<float>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fadd_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, fpu.get<float>(rs1) + fpu.get<float>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsub_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, fpu.get<float>(rs1) - fpu.get<float>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmul_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, fpu.get<float>(rs1) * fpu.get<float>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fdiv_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, fpu.get<float>(rs1) / fpu.get<float>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsqrt_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, std::sqrt(fpu.get<float>(rs1)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnj_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x80000000u;
+    uint64_t a = fpu.get_bits<float>(rs1);
+    uint64_t b = fpu.get_bits<float>(rs2);
+    fpu.set_bits<float>(rd, (a & ~sign) | (b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnjn_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x80000000u;
+    uint64_t a = fpu.get_bits<float>(rs1);
+    uint64_t b = fpu.get_bits<float>(rs2);
+    fpu.set_bits<float>(rd, (a & ~sign) | (~b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnjx_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x80000000u;
+    uint64_t a = fpu.get_bits<float>(rs1);
+    uint64_t b = fpu.get_bits<float>(rs2);
+    fpu.set_bits<float>(rd, a ^ (b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmin_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.set<float>(rd, fpu.min_max(fpu.get<float>(rs1), fpu.get<float>(rs2), false));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmax_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.set<float>(rd, fpu.min_max(fpu.get<float>(rs1), fpu.get<float>(rs2), true));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_feq_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<float>(rs1), fpu.get<float>(rs2), false, true, false);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_flt_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<float>(rs1), fpu.get<float>(rs2), true, false, true);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fle_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<float>(rs1), fpu.get<float>(rs2), true, true, true);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fclass_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = Fpu::classify(fpu.get<float>(rs1));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_w_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.to_int<int32_t>(fpu.get<float>(rs1), rm))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_s_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, static_cast<float>(static_cast<int32_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_wu_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.to_int<uint32_t>(fpu.get<float>(rs1), rm))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_s_wu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, static_cast<float>(static_cast<uint32_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_l_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(fpu.to_int<int64_t>(fpu.get<float>(rs1), rm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_s_l(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, static_cast<float>(static_cast<int64_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_lu_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(fpu.to_int<uint64_t>(fpu.get<float>(rs1), rm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_s_lu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, static_cast<float>(static_cast<uint64_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmadd_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, std::fma(fpu.get<double>(rs1), fpu.get<double>(rs2), fpu.get<double>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmsub_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, std::fma(fpu.get<double>(rs1), fpu.get<double>(rs2), -fpu.get<double>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fnmsub_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, std::fma(-fpu.get<double>(rs1), fpu.get<double>(rs2), fpu.get<double>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fnmadd_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint8_t rs3 = (instr >> 27) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, std::fma(-fpu.get<double>(rs1), fpu.get<double>(rs2), -fpu.get<double>(rs3)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fadd_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, fpu.get<double>(rs1) + fpu.get<double>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsub_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, fpu.get<double>(rs1) - fpu.get<double>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmul_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, fpu.get<double>(rs1) * fpu.get<double>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fdiv_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, fpu.get<double>(rs1) / fpu.get<double>(rs2));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsqrt_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, std::sqrt(fpu.get<double>(rs1)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnj_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x8000000000000000ULL;
+    uint64_t a = fpu.get_bits<double>(rs1);
+    uint64_t b = fpu.get_bits<double>(rs2);
+    fpu.set_bits<double>(rd, (a & ~sign) | (b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnjn_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x8000000000000000ULL;
+    uint64_t a = fpu.get_bits<double>(rs1);
+    uint64_t b = fpu.get_bits<double>(rs2);
+    fpu.set_bits<double>(rd, (a & ~sign) | (~b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fsgnjx_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    uint64_t sign = 0x8000000000000000ULL;
+    uint64_t a = fpu.get_bits<double>(rs1);
+    uint64_t b = fpu.get_bits<double>(rs2);
+    fpu.set_bits<double>(rd, a ^ (b & sign));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmin_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.set<double>(rd, fpu.min_max(fpu.get<double>(rs1), fpu.get<double>(rs2), false));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmax_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.set<double>(rd, fpu.min_max(fpu.get<double>(rs1), fpu.get<double>(rs2), true));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_feq_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<double>(rs1), fpu.get<double>(rs2), false, true, false);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_flt_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<double>(rs1), fpu.get<double>(rs2), true, false, true);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fle_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = fpu.compare(fpu.get<double>(rs1), fpu.get<double>(rs2), true, true, true);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fclass_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = Fpu::classify(fpu.get<double>(rs1));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_w_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.to_int<int32_t>(fpu.get<double>(rs1), rm))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_d_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, static_cast<double>(static_cast<int32_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_wu_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.to_int<uint32_t>(fpu.get<double>(rs1), rm))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_d_wu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, static_cast<double>(static_cast<uint32_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_l_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(fpu.to_int<int64_t>(fpu.get<double>(rs1), rm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_d_l(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, static_cast<double>(static_cast<int64_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_lu_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(fpu.to_int<uint64_t>(fpu.get<double>(rs1), rm));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_d_lu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<double>(rd, static_cast<double>(static_cast<uint64_t>(rs1_val)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_s_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rm = (instr >> 12) & 0x7;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.round(rm);
+    fpu.set<float>(rd, static_cast<float>(fpu.get<double>(rs1)));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fcvt_d_s(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    fpu.set<double>(rd, fpu.get<float>(rs1));
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmv_x_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int32_t>(fpu.get_bits<double>(rs1))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmv_w_x(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.set_bits<float>(rd, rs1_val);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmv_x_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    Fpu& fpu = hart->fpu_;
+    register_t result = static_cast<register_t>(fpu.get_bits<double>(rs1));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_fmv_d_x(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    Fpu& fpu = hart->fpu_;
+    fpu.set_bits<double>(rd, rs1_val);
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh1add(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (rs1_val << 1) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh2add(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (rs1_val << 2) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh3add(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (rs1_val << 3) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_andn(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val & ~rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_orn(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val | ~rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_xnor(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = ~(rs1_val ^ rs2_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_min(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<sregister_t>(rs1_val) < static_cast<sregister_t>(rs2_val) ? rs1_val : rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_minu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val < rs2_val ? rs1_val : rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_max(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<sregister_t>(rs1_val) > static_cast<sregister_t>(rs2_val) ? rs1_val : rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_maxu(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rs1_val > rs2_val ? rs1_val : rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rol(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rotate_left(rs1_val, rs2_val & shamt_mask);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ror(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = rotate_right(rs1_val, rs2_val & shamt_mask);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_zext_h(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rs1_val & 0xFFFF;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_clz(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_leading_zeros(rs1_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ctz(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_trailing_zeros(rs1_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_cpop(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_ones(rs1_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sext_b(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int8_t>(rs1_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sext_h(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<sregister_t>(static_cast<int16_t>(rs1_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rori(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = rotate_right(rs1_val, shamt);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_orc_b(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = or_combine(rs1_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rev8(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = byte_swap(rs1_val);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_add_uw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<uint32_t>(rs1_val)) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh1add_uw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 1) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh2add_uw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 2) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sh3add_uw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = (static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << 3) + rs2_val;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_slli_uw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<uint32_t>(rs1_val)) << shamt;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_clzw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_leading_zeros(static_cast<uint32_t>(rs1_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ctzw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_trailing_zeros(static_cast<uint32_t>(rs1_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_cpopw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = count_ones(static_cast<uint32_t>(rs1_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rolw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_left(static_cast<uint32_t>(rs1_val), rs2_val & 0x1F))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_rorw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_right(static_cast<uint32_t>(rs1_val), rs2_val & 0x1F))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_roriw(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t shamt = (instr >> 20) & shamt_mask;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t result = static_cast<register_t>(static_cast<int64_t>(static_cast<int32_t>(rotate_right(static_cast<uint32_t>(rs1_val), shamt & 0x1F))));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lr_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_READ, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    uint32_t value = __atomic_load_n(reinterpret_cast<uint32_t*>(ptr), __ATOMIC_SEQ_CST);
+    hart->reservation_ = {ptr, 4, value};
+    register_t result = static_cast<int32_t>(value);
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sc_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    Reservation reservation = hart->reservation_;
+    hart->reservation_ = {};
+    uint32_t expected = static_cast<uint32_t>(reservation.value);
+    bool stored = reservation.ptr == ptr && reservation.size == 4 &&
+        __atomic_compare_exchange_n(reinterpret_cast<uint32_t*>(ptr), &expected, static_cast<uint32_t>(rs2_val), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    register_t result = stored ? 0 : 1;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoswap_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::swap, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoadd_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::add, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoxor_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::xor_, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoand_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::and_, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoor_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::or_, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomin_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::min, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomax_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::max, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amominu_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::minu, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomaxu_w(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 4, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = static_cast<int32_t>(atomic_fetch_op(AmoOp::maxu, reinterpret_cast<uint32_t*>(ptr), static_cast<uint32_t>(rs2_val)));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_lr_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_READ, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    uint64_t value = __atomic_load_n(reinterpret_cast<uint64_t*>(ptr), __ATOMIC_SEQ_CST);
+    hart->reservation_ = {ptr, 8, value};
+    register_t result = value;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_sc_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    Reservation reservation = hart->reservation_;
+    hart->reservation_ = {};
+    uint64_t expected = static_cast<uint64_t>(reservation.value);
+    bool stored = reservation.ptr == ptr && reservation.size == 8 &&
+        __atomic_compare_exchange_n(reinterpret_cast<uint64_t*>(ptr), &expected, static_cast<uint64_t>(rs2_val), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    register_t result = stored ? 0 : 1;
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoswap_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::swap, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoadd_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::add, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoxor_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::xor_, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoand_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::and_, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amoor_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::or_, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomin_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::min, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomax_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::max, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amominu_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::minu, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_amomaxu_d(Hart<XLEN>* hart, uint32_t instr) {
+    uint8_t rd = (instr >> 7) & 0x1F;
+    uint8_t rs1 = (instr >> 15) & 0x1F;
+    uint8_t rs2 = (instr >> 20) & 0x1F;
+
+    register_t rs1_val = hart->gpr_[rs1];
+    register_t rs2_val = hart->gpr_[rs2];
+    uint8_t* ptr;
+    if (!hart->mem_->atomic_ptr(rs1_val, 8, ACCESS_WRITE, ptr)) return;
+    if (!ptr) {
+        exec_ill(hart, instr);
+        return;
+    }
+    register_t result = atomic_fetch_op(AmoOp::maxu, reinterpret_cast<uint64_t*>(ptr), static_cast<uint64_t>(rs2_val));
+    if (rd != 0) hart->gpr_[rd] = result;
+}
+
+template <int XLEN>
+void Instructions<XLEN>::exec_ill(Hart<XLEN>* hart, [[maybe_unused]] uint32_t instr) {
+    hart->next_pc = memory_size + 1;
+}
+
+template struct Instructions<32>;
+template struct Instructions<64>;
+} 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 
@@ -7,92 +8,398 @@
 #include "memory.hpp"
 
 namespace sim {
-void Hart::run() {
-  gpr_[2] = memory_size - 1;
-  auto start = std::chrono::high_resolution_clock::now();
-  mem_->set_hart(this);
+template <int XLEN> void Hart<XLEN>::run() {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  start();
+  while (step()) {
+  };
+  fpu_.sync();
+  auto end = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = end - start_time;
+  seconds_ = elapsed.count();
+}
+
+template <int XLEN> void Hart<XLEN>::start() {
+  // Host exception flags raised before the guest starts are not its own
+  fpu_.discard_host_flags();
 
 #if ENABLE_MMU
   mmu_enabled_ = true;
   mmu_.set_hart(this);
-  mmu_.set_satp(0x80002000);
-  create_page_table(*mem_, 0x2000000);
 #else
   mmu_enabled_ = false;
 #endif
+}
 
-  while (step()) {
-  };
-  auto end = std::chrono::high_resolution_clock::now();
-  double seconds =
-      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
-          .count();
-  std::cout << "Total time: " << seconds << " s" << std::endl;
+template <int XLEN> Yield Hart<XLEN>::run_for(long n) {
+  if (!running()) {
+    return Yield::exited;
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  long end = n_instructions + n;
+  bool running = true;
+  while (n_instructions < end && (running = step())) {
+  }
+  fpu_.sync();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_time;
+  seconds_ += elapsed.count();
+
+  Yield reason = yield_;
+  yield_ = Yield::budget;
+  if (running) {
+    return Yield::budget;
+  }
+  if (!this->running()) {
+    return Yield::exited;
+  }
+  return reason == Yield::budget ? Yield::stopped : reason;
+}
+
+template <int XLEN> void Hart<XLEN>::yield(Yield reason) {
+  yield_ = reason;
+  irq_.next_event.store(0, std::memory_order_relaxed);
+}
+
+template <int XLEN> void Hart<XLEN>::retry_syscall() {
+  // The ecall only counts once it has run
+  next_pc = pc;
+  --n_instructions;
+  yield(Yield::syscall);
+}
+
+template <int XLEN> void Hart<XLEN>::stop() {
+  stop_requested_.store(true);
+  irq_.next_event.store(0);
+}
+
+template <int XLEN> void Hart<XLEN>::report() const {
+  std::cout << "Total time: " << seconds_ << " s" << std::endl;
   std::cout << "Number of instructions: " << std::dec << n_instructions
             << std::endl;
-  std::cout << "Average perfomance: " << n_instructions / (seconds * 1e6)
+  std::cout << "Average perfomance: " << n_instructions / (seconds_ * 1e6)
             << std::endl;
   dump_registers();
   mmu_.dump_tlb();
   mmu_.dump_stats();
-  return;
+}
+
+template <int XLEN> bool Hart<XLEN>::fetch(uint32_t paddr, uint32_t &instr) {
+  instr = mem_->read_physical_half(paddr);
+  if (instruction_length(instr) == 2) {
+    return true;
+  }
+  uint32_t upper = paddr + 2;
+  if ((pc & 0xFFF) == 0xFFE && !translate_fetch(pc + 2, upper)) {
+    return false;
+  }
+  instr |= static_cast<uint32_t>(mem_->read_physical_half(upper)) << 16;
+  return true;
 }
 
 #if ENABLE_CACHE
-bool Hart::step() {
-  if (cache_.execute_from_cache(pc)) {
-    return pc < memory_size;
+template <int XLEN> bool Hart<XLEN>::step() {
+  if (n_instructions >= irq_.next_event.load(std::memory_order_relaxed) &&
+      !check_interrupts()) {
+    return false;
+  }
+  if (pc == breakpoint_) {
+    return false;
+  }
+  uint32_t paddr;
+  if (!translate_fetch(pc, paddr)) {
+    // Instruction page fault: pc already points at the trap handler
+    return running();
+  }
+  if (coverage_) {
+    cover(paddr);
+  }
+  if (cache_.execute_from_cache(pc, paddr)) {
+    return running();
   }
 
-  uint32_t command = mem_->read_physical_word(pc);
-  register_t current_pc = pc;
-  DecodedInstruction decoded = decode(command);
-  if (!decoded.second) {
-    cache_.cache_it(current_pc);
-  } else {
-    decoded.first(this);
-    pc += 4;
-    ++n_instructions;
-    return pc < memory_size;
+  uint32_t command;
+  if (!fetch(paddr, command)) {
+    return running();
+  }
+  DecodedInstruction<XLEN> decoded = decode<XLEN>(command);
+  if (decoded.second || !cache_.cache_it(paddr)) {
+    execute(decoded.first, instruction_length(command));
+    return running();
   }
 
-  cache_.execute_from_cache(pc);
-  return pc < memory_size;
+  cache_.execute_from_cache(pc, paddr);
+  return running();
 }
 #else
-bool Hart::step() {
-  uint32_t command = mem_->read_physical_word(pc);
-  DecodedInstruction decoded = decode(command);
-  decoded.first(this);
-  pc += 4;
-  ++n_instructions;
-  return pc < memory_size;
+template <int XLEN> bool Hart<XLEN>::step() {
+  if (n_instructions >= irq_.next_event.load(std::memory_order_relaxed) &&
+      !check_interrupts()) {
+    return false;
+  }
+  if (pc == breakpoint_) {
+    return false;
+  }
+  uint32_t paddr;
+  uint32_t command;
+  if (!translate_fetch(pc, paddr) || !fetch(paddr, command)) {
+    // Instruction page fault: pc already points at the trap handler
+    return running();
+  }
+  if (coverage_) {
+    cover(paddr);
+  }
+  execute(decode<XLEN>(command).first, instruction_length(command));
+  return running();
 }
 #endif
 
-void Hart::set_register(const uint8_t &reg, const register_t &value) {
+template <int XLEN>
+void Hart<XLEN>::set_register(const uint8_t &reg, const register_t &value) {
   gpr_[reg] = value;
 }
-void Hart::set_pc(const register_t &value) { pc = value; }
-void Hart::set_mem(Memory *mem) { mem_ = mem; }
-void Hart::dump_registers() const {
+template <int XLEN>
+void Hart<XLEN>::set_pc(const register_t &value) { pc = value; }
+template <int XLEN> void Hart<XLEN>::set_mem(PhysicalMemory *phys) {
+  memory_.attach(phys, this);
+  mem_ = &memory_;
+}
+template <int XLEN> void Hart<XLEN>::copy_from(const Hart &other) {
+  cache_.copy_from(other.cache_);
+  copy_state_from(other);
+}
+
+template <int XLEN> void Hart<XLEN>::copy_state_from(const Hart &other) {
+  mmu_.copy_from(other.mmu_);
+  fetch_page_ = no_page;
+  stop_requested_.store(false);
+  yield_ = Yield::budget;
+  previous_block_ = 0;
+  irq_.pending.store(other.irq_.pending.load());
+  irq_.next_event.store(0);
+  hart_id_ = other.hart_id_;
+  instruction_limit_ = other.instruction_limit_;
+  n_instructions = other.n_instructions;
+  gpr_ = other.gpr_;
+  csr_ = other.csr_;
+  fpu_ = other.fpu_;
+  vpu_ = other.vpu_;
+  // A reservation points into the other machine's RAM
+  reservation_ = {};
+  pc = other.pc;
+  next_pc = other.next_pc;
+  halted_ = other.halted_;
+  exit_code_ = other.exit_code_;
+}
+
+template <int XLEN> void Hart<XLEN>::save(StateWriter &out) const {
+  out.put(n_instructions);
+  out.put(gpr_);
+  out.put(csr_);
+  fpu_.save(out);
+  vpu_.save(out);
+  mmu_.save(out);
+  out.put(irq_.pending.load());
+  out.put(pc);
+  out.put(next_pc);
+  out.put(halted_);
+  out.put(exit_code_);
+}
+
+template <int XLEN> void Hart<XLEN>::restore(StateReader &in) {
+  in.get(n_instructions);
+  in.get(gpr_);
+  in.get(csr_);
+  fpu_.restore(in);
+  vpu_.restore(in);
+  mmu_.restore(in);
+  irq_.pending.store(in.get<uint32_t>());
+  irq_.next_event.store(0);
+  reservation_ = {};
+  in.get(pc);
+  in.get(next_pc);
+  in.get(halted_);
+  in.get(exit_code_);
+}
+template <int XLEN> void Hart<XLEN>::set_instruction_limit(long limit) {
+  instruction_limit_ = limit;
+  irq_.next_event.store(0);
+}
+template <int XLEN> void Hart<XLEN>::set_hart_id(unsigned id) {
+  hart_id_ = id;
+  csr_[csr::mhartid] = id;
+}
+template <int XLEN>
+void Hart<XLEN>::set_syscalls(Syscalls *sys) { sys_ = sys; }
+template <int XLEN> void Hart<XLEN>::set_clint(Clint *clint) {
+  clint_ = clint;
+  clint_->attach(&irq_, &n_instructions);
+}
+
+template <int XLEN>
+typename Hart<XLEN>::register_t Hart<XLEN>::get_csr(uint32_t addr) const {
+  switch (addr) {
+  case csr::cycle:
+  case csr::instret:
+  case csr::mcycle:
+  case csr::minstret:
+    return static_cast<register_t>(n_instructions);
+  case csr::cycleh:
+  case csr::instreth:
+  case csr::mcycleh:
+  case csr::minstreth:
+    return static_cast<register_t>(static_cast<uint64_t>(n_instructions) >>
+                                   32);
+  case csr::fflags:
+    return fpu_.fflags();
+  case csr::frm:
+    return fpu_.frm();
+  case csr::fcsr:
+    return fpu_.frm() << 5 | fpu_.fflags();
+  case csr::vstart:
+    return static_cast<register_t>(vpu_.vstart());
+  case csr::vl:
+    return static_cast<register_t>(vpu_.vl());
+  case csr::vtype:
+    return vpu_.vill() ? register_t{1} << (XLEN - 1)
+                       : static_cast<register_t>(vpu_.vtype());
+  case csr::vlenb:
+    return vlenb;
+  case csr::time:
+    return static_cast<register_t>(clint_ ? clint_->mtime() : n_instructions);
+  case csr::timeh:
+    return static_cast<register_t>(
+        (clint_ ? clint_->mtime() : static_cast<uint64_t>(n_instructions)) >>
+        32);
+  default:
+    return csr_[addr];
+  }
+}
+
+template <int XLEN> void Hart<XLEN>::set_csr(uint32_t addr, register_t value) {
+  csr_[addr] = value;
+  switch (addr) {
+  case csr::mstatus:
+  case csr::mie:
+  case csr::mip:
+    // Enabling an interrupt may make an already pending one deliverable
+    irq_.next_event.store(0, std::memory_order_relaxed);
+    break;
+  case csr::fflags:
+    fpu_.set_fflags(static_cast<uint32_t>(value));
+    break;
+  case csr::frm:
+    fpu_.set_frm(static_cast<uint32_t>(value));
+    break;
+  case csr::fcsr:
+    fpu_.set_fflags(static_cast<uint32_t>(value));
+    fpu_.set_frm(static_cast<uint32_t>(value >> 5));
+    break;
+  case csr::vstart:
+    vpu_.set_vstart(value);
+    break;
+  case csr::satp:
+    mmu_.set_satp(value);
+    fetch_page_ = no_page;
+    break;
+  default:
+    break;
+  }
+}
+
+template <int XLEN> void Hart<XLEN>::sfence_vma(uint8_t rs1, uint8_t rs2) {
+  mmu_.sfence_vma(rs1 != 0, gpr_[rs1], rs2 != 0, gpr_[rs2]);
+  fetch_page_ = no_page;
+}
+
+template <int XLEN> bool Hart<XLEN>::check_interrupts() {
+  long deadline = irq_.timer_deadline.load();
+  bool timer = n_instructions >= deadline;
+  // Published before sampling the lines so that a concurrent raise() always
+  // forces another check
+  irq_.next_event.store(
+      std::min(timer ? InterruptLines::never : deadline, instruction_limit_));
+  if (stop_requested_.load() || out_of_budget() || yield_ != Yield::budget) {
+    return false;
+  }
+
+  register_t lines = irq_.pending.load() | (timer ? MIP_MTIP : 0);
+  csr_[csr::mip] =
+      (csr_[csr::mip] & ~(MIP_MSIP | MIP_MTIP | MIP_MEIP)) | lines;
+
+  register_t enabled = csr_[csr::mip] & csr_[csr::mie];
+  if (!enabled || !(csr_[csr::mstatus] & MSTATUS_MIE)) {
+    return true;
+  }
+
+  if (enabled & MIP_MEIP) {
+    take_interrupt(11);
+  } else if (enabled & MIP_MSIP) {
+    take_interrupt(3);
+  } else {
+    take_interrupt(7);
+  }
+  return true;
+}
+
+template <int XLEN> void Hart<XLEN>::take_interrupt(uint32_t cause) {
+  csr_[csr::mepc] = pc;
+  csr_[csr::mcause] = (register_t{1} << (XLEN - 1)) | cause;
+
+  register_t mstatus = csr_[csr::mstatus];
+  mstatus = (mstatus & ~MSTATUS_MPIE) |
+            ((mstatus & MSTATUS_MIE) ? MSTATUS_MPIE : 0);
+  csr_[csr::mstatus] = (mstatus & ~MSTATUS_MIE) | MSTATUS_MPP;
+
+  reservation_ = {};
+
+  register_t base = csr_[csr::mtvec] & ~3u;
+  pc = (csr_[csr::mtvec] & 1) ? base + 4 * cause : base;
+}
+
+template <int XLEN> void Hart<XLEN>::mret() {
+  register_t mstatus = csr_[csr::mstatus];
+  mstatus = (mstatus & ~MSTATUS_MIE) |
+            ((mstatus & MSTATUS_MPIE) ? MSTATUS_MIE : 0);
+  csr_[csr::mstatus] = mstatus | MSTATUS_MPIE;
+  next_pc = csr_[csr::mepc];
+  reservation_ = {};
+  irq_.next_event.store(0, std::memory_order_relaxed);
+}
+
+template <int XLEN> void Hart<XLEN>::wait_for_interrupt() {
+  if (irq_.pending.load() & csr_[csr::mie]) {
+    return;
+  }
+  // Nothing else can wake a single hart up, so skip the idle time outright.
+  // The CLINT refuses when there are other harts that could send an IPI.
+  if ((csr_[csr::mie] & MIP_MTIP) && clint_) {
+    clint_->fast_forward(hart_id_);
+  }
+  if (cooperative_ && !(irq_.pending.load() & csr_[csr::mie])) {
+    yield(Yield::wfi);
+  }
+}
+template <int XLEN> void Hart<XLEN>::dump_registers() const {
   const char *reg_names[32] = {
       "zero", "ra", "sp", "gp", "tp",  "t0",  "t1", "t2", "s0/fp", "s1", "a0",
       "a1",   "a2", "a3", "a4", "a5",  "a6",  "a7", "s2", "s3",    "s4", "s5",
       "s6",   "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5",    "t6"};
 
   std::cout << "=== REGISTER DUMP ===" << std::endl;
-  std::cout << "PC: 0x" << std::hex << std::setw(8) << std::setfill('0') << pc
+  std::cout << "PC: 0x" << std::hex << std::setw(XLEN / 4) << std::setfill('0')
+            << pc
             << " (" << std::dec << pc << ")" << std::endl;
   std::cout << std::endl;
 
   for (int i = 0; i < 32; i++) {
     std::cout << "x" << std::setw(2) << std::setfill('0') << i << " ("
               << std::setw(5) << std::setfill(' ') << std::left << reg_names[i]
-              << std::right << "): " << "0x" << std::hex << std::setw(8)
-              << std::setfill('0') << gpr_[i] << " (" << std::dec
-              << std::setw(11) << std::setfill(' ')
-              << static_cast<int32_t>(gpr_[i]) << ")";
+              << std::right << "): " << "0x" << std::hex
+              << std::setw(XLEN / 4) << std::setfill('0') << gpr_[i] << " ("
+              << std::dec << std::setw(XLEN == 64 ? 20 : 11)
+              << std::setfill(' ') << static_cast<sregister_t>(gpr_[i])
+              << ")";
     if ((i + 1) % 2 == 0) {
       std::cout << std::endl;
     } else {
@@ -101,12 +408,15 @@ void Hart::dump_registers() const {
   }
   std::cout << "=====================" << std::endl << std::endl;
 }
-bool Hart::is_mmu_enabled_() const { return mmu_enabled_; }
+template <int XLEN>
+bool Hart<XLEN>::is_mmu_enabled_() const { return mmu_enabled_; }
 
-bool Hart::translate_mmu(uint32_t vaddr, uint32_t &paddr,
-                         uint32_t access_type) {
+template <int XLEN>
+bool Hart<XLEN>::translate_mmu(register_t vaddr, uint32_t &paddr,
+                               uint32_t access_type) {
   if (!mmu_enabled_) {
-    paddr = vaddr;
+    // Bare addresses above 4 GiB only exist on RV64 and hit nothing
+    paddr = static_cast<uint32_t>(vaddr) | (vaddr >> 31 >> 1 ? ~0u : 0u);
     return true;
   }
 
@@ -121,7 +431,27 @@ bool Hart::translate_mmu(uint32_t vaddr, uint32_t &paddr,
   return success;
 }
 
-void Hart::handle_page_fault(uint32_t vaddr, uint32_t cause) {
+template <int XLEN>
+bool Hart<XLEN>::translate_no_fault(register_t vaddr, uint32_t &paddr,
+                                    uint32_t access_type) {
+  if (!mmu_enabled_) {
+    paddr = static_cast<uint32_t>(vaddr) | (vaddr >> 31 >> 1 ? ~0u : 0u);
+    return true;
+  }
+  bool page_fault = false;
+  return mmu_.translate(vaddr, paddr, access_type, page_fault);
+}
+
+template <int XLEN> void Hart<XLEN>::configure_tlb(const TlbConfig &config) {
+  mmu_.configure_tlb(config);
+}
+
+template <int XLEN>
+void Hart<XLEN>::handle_page_fault(register_t vaddr, uint32_t access_type) {
+  // Instruction, load and store/AMO page fault
+  uint32_t cause = access_type == ACCESS_EXECUTE ? 12
+                   : access_type == ACCESS_WRITE ? 15
+                                                 : 13;
   csr_[0x342] = cause;
   csr_[0x341] = pc;
   csr_[0x343] = vaddr;
@@ -129,78 +459,18 @@ void Hart::handle_page_fault(uint32_t vaddr, uint32_t cause) {
   csr_[0x300] |= (1 << 7);
   csr_[0x300] &= ~(1 << 3);
 
-  pc = csr_[0x305];
-
-  std::cout << "[MMU] Page fault at vaddr=0x" << std::hex << vaddr
-            << ", cause=" << cause << ", saved pc=0x" << csr_[0x141] << std::dec
-            << "\n";
-}
-
-bool create_page_table(Memory &mem, uint32_t table_phys_addr) {
+  reservation_ = {};
 
-  std::cout << "Creating page table at phys addr: 0x" << std::hex
-            << table_phys_addr << "\n";
+  // Also taken when the fault comes from fetch, before anything executes
+  pc = next_pc = csr_[0x305];
 
-  if (table_phys_addr % 4096 != 0) {
-    std::cerr << "Error: Page table must be 4KB aligned!\n";
-    return false;
+  if (!quiet_) {
+    std::cout << "[MMU] Page fault at vaddr=0x" << std::hex << vaddr
+              << ", cause=" << cause << ", saved pc=0x" << csr_[csr::mepc]
+              << std::dec << "\n";
   }
-
-  uint32_t *root_table = new uint32_t[1024];
-
-  std::cout << "Mode: 4KB pages (2-level)\n";
-
-  uint32_t level2_addr = table_phys_addr + 2 * 4096;
-
-  for (int vpn1 = 0; vpn1 < 1024; vpn1++) {
-    uint32_t pte1_value = (level2_addr >> 12 << 10) | (1 << 0);
-    root_table[vpn1] = pte1_value;
-    uint32_t *level2_table = new uint32_t[1024];
-
-    for (int vpn0 = 0; vpn0 < 1024; vpn0++) {
-      uint32_t virt_page = (vpn1 << 10) | vpn0;
-      uint32_t phys_page = (virt_page + 0x10) & memory_size;
-
-      uint32_t pte0_value = (phys_page << 10) | // PPN в битах [31:10]
-                            (1 << 0) |          // V - valid
-                            (1 << 1) |          // R - readable
-                            (1 << 2) |          // W - writable
-                            (1 << 3) |          // X - executable
-                            (1 << 4) |          // U - user accessible
-                            (1 << 6);           // A - accessed
-
-      level2_table[vpn0] = pte0_value;
-    }
-
-    for (int i = 0; i < 1024; i++) {
-      uint32_t addr = level2_addr + (i * 4);
-      uint32_t value = level2_table[i];
-      mem.write_physical_byte(addr, value & 0xFF);
-      mem.write_physical_byte(addr + 1, (value >> 8) & 0xFF);
-      mem.write_physical_byte(addr + 2, (value >> 16) & 0xFF);
-      mem.write_physical_byte(addr + 3, (value >> 24) & 0xFF);
-    }
-
-    delete[] level2_table;
-    level2_addr += 4096;
-  }
-
-  for (int i = 0; i < 1024; i++) {
-    uint32_t addr = table_phys_addr + (i * 4);
-    uint32_t value = root_table[i];
-
-    mem.write_physical_byte(addr, value & 0xFF);
-    mem.write_physical_byte(addr + 1, (value >> 8) & 0xFF);
-    mem.write_physical_byte(addr + 2, (value >> 16) & 0xFF);
-    mem.write_physical_byte(addr + 3, (value >> 24) & 0xFF);
-  }
-
-  delete[] root_table;
-
-  std::cout << "Page table created successfully\n";
-  std::cout << "  Root table at: 0x" << std::hex << table_phys_addr << "\n";
-  std::cout << "  Entries: 1024\n";
-
-  return true;
 }
+
+template class Hart<32>;
+template class Hart<64>;
 } // namespace sim
\ No newline at end of file
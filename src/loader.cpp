@@ -1,8 +1,13 @@
 #include "loader.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
 namespace sim {
-void Loader::read_elf(const std::filesystem::path &path) {
-  std::vector<uint8_t> result;
+std::shared_ptr<const ElfImage>
+ElfImage::read(const std::filesystem::path &path, bool verbose) {
   using namespace ELFIO;
 
   elfio reader;
@@ -10,48 +15,323 @@ void Loader::read_elf(const std::filesystem::path &path) {
     throw std::runtime_error("Cannot open file: " + path.string());
   }
 
-  std::cout << "ELF-file properties" << std::endl;
-  std::cout << "Path               : " << path << std::endl;
+  auto image = std::make_shared<ElfImage>();
+  image->is_64bit = reader.get_class() != ELFCLASS32;
+  image->entry = reader.get_entry();
 
-  std::cout << "ELF-file class     : ";
-  if (reader.get_class() == ELFCLASS32)
-    std::cout << "ELF32" << std::endl;
-  else
-    std::cout << "ELF64" << std::endl;
+  if (verbose) {
+    std::cout << "ELF-file properties" << std::endl;
+    std::cout << "Path               : " << path << std::endl;
 
-  std::cout << "ELF-file encoding  : ";
-  if (reader.get_encoding() == ELFDATA2LSB)
-    std::cout << "Little endian" << std::endl;
-  else
-    std::cout << "Big endian" << std::endl;
+    std::cout << "ELF-file class     : "
+              << (image->is_64bit ? "ELF64" : "ELF32") << std::endl;
 
-  std::cout << "Type               : " << reader.get_type() << std::endl;
-  std::cout << "Machine            : RISC-V (0x" << std::hex
-            << reader.get_machine() << ")" << std::endl;
-  std::cout << "Entry point        : 0x" << std::hex << reader.get_entry()
-            << std::endl;
-  std::cout << "Sections           : " << std::dec << reader.sections.size()
-            << std::endl;
-  std::cout << "Segments           : " << reader.segments.size() << std::endl;
+    std::cout << "ELF-file encoding  : ";
+    if (reader.get_encoding() == ELFDATA2LSB)
+      std::cout << "Little endian" << std::endl;
+    else
+      std::cout << "Big endian" << std::endl;
+
+    std::cout << "Type               : " << reader.get_type() << std::endl;
+    std::cout << "Machine            : RISC-V (0x" << std::hex
+              << reader.get_machine() << ")" << std::endl;
+    std::cout << "Entry point        : 0x" << std::hex << reader.get_entry()
+              << std::endl;
+    std::cout << "Sections           : " << std::dec
+              << reader.sections.size() << std::endl;
+    std::cout << "Segments           : " << reader.segments.size()
+              << std::endl;
+  }
 
   for (auto &seg : reader.segments) {
-    std::cout << "Segment with virtual address 0x" << std::hex
-              << seg->get_virtual_address() << std::endl;
-    if (seg->get_type() == ELFIO::PT_LOAD) {
-      machine_.memory_.set_virtual_address(seg->get_virtual_address());
+    if (verbose) {
+      std::cout << "Segment with virtual address 0x" << std::hex
+                << seg->get_virtual_address() << std::endl;
+    }
+    if (seg->get_type() != ELFIO::PT_LOAD) {
+      continue;
+    }
+    if (verbose) {
       std::cout << "Load segment with virtual address 0x" << std::hex
                 << seg->get_virtual_address() << std::endl;
-      if (seg->get_data() != nullptr)
-        machine_.add_data(seg->get_data(), seg->get_file_size(),
-                          seg->get_virtual_address());
+    }
+    Segment segment{seg->get_virtual_address(), seg->get_memory_size(),
+                    seg->get_flags(), {}};
+    if (seg->get_data() != nullptr) {
+      segment.data.assign(seg->get_data(),
+                          seg->get_data() + seg->get_file_size());
+    }
+    image->segments.push_back(std::move(segment));
+  }
+
+  for (Elf_Half i = 0; i < reader.sections.size(); ++i) {
+    section *sec = reader.sections[i];
+    if (sec->get_type() != SHT_SYMTAB) {
+      continue;
+    }
+    symbol_section_accessor symbols(reader, sec);
+    for (Elf_Xword k = 0; k < symbols.get_symbols_num(); ++k) {
+      std::string name;
+      Elf64_Addr value = 0;
+      Elf_Xword size = 0;
+      unsigned char bind = 0;
+      unsigned char type = 0;
+      Elf_Half section_index = 0;
+      unsigned char other = 0;
+      symbols.get_symbol(k, name, value, size, bind, type, section_index,
+                         other);
+      if (type == STT_FUNC) {
+        image->functions.emplace(name, value);
+      }
+    }
+  }
+  return image;
+}
+
+void Loader::read_elf(const std::filesystem::path &path) {
+  load(*ElfImage::read(path, true), true);
+}
+
+void Loader::build(bool is_64bit, std::size_t n_harts) {
+  if (is_64bit) {
+    machine_ = std::make_unique<Machine<64>>(n_harts);
+  } else {
+    machine_ = std::make_unique<Machine<32>>(n_harts);
+  }
+  if (!disk_path_.empty()) {
+    machine_->attach_disk(disk_path_);
+  }
+  if (tlb_) {
+    machine_->configure_tlb(*tlb_);
+  }
+  machine_->set_quantum(quantum_);
+  if (instruction_limit_ != 0) {
+    machine_->set_instruction_limit(instruction_limit_);
+  }
+  machine_->set_quiet(quiet_);
+}
+
+void Loader::load(const ElfImage &image, bool verbose) {
+  build(image.is_64bit, n_harts_);
+  PhysicalMemory &memory = machine_->memory();
+
+  std::uint64_t image_end = 0;
+  for (const auto &seg : image.segments) {
+    memory.set_virtual_address(seg.virtual_addr);
+  }
+  for (const auto &seg : image.segments) {
+    if (!seg.data.empty())
+      machine_->add_data(seg.data.data(), seg.data.size(), seg.virtual_addr);
+    machine_->add_segment(seg.virtual_addr, seg.memory_size, seg.flags);
+    image_end =
+        std::max<std::uint64_t>(image_end, seg.virtual_addr + seg.memory_size);
+  }
+  machine_->set_brk(image_end - memory.virtual_addr_);
+  if (verbose) {
+    std::cout << "pc:" << std::dec << image.entry - memory.virtual_addr_
+              << std::endl;
+  }
+  machine_->set_pc(image.entry - memory.virtual_addr_);
+  auto function = image.functions.find(fuzz_function_);
+  if (function != image.functions.end()) {
+    fuzz_entry_ = function->second;
+  }
+}
+
+void Loader::restore(const std::string &path) {
+  if (!disk_path_.empty()) {
+    throw std::runtime_error("A disk cannot be attached to a snapshot");
+  }
+  SnapshotFile file(path);
+  build(file.xlen() == 64, file.harts());
+  machine_->restore(file);
+}
+
+void Loader::parse_options(const std::vector<std::string> &args) {
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    bool has_value = i + 1 < args.size();
+    if (args[i] == "--disk" && has_value) {
+      attach_disk(args[++i]);
+    } else if (args[i] == "--tlb" && has_value) {
+      // --tlb <entries>:<ways>[:plru|fifo|random]
+      configure_tlb(TlbConfig::parse(args[++i]));
+    } else if (args[i] == "--harts" && has_value) {
+      set_harts(std::strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (args[i] == "--quantum" && has_value) {
+      // Deterministic scheduling in turns of this many instructions
+      set_quantum(std::strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (args[i] == "--limit" && has_value) {
+      set_instruction_limit(std::strtol(args[++i].c_str(), nullptr, 10));
+    } else if (args[i] == "--sweep" && i + 2 < args.size()) {
+      // --sweep <fast-forward> <region> <tlb config>...
+      long fast_forward = std::strtol(args[++i].c_str(), nullptr, 10);
+      long region = std::strtol(args[++i].c_str(), nullptr, 10);
+      std::vector<TlbConfig> configs;
+      while (i + 1 < args.size() && args[i + 1].compare(0, 2, "--") != 0) {
+        configs.push_back(TlbConfig::parse(args[++i]));
+      }
+      set_sweep(fast_forward, region, std::move(configs));
+    } else if (args[i] == "--lanes" && i + 2 < args.size()) {
+      // --lanes <width> <inputs file>
+      std::size_t lanes = std::strtoul(args[++i].c_str(), nullptr, 10);
+      set_lanes(lanes, args[++i]);
+    } else if (args[i] == "--check-lanes") {
+      set_check_lanes(true);
+    } else if (args[i] == "--snapshot" && i + 2 < args.size()) {
+      // --snapshot <instructions> <file>
+      long instructions = std::strtol(args[++i].c_str(), nullptr, 10);
+      set_snapshot(instructions, args[++i]);
+    } else if (args[i] == "--repeat" && has_value) {
+      set_repeat(std::strtoul(args[++i].c_str(), nullptr, 10));
+    } else if (args[i] == "--fuzz" && i + 3 < args.size()) {
+      // --fuzz <function> <corpus dir> <runs>
+      std::string function = args[++i];
+      std::string corpus_dir = args[++i];
+      set_fuzz(function, corpus_dir,
+               std::strtoul(args[++i].c_str(), nullptr, 10));
+    } else {
+      throw std::runtime_error("Unknown option: " + args[i]);
     }
   }
-  std::cout << "pc:" << std::dec
-            << reader.get_entry() - machine_.memory_.virtual_addr_ << std::endl;
-  machine_.set_pc(reader.get_entry() - machine_.memory_.virtual_addr_);
+}
+
+void Loader::attach_disk(const std::string &path) { disk_path_ = path; }
+
+void Loader::configure_tlb(const TlbConfig &config) { tlb_ = config; }
 
-  return;
+void Loader::set_harts(std::size_t n_harts) { n_harts_ = n_harts; }
+
+void Loader::set_quantum(std::size_t instructions) {
+  quantum_ = instructions;
 }
 
-void Loader::run() { machine_.run(); }
-} // namespace sim
\ No newline at end of file
+void Loader::set_instruction_limit(long limit) { instruction_limit_ = limit; }
+
+void Loader::set_quiet(bool quiet) { quiet_ = quiet; }
+
+void Loader::set_sweep(long fast_forward, long region,
+                       std::vector<TlbConfig> configs) {
+  if (configs.empty()) {
+    throw std::runtime_error("--sweep needs at least one TLB configuration");
+  }
+  sweep_.emplace(fast_forward, region, std::move(configs));
+}
+
+void Loader::set_lanes(std::size_t lanes, const std::string &inputs_path) {
+  lanes_ = lanes;
+  inputs_path_ = inputs_path;
+}
+
+void Loader::set_check_lanes(bool check) { check_lanes_ = check; }
+
+void Loader::set_snapshot(long instructions, const std::string &path) {
+  snapshot_at_ = instructions;
+  snapshot_path_ = path;
+}
+
+void Loader::set_repeat(std::size_t runs) { repeat_ = runs; }
+
+void Loader::set_fuzz(const std::string &function,
+                      const std::string &corpus_dir, std::size_t runs) {
+  fuzz_function_ = function;
+  corpus_dir_ = corpus_dir;
+  fuzz_runs_ = runs;
+}
+
+int Loader::run() {
+  if (!machine_) {
+    throw std::runtime_error("No program loaded");
+  }
+  if (!snapshot_path_.empty()) {
+    machine_->set_instruction_limit(snapshot_at_);
+    int exit_code = machine_->run();
+    if (!machine_->out_of_budget()) {
+      std::cout << "Program exited after " << machine_->instructions()
+                << " instructions, before the snapshot" << std::endl;
+      return exit_code;
+    }
+    machine_->save(snapshot_path_);
+    std::cout << "Snapshot after " << machine_->instructions()
+              << " instructions saved to " << snapshot_path_ << std::endl;
+    return 0;
+  }
+  if (sweep_) {
+    return sweep_->run(*machine_);
+  }
+  if (!fuzz_function_.empty()) {
+    if (!fuzz_entry_) {
+      char *end = nullptr;
+      fuzz_entry_ = std::strtoull(fuzz_function_.c_str(), &end, 0);
+      if (*end != '\0') {
+        throw std::invalid_argument("Unknown function: " + fuzz_function_);
+      }
+    }
+    Fuzzer fuzzer(*fuzz_entry_ - machine_->memory().virtual_addr_,
+                  corpus_dir_, fuzz_runs_, instruction_limit_);
+    return fuzzer.run(*machine_);
+  }
+  if (lanes_ != 0) {
+    std::ifstream file(inputs_path_);
+    if (!file) {
+      throw std::runtime_error("Cannot open inputs: " + inputs_path_);
+    }
+    std::vector<std::vector<std::uint64_t>> inputs;
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::vector<std::uint64_t> values;
+      for (std::string field; fields >> field && field[0] != '#';) {
+        values.push_back(std::strtoull(field.c_str(), nullptr, 0));
+      }
+      if (!values.empty()) {
+        inputs.push_back(std::move(values));
+      }
+    }
+    std::vector<int> exit_codes = machine_->run_lanes(inputs, lanes_);
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < exit_codes.size(); ++i) {
+      std::cout << "Input " << i << ": " << exit_codes[i];
+      if (check_lanes_) {
+        // The same input on a scalar copy of the unrun machine
+        std::unique_ptr<MachineBase> copy = machine_->fork();
+        copy->set_quiet(true);
+        for (std::size_t k = 0; k < inputs[i].size() && k < 8; ++k) {
+          copy->set_register(static_cast<std::uint8_t>(10 + k),
+                             inputs[i][k]);
+        }
+        int scalar = copy->run();
+        if (scalar != exit_codes[i]) {
+          std::cout << ", scalar " << scalar;
+          ++mismatches;
+        }
+      }
+      std::cout << std::endl;
+    }
+    if (check_lanes_) {
+      std::cout << "Mismatches: " << mismatches << std::endl;
+    }
+    return mismatches != 0;
+  }
+  if (repeat_ != 0) {
+    auto start = std::chrono::steady_clock::now();
+    machine_->set_quiet(true);
+    machine_->set_baseline();
+    int exit_code = 0;
+    std::size_t pages = 0;
+    for (std::size_t i = 0; i < repeat_; ++i) {
+      if (i != 0) {
+        pages += machine_->reset();
+      }
+      exit_code = machine_->run();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "Runs: " << repeat_ << " in " << elapsed.count()
+              << " s, last exit code " << exit_code << ", "
+              << pages / std::max<std::size_t>(repeat_ - 1, 1)
+              << " pages reset per run" << std::endl;
+    return exit_code;
+  }
+  return machine_->run();
+}
+} // namespace sim
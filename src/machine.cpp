@@ -1,16 +1,425 @@
 #include "machine.hpp"
+#include "wide_hart.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
 namespace sim {
-void Machine::run() {
-  hart_.set_mem(&memory_);
+namespace {
+// Reserved between the mmap area and the stack for the MMU-mode page tables
+constexpr std::uint32_t page_table_area = 1 << 20;
+constexpr std::uint32_t page_table_base =
+    (memory_size - Syscalls::stack_size - page_table_area) & ~0xFFFu;
+} // namespace
+
+template <int XLEN> Machine<XLEN>::Machine(std::size_t n_harts) {
+  for (std::size_t i = 0; i < std::max<std::size_t>(n_harts, 1); ++i) {
+    harts_.push_back(std::make_unique<Hart<XLEN>>());
+    harts_.back()->set_hart_id(static_cast<unsigned>(i));
+  }
+}
+
+template <int XLEN> void Machine<XLEN>::connect() {
+  memory_.add_device(clint_base, Clint::size, &clint_);
+  for (auto &hart : harts_) {
+    hart->set_mem(&memory_);
+    hart->set_syscalls(&syscalls_);
+    hart->set_clint(&clint_);
+  }
+}
+
+template <int XLEN> void Machine<XLEN>::prepare() {
+  if (prepared_) {
+    return;
+  }
+  prepared_ = true;
+  syscalls_.set_mmap_top(page_table_base);
+  connect();
+  // Every hart gets an equal slice of the stack area, hart 0 the top one
+  std::uint32_t stack_slice =
+      (Syscalls::stack_size / harts_.size()) & ~std::uint32_t{0xF};
+  for (std::size_t i = 0; i < harts_.size(); ++i) {
+    harts_[i]->set_register(2, memory_size - 1 - i * stack_slice);
+  }
+  if (disk_.is_open()) {
+    disk_.attach(&memory_, harts_[0]->interrupt_lines());
+    memory_.add_device(virtio_blk_base, VirtioBlk::size, &disk_);
+  }
+#if ENABLE_MMU
+  build_page_table();
+#endif
   // memory_.dump();
-  hart_.run();
 }
 
-void Machine::set_pc(const std::uint64_t &pc_val) { hart_.set_pc(pc_val); }
+template <int XLEN> int Machine<XLEN>::run() {
+  prepare();
+  return resume();
+}
+
+template <int XLEN> int Machine<XLEN>::resume() {
+  if (quantum_ != 0) {
+    run_quanta();
+  } else {
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < harts_.size(); ++i) {
+      threads.emplace_back([this, i] { harts_[i]->run(); });
+    }
+    harts_[0]->run();
+    for (std::size_t i = 1; i < harts_.size(); ++i) {
+      harts_[i]->stop();
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  if (!quiet_) {
+    for (const auto &hart : harts_) {
+      if (harts_.size() > 1) {
+        std::cout << "Hart " << hart->get_csr(csr::mhartid) << ":"
+                  << std::endl;
+      }
+      hart->report();
+    }
+  }
+  return harts_[0]->exit_code_;
+}
+
+template <int XLEN> void Machine<XLEN>::start() {
+  prepare();
+  for (auto &hart : harts_) {
+    hart->set_cooperative(true);
+    hart->start();
+  }
+}
+
+template <int XLEN> Yield Machine<XLEN>::slice(long budget) {
+  Yield first = harts_[0]->run_for(budget);
+  if (first == Yield::exited || first == Yield::stopped) {
+    return first;
+  }
+  bool progress = first == Yield::budget;
+  for (std::size_t i = 1; i < harts_.size(); ++i) {
+    progress |= harts_[i]->run_for(budget) == Yield::budget;
+  }
+  return progress ? Yield::budget : first;
+}
+
+template <int XLEN>
+std::unique_ptr<MachineBase> Machine<XLEN>::fork() const {
+  if (disk_.is_open()) {
+    throw std::runtime_error("A machine with a disk cannot be forked");
+  }
+  auto copy = std::make_unique<Machine<XLEN>>(harts_.size());
+  copy->memory_.copy_from(memory_);
+  copy->syscalls_.copy_from(syscalls_);
+  copy->segments_ = segments_;
+  copy->heap_start_ = heap_start_;
+  copy->quantum_ = quantum_;
+  copy->set_quiet(quiet_);
+  copy->prepared_ = prepared_;
+  for (std::size_t i = 0; i < harts_.size(); ++i) {
+    copy->harts_[i]->copy_from(*harts_[i]);
+  }
+  copy->connect();
+  copy->clint_.copy_from(clint_);
+  return copy;
+}
+
+template <int XLEN> void Machine<XLEN>::save(const std::string &path) const {
+  if (disk_.is_open()) {
+    throw std::runtime_error("A machine with a disk cannot be saved");
+  }
+  StateWriter state;
+  memory_.save(state);
+  syscalls_.save(state);
+  clint_.save(state);
+  state.put(heap_start_);
+  state.put(segments_.size());
+  for (const Segment &segment : segments_) {
+    state.put(segment);
+  }
+  for (const auto &hart : harts_) {
+    hart->save(state);
+  }
+  if (snapshot_.empty()) {
+    SnapshotFile::write(path, XLEN, harts_.size(), state, memory_);
+  } else {
+    SnapshotFile::write(
+        path, XLEN, harts_.size(), state, memory_, snapshot_,
+        memory_.dirty_pages(PhysicalMemory::dirty_snapshot));
+  }
+}
+
+template <int XLEN> void Machine<XLEN>::restore(const SnapshotFile &file) {
+  if (file.xlen() != XLEN || file.harts() != harts_.size()) {
+    throw std::invalid_argument("Snapshot is of a different machine");
+  }
+  connect();
+  StateReader state = file.state();
+  memory_.restore(state);
+  syscalls_.restore(state);
+  clint_.restore(state);
+  state.get(heap_start_);
+  segments_.resize(state.get<std::size_t>());
+  for (Segment &segment : segments_) {
+    state.get(segment);
+  }
+  for (auto &hart : harts_) {
+    hart->restore(state);
+  }
+  file.map_memory(memory_);
+  snapshot_ = file.path();
+  prepared_ = true;
+}
+
+template <int XLEN> void Machine<XLEN>::set_baseline() {
+  prepare();
+  baseline_.reset(static_cast<Machine *>(fork().release()));
+  memory_.clear_dirty(PhysicalMemory::dirty_reset);
+}
+
+template <int XLEN> std::size_t Machine<XLEN>::reset() {
+  if (!baseline_) {
+    throw std::runtime_error("reset() needs a baseline");
+  }
+  std::vector<uint32_t> pages =
+      memory_.dirty_pages(PhysicalMemory::dirty_reset);
+  memory_.copy_pages_from(baseline_->memory_, pages,
+                          PhysicalMemory::dirty_reset);
+  syscalls_.copy_from(baseline_->syscalls_);
+  for (std::size_t i = 0; i < harts_.size(); ++i) {
+    harts_[i]->copy_state_from(*baseline_->harts_[i]);
+  }
+  clint_.copy_from(baseline_->clint_);
+  return pages.size();
+}
+
+template <int XLEN> void Machine<XLEN>::set_breakpoint(std::uint64_t pc) {
+  harts_[0]->set_breakpoint(static_cast<typename Hart<XLEN>::register_t>(pc));
+}
+
+template <int XLEN> void Machine<XLEN>::set_coverage(std::uint8_t *map) {
+  for (auto &hart : harts_) {
+    hart->set_coverage(map);
+  }
+}
+
+template <int XLEN>
+void Machine<XLEN>::set_register(std::uint8_t reg, std::uint64_t value) {
+  harts_[0]->set_register(
+      reg, static_cast<typename Hart<XLEN>::register_t>(value));
+}
+
+template <int XLEN>
+std::vector<int>
+Machine<XLEN>::run_lanes(const std::vector<std::vector<std::uint64_t>> &inputs,
+                         std::size_t width) {
+  if (harts_.size() != 1) {
+    throw std::runtime_error("Lock-step lanes run single-hart programs");
+  }
+  width = std::min(std::max<std::size_t>(width, 1),
+                   WideHart<XLEN>::max_lanes);
+  prepare();
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> exit_codes;
+  long dispatched = 0;
+  long lockstep = 0;
+  long scalar = 0;
+  std::size_t split = 0;
+  for (std::size_t first = 0; first < inputs.size(); first += width) {
+    std::vector<std::unique_ptr<MachineBase>> copies;
+    std::vector<Machine<XLEN> *> lanes;
+    for (std::size_t i = first; i < std::min(first + width, inputs.size());
+         ++i) {
+      copies.push_back(fork());
+      auto *lane = static_cast<Machine<XLEN> *>(copies.back().get());
+      lane->set_quiet(true);
+      for (std::size_t k = 0; k < inputs[i].size() && k < 8; ++k) {
+        lane->hart(0).set_register(static_cast<uint8_t>(10 + k),
+                                   static_cast<typename Xlen<XLEN>::reg>(
+                                       inputs[i][k]));
+      }
+      lanes.push_back(lane);
+    }
 
-void Machine::add_data(const char *data, const std::uint64_t &size,
-                       ELFIO::Elf64_Addr virtual_addr) {
+    WideHart<XLEN> wide(lanes);
+    wide.run();
+    dispatched += wide.dispatched();
+    lockstep += wide.lane_instructions();
+    for (std::size_t lane : wide.split_lanes()) {
+      long before = lanes[lane]->instructions();
+      lanes[lane]->resume();
+      scalar += lanes[lane]->instructions() - before;
+    }
+    split += wide.split_lanes().size();
+    for (auto *lane : lanes) {
+      exit_codes.push_back(lane->hart(0).exit_code_);
+    }
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (!quiet_) {
+    std::cout << "Lanes: " << inputs.size() << " inputs, " << width
+              << " wide" << std::endl;
+    std::cout << "Lock-step: " << lockstep << " instructions in "
+              << dispatched << " dispatches" << std::endl;
+    std::cout << "Split: " << split << " lanes, " << scalar
+              << " scalar instructions" << std::endl;
+    std::cout << "Total time: " << elapsed.count() << " s" << std::endl;
+    std::cout << "Average perfomance: "
+              << (lockstep + scalar) / (elapsed.count() * 1e6) << std::endl;
+  }
+  return exit_codes;
+}
+
+template <int XLEN> void Machine<XLEN>::run_quanta() {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<bool> running(harts_.size(), true);
+  for (auto &hart : harts_) {
+    hart->start();
+  }
+
+  // Each round gives every live hart one quantum in mhartid order, so the
+  // interleaving depends only on the quantum. The end of a round is the
+  // barrier, and a hart 0 exit ends the run at once.
+  long rounds = 0;
+  while (running[0]) {
+    for (std::size_t i = 0; i < harts_.size() && running[0]; ++i) {
+      if (running[i]) {
+        running[i] =
+            harts_[i]->run_for(static_cast<long>(quantum_)) == Yield::budget;
+      }
+    }
+    ++rounds;
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double in_harts = 0;
+  for (const auto &hart : harts_) {
+    in_harts += hart->seconds();
+  }
+  double switching = elapsed.count() - in_harts;
+  if (quiet_) {
+    return;
+  }
+  std::cout << "Quantum: " << std::dec << quantum_ << " instructions, "
+            << rounds << " rounds" << std::endl;
+  std::cout << "Switching time: " << switching << " s ("
+            << 100 * switching / elapsed.count() << "%)" << std::endl;
+}
+
+template <int XLEN>
+void Machine<XLEN>::set_pc(const std::uint64_t &pc_val) {
+  for (auto &hart : harts_) {
+    hart->set_pc(pc_val);
+  }
+}
+
+template <int XLEN>
+void Machine<XLEN>::add_data(const char *data, const std::uint64_t &size,
+                             ELFIO::Elf64_Addr virtual_addr) {
   memory_.store_data(data, size, virtual_addr);
   // add it to mmu
 }
+
+template <int XLEN> void Machine<XLEN>::set_brk(const std::uint64_t &addr) {
+  heap_start_ = addr;
+  syscalls_.set_brk(addr);
+}
+
+template <int XLEN>
+void Machine<XLEN>::add_segment(ELFIO::Elf64_Addr virtual_addr,
+                                const std::uint64_t &size,
+                                std::uint32_t flags) {
+  segments_.push_back({virtual_addr, size, flags});
+}
+
+template <int XLEN> void Machine<XLEN>::build_page_table() {
+  // The tables would be written over the end of the image, and the heap
+  // mapping below them would have a negative size
+  if (heap_start_ > page_table_base) {
+    throw std::runtime_error("The program does not fit below the page "
+                             "tables");
+  }
+  PageTableBuilder<XLEN> builder(memory_, page_table_base, page_table_area);
+
+#if ENABLE_MEGAPAGES
+  builder.map(0, 0, memory_size, PTE_R | PTE_W | PTE_X | PTE_U);
+#else
+  // Guest addresses are relative to the lowest loaded segment and RAM is
+  // mapped one to one, so only the permissions come from the ELF
+  for (const auto &seg : segments_) {
+    std::uint64_t addr = seg.virtual_addr - memory_.virtual_addr_;
+    std::uint32_t flags = PTE_U;
+    flags |= (seg.flags & ELFIO::PF_R) ? PTE_R : 0;
+    flags |= (seg.flags & ELFIO::PF_W) ? PTE_W | PTE_R : 0;
+    flags |= (seg.flags & ELFIO::PF_X) ? PTE_X : 0;
+    builder.map(addr, static_cast<std::uint32_t>(addr), seg.size, flags);
+  }
+
+  // Heap and mmap area, then the stack
+  std::uint32_t heap = static_cast<std::uint32_t>(heap_start_);
+  builder.map(heap, heap, page_table_base - heap, PTE_R | PTE_W | PTE_U);
+  std::uint32_t stack = memory_size - Syscalls::stack_size;
+  builder.map(stack, stack, Syscalls::stack_size, PTE_R | PTE_W | PTE_U);
+#endif
+
+  builder.map(mmio_base, mmio_base, mmio_size, PTE_R | PTE_W);
+  for (auto &hart : harts_) {
+    hart->set_csr(csr::satp, builder.satp());
+  }
+}
+
+template <int XLEN>
+void Machine<XLEN>::attach_disk(const std::string &path) { disk_.open(path); }
+
+template <int XLEN>
+void Machine<XLEN>::configure_tlb(const TlbConfig &config) {
+  for (auto &hart : harts_) {
+    hart->configure_tlb(config);
+  }
+}
+
+template <int XLEN>
+void Machine<XLEN>::set_quantum(std::size_t instructions) {
+  quantum_ = instructions;
+}
+
+template <int XLEN> void Machine<XLEN>::set_quiet(bool quiet) {
+  quiet_ = quiet;
+  for (auto &hart : harts_) {
+    hart->set_quiet(quiet);
+  }
+}
+
+template <int XLEN> void Machine<XLEN>::set_instruction_limit(long limit) {
+  for (auto &hart : harts_) {
+    hart->set_instruction_limit(limit);
+  }
+}
+
+template <int XLEN> long Machine<XLEN>::instructions() const {
+  long total = 0;
+  for (const auto &hart : harts_) {
+    total += hart->n_instructions;
+  }
+  return total;
+}
+
+template <int XLEN> MmuStats Machine<XLEN>::mmu_stats() const {
+  MmuStats total;
+  for (const auto &hart : harts_) {
+    total += hart->mmu_stats();
+  }
+  return total;
+}
+
+template class Machine<32>;
+template class Machine<64>;
 } // namespace sim
\ No newline at end of file
@@ -1,5 +1,9 @@
+#include "batch.hpp"
 #include "loader.hpp"
 
+#include <cstdlib>
+#include <cstring>
+
 int main(int argc, char *argv[]) {
   using namespace sim;
 
@@ -7,9 +11,45 @@ int main(int argc, char *argv[]) {
     throw std::runtime_error("Program file didn't provided");
   }
 
+  if (std::strcmp(argv[1], "--batch") == 0) {
+    // --batch <manifest> <results> [--jobs <workers>]
+    //         [--cooperative <budget>]
+    if (argc < 4) {
+      throw std::runtime_error("Usage: --batch <manifest> <results> "
+                               "[--jobs <workers>] "
+                               "[--cooperative <budget>]");
+    }
+    std::size_t workers = 0;
+    long budget = 0;
+    for (int i = 4; i + 1 < argc; i += 2) {
+      if (std::strcmp(argv[i], "--jobs") == 0) {
+        workers = std::strtoul(argv[i + 1], nullptr, 10);
+      } else if (std::strcmp(argv[i], "--cooperative") == 0) {
+        budget = std::strtol(argv[i + 1], nullptr, 10);
+      } else {
+        throw std::invalid_argument(std::string("Unknown batch option: ") +
+                                    argv[i]);
+      }
+    }
+    BatchRunner batch;
+    batch.read_manifest(argv[2]);
+    batch.set_cooperative(budget);
+    batch.run(workers);
+    batch.write_results(argv[3]);
+    return 0;
+  }
+
   Loader loader;
+  if (std::strcmp(argv[1], "--restore") == 0) {
+    // --restore <snapshot> [options]
+    if (argc < 3) {
+      throw std::runtime_error("Usage: --restore <snapshot> [options]");
+    }
+    loader.parse_options(std::vector<std::string>(argv + 3, argv + argc));
+    loader.restore(argv[2]);
+    return loader.run();
+  }
+  loader.parse_options(std::vector<std::string>(argv + 2, argv + argc));
   loader.read_elf(argv[1]);
-  loader.run();
-
-  return 0;
-}
\ No newline at end of file
+  return loader.run();
+}
@@ -1,32 +1,138 @@
 #include "memory.hpp"
 #include "hart.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <stdexcept>
+#include <sys/mman.h>
 
 namespace sim {
-const uint32_t ACCESS_READ = 0x1;
-const uint32_t ACCESS_WRITE = 0x2;
+PhysicalMemory::PhysicalMemory() {
+  // Anonymous pages are zero and only get backed when first touched, so a
+  // machine costs nothing for the RAM its guest never uses
+  void *mem = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  mem_ = static_cast<uint8_t *>(mem);
+  dirty_ = std::make_unique<uint8_t[]>(n_pages);
+}
+PhysicalMemory::~PhysicalMemory() { munmap(mem_, memory_size); }
+
+void PhysicalMemory::copy_from(const PhysicalMemory &other) {
+  // Pages the other guest never wrote are still zero on both sides
+  std::vector<bool> used = other.used_pages();
+  for (std::size_t i = 0; i < used.size(); ++i) {
+    if (used[i]) {
+      std::size_t offset = i * page_size;
+      std::memcpy(mem_ + offset, other.mem_ + offset,
+                  std::min<std::size_t>(page_size, memory_size - offset));
+      dirty_[i] = other.dirty_[i] | dirty_written;
+    }
+  }
+  position_ = other.position_;
+  mmu_enable_ = other.mmu_enable_;
+  virtual_addr_ = other.virtual_addr_;
+}
 
-Memory::Memory() {
-  mem_ = new uint8_t[memory_size];
+std::vector<bool> PhysicalMemory::used_pages() const {
+  std::vector<bool> used(n_pages);
+  for (std::size_t i = 0; i < n_pages; ++i) {
+    used[i] = dirty_[i] & dirty_written;
+  }
+  return used;
+}
 
-  for (int i = 0; i < memory_size; ++i) {
-    mem_[i] = 0;
+void PhysicalMemory::map_file(int fd, uint64_t offset, uint32_t paddr,
+                              std::size_t size) {
+  if (paddr + size > n_pages * page_size) {
+    throw std::out_of_range("Mapping outside of RAM");
+  }
+  void *mapped = mmap(mem_ + paddr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset));
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Cannot map snapshot pages");
+  }
+  // Without the dirty bits of an actual write, so that an incremental
+  // snapshot taken next does not store them again
+  for (std::size_t i = paddr / page_size; i < (paddr + size) / page_size;
+       ++i) {
+    dirty_[i] |= dirty_written;
   }
 }
-Memory::~Memory() { delete[] mem_; }
 
-uint8_t &Memory::operator[](std::size_t index) {
+std::vector<uint32_t> PhysicalMemory::dirty_pages(uint8_t bit) const {
+  std::vector<uint32_t> pages;
+  std::size_t i = 0;
+  // Most pages are clean, so skip 64 flags at a time
+  const uint8_t *flags = dirty_.get();
+  uint64_t mask = 0x0101010101010101ull * bit;
+  for (; i + 64 <= n_pages; i += 64) {
+    uint64_t words[8];
+    std::memcpy(words, flags + i, sizeof(words));
+    uint64_t any = 0;
+    for (uint64_t word : words) {
+      any |= word;
+    }
+    if (any & mask) {
+      for (std::size_t k = i; k < i + 64; ++k) {
+        if (flags[k] & bit) {
+          pages.push_back(static_cast<uint32_t>(k));
+        }
+      }
+    }
+  }
+  for (; i < n_pages; ++i) {
+    if (dirty_[i] & bit) {
+      pages.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  return pages;
+}
+
+void PhysicalMemory::clear_dirty(uint8_t bit) {
+  for (std::size_t i = 0; i < n_pages; ++i) {
+    dirty_[i] &= static_cast<uint8_t>(~bit);
+  }
+}
+
+void PhysicalMemory::copy_pages_from(const PhysicalMemory &other,
+                                     const std::vector<uint32_t> &pages,
+                                     uint8_t bit) {
+  for (uint32_t page : pages) {
+    std::size_t offset = std::size_t{page} * page_size;
+    std::memcpy(mem_ + offset, other.mem_ + offset,
+                std::min<std::size_t>(page_size, memory_size - offset));
+    dirty_[page] &= static_cast<uint8_t>(~bit);
+  }
+}
+
+void PhysicalMemory::save(StateWriter &out) const {
+  out.put(position_);
+  out.put(mmu_enable_);
+  out.put(virtual_addr_);
+}
+
+void PhysicalMemory::restore(StateReader &in) {
+  in.get(position_);
+  in.get(mmu_enable_);
+  in.get(virtual_addr_);
+}
+
+uint8_t &PhysicalMemory::operator[](std::size_t index) {
   if (index >= memory_size) {
     throw std::out_of_range("Memory index out of range: " +
                             std::to_string(index));
   }
+  dirty_[index / page_size] = 0xFF;
   return mem_[index];
 }
 
-const uint8_t &Memory::operator[](std::size_t index) const {
+const uint8_t &PhysicalMemory::operator[](std::size_t index) const {
   if (index >= memory_size) {
     throw std::out_of_range("Memory index out of range: " +
                             std::to_string(index));
@@ -34,17 +140,18 @@ const uint8_t &Memory::operator[](std::size_t index) const {
   return mem_[index];
 }
 
-void Memory::store_data(const char *data, const std::uint64_t &size,
-                        ELFIO::Elf64_Addr addr) {
+void PhysicalMemory::store_data(const char *data, const std::uint64_t &size,
+                                ELFIO::Elf64_Addr addr) {
   if (data == nullptr) {
     throw std::invalid_argument("Data pointer is null");
   }
 
   std::copy(data, data + size, mem_ + addr - virtual_addr_);
+  mark_dirty(static_cast<uint32_t>(addr - virtual_addr_), size);
   position_ += size;
 }
 
-void Memory::dump() const {
+void PhysicalMemory::dump() const {
   std::cout << "Memory dump!" << std::endl;
   for (int i = 0; i < memory_size; ++i) {
     if (i % 16 == 0) {
@@ -55,165 +162,170 @@ void Memory::dump() const {
   std::cout << std::endl;
 }
 
-uint32_t Memory::get_command(const std::uint64_t &addr) const {
+uint32_t PhysicalMemory::get_command(const std::uint64_t &addr) const {
   return (static_cast<uint32_t>(mem_[addr]) << 24) |
          (static_cast<uint32_t>(mem_[addr + 1]) << 16) |
          (static_cast<uint32_t>(mem_[addr + 2]) << 8) |
          (static_cast<uint32_t>(mem_[addr + 3]));
 }
 
-void Memory::set_virtual_address(ELFIO::Elf64_Addr virtual_addr) {
+void PhysicalMemory::set_virtual_address(ELFIO::Elf64_Addr virtual_addr) {
   if (virtual_addr_ > virtual_addr) {
     virtual_addr_ = virtual_addr;
   }
 }
 
-uint8_t Memory::read_byte(register_t addr) {
+template <int XLEN>
+uint8_t Memory<XLEN>::read_byte(register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_READ)) {
     return false;
   }
 
   if (phys_addr >= memory_size) {
-    throw std::out_of_range("Memory read_byte: address out of range");
+    return static_cast<uint8_t>(phys_->mmio_read(phys_addr, 1));
   }
   return mem_[phys_addr];
 }
 
-uint16_t Memory::read_halfword(register_t addr) {
+template <int XLEN>
+uint16_t Memory<XLEN>::read_halfword(register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_READ)) {
     return false;
   }
 
   if (phys_addr + 1 >= memory_size) {
-    throw std::out_of_range("Memory read_halfword: address out of range");
+    return static_cast<uint16_t>(phys_->mmio_read(phys_addr, 2));
   }
 
-  uint16_t value = 0;
-  value = static_cast<uint16_t>(mem_[phys_addr]) |
-          (static_cast<uint16_t>(mem_[phys_addr + 1]) << 8);
+  uint16_t value;
+  std::memcpy(&value, mem_ + phys_addr, sizeof(value));
   return value;
 }
 
-uint32_t Memory::read_word(register_t addr) {
+template <int XLEN>
+uint32_t Memory<XLEN>::read_word(register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_READ)) {
     return false;
   }
 
   if (phys_addr + 3 >= memory_size) {
-    throw std::out_of_range("Memory read_word: address out of range");
+    return static_cast<uint32_t>(phys_->mmio_read(phys_addr, 4));
   }
 
-  uint32_t value = 0;
-  value = static_cast<uint32_t>(mem_[phys_addr]) |
-          (static_cast<uint32_t>(mem_[phys_addr + 1]) << 8) |
-          (static_cast<uint32_t>(mem_[phys_addr + 2]) << 16) |
-          (static_cast<uint32_t>(mem_[phys_addr + 3]) << 24);
+  uint32_t value;
+  std::memcpy(&value, mem_ + phys_addr, sizeof(value));
   return value;
 }
 
-uint64_t Memory::read_doubleword(register_t addr) {
+template <int XLEN>
+uint64_t Memory<XLEN>::read_doubleword(register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_READ)) {
     return false;
   }
 
   if (phys_addr + 7 >= memory_size) {
-    throw std::out_of_range("Memory read_word: address out of range");
-  }
-
-  uint64_t value = 0;
-  value = static_cast<uint64_t>(mem_[phys_addr]) |
-          (static_cast<uint64_t>(mem_[phys_addr + 1]) << 8) |
-          (static_cast<uint64_t>(mem_[phys_addr + 2]) << 16) |
-          (static_cast<uint64_t>(mem_[phys_addr + 3]) << 24) |
-          (static_cast<uint64_t>(mem_[phys_addr + 4]) << 32) |
-          (static_cast<uint64_t>(mem_[phys_addr + 5]) << 40) |
-          (static_cast<uint64_t>(mem_[phys_addr + 6]) << 48) |
-          (static_cast<uint64_t>(mem_[phys_addr + 7]) << 56);
+    return phys_->mmio_read(phys_addr, 8);
+  }
+
+  uint64_t value;
+  std::memcpy(&value, mem_ + phys_addr, sizeof(value));
   return value;
 }
 
-bool Memory::write_byte(uint8_t value, const std::uint64_t &addr) {
+template <int XLEN>
+bool Memory<XLEN>::write_byte(uint8_t value, register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_WRITE)) {
     return false;
   }
 
   if (phys_addr >= memory_size) {
-    std::cerr << "Memory write out of bounds: addr=" << std::hex << addr
-              << " (phys=" << phys_addr << ")" << std::endl;
-    std::exit(1);
+    if (!phys_->mmio_write(phys_addr, value, 1)) {
+      throw std::out_of_range("Memory write: address out of range: " +
+                              std::to_string(phys_addr));
+    }
+    return true;
   }
   mem_[phys_addr] = value;
+  dirty_[phys_addr / PhysicalMemory::page_size] = 0xFF;
   return true;
 }
 
-bool Memory::write_halfword(uint16_t value, const std::uint64_t &addr) {
+template <int XLEN>
+bool Memory<XLEN>::write_halfword(uint16_t value, register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_WRITE)) {
     return false;
   }
 
   if (phys_addr + 1 >= memory_size) {
-    std::cerr << "Memory write out of bounds: addr=" << std::hex << addr
-              << " (phys=" << phys_addr << ")" << std::endl;
-    std::exit(1);
+    if (!phys_->mmio_write(phys_addr, value, 2)) {
+      throw std::out_of_range("Memory write: address out of range: " +
+                              std::to_string(phys_addr));
+    }
+    return true;
   }
 
-  mem_[phys_addr] = static_cast<uint8_t>(value & 0xFF);
-  mem_[phys_addr + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+  std::memcpy(mem_ + phys_addr, &value, sizeof(value));
+  mark_dirty(phys_addr, sizeof(value));
   return true;
 }
 
-bool Memory::write_word(uint32_t value, const std::uint64_t &addr) {
+template <int XLEN>
+bool Memory<XLEN>::write_word(uint32_t value, register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_WRITE)) {
     return false;
   }
 
   if (phys_addr + 3 >= memory_size) {
-    std::cerr << "Memory write out of bounds: addr=" << std::hex << addr
-              << " (phys=" << phys_addr << ")" << std::endl;
-    std::exit(1);
+    if (!phys_->mmio_write(phys_addr, value, 4)) {
+      throw std::out_of_range("Memory write: address out of range: " +
+                              std::to_string(phys_addr));
+    }
+    return true;
   }
 
-  mem_[phys_addr] = static_cast<uint8_t>(value & 0xFF);
-  mem_[phys_addr + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
-  mem_[phys_addr + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
-  mem_[phys_addr + 3] = static_cast<uint8_t>((value >> 24) & 0xFF);
+  std::memcpy(mem_ + phys_addr, &value, sizeof(value));
+  mark_dirty(phys_addr, sizeof(value));
   return true;
 }
 
-bool Memory::write_doubleword(uint64_t value, const std::uint64_t &addr) {
+template <int XLEN>
+bool Memory<XLEN>::write_doubleword(uint64_t value, register_t addr) {
   uint32_t phys_addr;
   if (!hart_->translate_mmu(addr, phys_addr, ACCESS_WRITE)) {
     return false;
   }
 
   if (phys_addr + 7 >= memory_size) {
-    std::cerr << "Memory write out of bounds: addr=" << std::hex << addr
-              << " (phys=" << phys_addr << ")" << std::endl;
-    std::exit(1);
+    if (!phys_->mmio_write(phys_addr, value, 8)) {
+      throw std::out_of_range("Memory write: address out of range: " +
+                              std::to_string(phys_addr));
+    }
+    return true;
   }
 
-  write_word(static_cast<uint32_t>(value & 0xFFFFFFFFULL), addr);
-  write_word(static_cast<uint32_t>((value >> 32) & 0xFFFFFFFFULL), addr + 4);
+  std::memcpy(mem_ + phys_addr, &value, sizeof(value));
+  mark_dirty(phys_addr, sizeof(value));
   return true;
 }
 
-void Memory::write_physical_byte(uint32_t paddr, uint8_t value) {
+void PhysicalMemory::write_physical_byte(uint32_t paddr, uint8_t value) {
   if (paddr >= memory_size) {
     std::cerr << "ERROR: Physical write to 0x" << std::hex << paddr
               << " beyond memory size 0x" << memory_size << "\n";
     return;
   }
   mem_[paddr] = value;
+  mark_dirty(paddr, 1);
 }
 
-void Memory::write_physical_word(uint32_t paddr, uint32_t value) {
+void PhysicalMemory::write_physical_word(uint32_t paddr, uint32_t value) {
   if (paddr + 3 >= memory_size) {
     std::cerr << "ERROR: Physical word write to 0x" << std::hex << paddr
               << " beyond memory size 0x" << memory_size << "\n";
@@ -224,9 +336,10 @@ void Memory::write_physical_word(uint32_t paddr, uint32_t value) {
   mem_[paddr + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
   mem_[paddr + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
   mem_[paddr + 3] = static_cast<uint8_t>((value >> 24) & 0xFF);
+  mark_dirty(paddr, 4);
 }
 
-uint8_t Memory::read_physical_byte(uint32_t paddr) const {
+uint8_t PhysicalMemory::read_physical_byte(uint32_t paddr) const {
   if (paddr >= memory_size) {
     std::cerr << "ERROR: Physical read from 0x" << std::hex << paddr
               << " beyond memory size 0x" << memory_size << "\n";
@@ -235,7 +348,16 @@ uint8_t Memory::read_physical_byte(uint32_t paddr) const {
   return mem_[paddr];
 }
 
-uint32_t Memory::read_physical_word(uint32_t paddr) const {
+uint16_t PhysicalMemory::read_physical_half(uint32_t paddr) const {
+  if (paddr + 1 >= memory_size) {
+    std::cerr << "ERROR: Physical read from 0x" << std::hex << paddr
+              << " beyond memory size 0x" << memory_size << "\n";
+    return 0;
+  }
+  return static_cast<uint16_t>(mem_[paddr] | (mem_[paddr + 1] << 8));
+}
+
+uint32_t PhysicalMemory::read_physical_word(uint32_t paddr) const {
   if (paddr + 3 >= memory_size) {
     std::cerr << "ERROR: Physical read from 0x" << std::hex << paddr
               << " beyond memory size 0x" << memory_size << "\n";
@@ -250,5 +372,190 @@ uint32_t Memory::read_physical_word(uint32_t paddr) const {
   return value;
 }
 
-void Memory::set_hart(Hart *hart) { hart_ = hart; }
+template <int XLEN>
+bool Memory<XLEN>::host_iovec(register_t addr, std::size_t size,
+                              uint32_t access_type, std::vector<iovec> &iov) {
+  iov.clear();
+  while (size > 0) {
+    std::size_t chunk = std::min<std::size_t>(size, 4096 - (addr & 0xFFF));
+    uint32_t phys_addr;
+    if (!hart_->translate_no_fault(addr, phys_addr, access_type) ||
+        phys_addr + chunk > memory_size) {
+      return false;
+    }
+
+    uint8_t *base = mem_ + phys_addr;
+    if (access_type == ACCESS_WRITE) {
+      mark_dirty(phys_addr, chunk);
+    }
+    if (!iov.empty() &&
+        static_cast<uint8_t *>(iov.back().iov_base) + iov.back().iov_len ==
+            base) {
+      iov.back().iov_len += chunk;
+    } else {
+      iov.push_back({base, chunk});
+    }
+    addr += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+template <int XLEN>
+bool Memory<XLEN>::read_block(register_t addr, uint8_t *dst,
+                              std::size_t size) {
+  while (size > 0) {
+    std::size_t chunk = std::min<std::size_t>(size, 4096 - (addr & 0xFFF));
+    uint32_t phys_addr;
+    if (!hart_->translate_mmu(addr, phys_addr, ACCESS_READ)) {
+      return false;
+    }
+    if (phys_addr + chunk <= memory_size) {
+      std::memcpy(dst, mem_ + phys_addr, chunk);
+    } else {
+      for (std::size_t i = 0; i < chunk; ++i) {
+        dst[i] = read_byte(addr + i);
+      }
+    }
+    addr += chunk;
+    dst += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+template <int XLEN>
+bool Memory<XLEN>::write_block(const uint8_t *src, register_t addr,
+                               std::size_t size) {
+  while (size > 0) {
+    std::size_t chunk = std::min<std::size_t>(size, 4096 - (addr & 0xFFF));
+    uint32_t phys_addr;
+    if (!hart_->translate_mmu(addr, phys_addr, ACCESS_WRITE)) {
+      return false;
+    }
+    if (phys_addr + chunk <= memory_size) {
+      std::memcpy(mem_ + phys_addr, src, chunk);
+      mark_dirty(phys_addr, chunk);
+    } else {
+      for (std::size_t i = 0; i < chunk; ++i) {
+        write_byte(src[i], addr + i);
+      }
+    }
+    addr += chunk;
+    src += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+template <int XLEN>
+bool Memory<XLEN>::read_string(register_t addr, std::string &str) {
+  str.clear();
+  for (std::size_t i = 0; i < 4096; ++i) {
+    uint32_t phys_addr;
+    if (!hart_->translate_no_fault(addr + i, phys_addr, ACCESS_READ) ||
+        phys_addr >= memory_size) {
+      return false;
+    }
+    if (mem_[phys_addr] == 0) {
+      return true;
+    }
+    str.push_back(static_cast<char>(mem_[phys_addr]));
+  }
+  return false;
+}
+
+const uint8_t *PhysicalMemory::physical_ptr(uint32_t paddr,
+                                            std::size_t size) const {
+  if (paddr >= memory_size ||
+      size > static_cast<std::size_t>(memory_size) - paddr) {
+    return nullptr;
+  }
+  return mem_ + paddr;
+}
+
+uint8_t *PhysicalMemory::writable_ptr(uint32_t paddr, std::size_t size) {
+  if (!physical_ptr(paddr, size)) {
+    return nullptr;
+  }
+  mark_dirty(paddr, size);
+  return mem_ + paddr;
+}
+
+template <int XLEN>
+bool Memory<XLEN>::atomic_ptr(register_t addr, std::size_t size,
+                              uint32_t access_type, uint8_t *&ptr) {
+  ptr = nullptr;
+  if (addr % size != 0) {
+    return true;
+  }
+  uint32_t phys_addr;
+  if (!hart_->translate_mmu(addr, phys_addr, access_type)) {
+    return false;
+  }
+  if (phys_->physical_ptr(phys_addr, size)) {
+    // LR only reads, so it leaves the page clean
+    ptr = mem_ + phys_addr;
+    if (access_type == ACCESS_WRITE) {
+      mark_dirty(phys_addr, size);
+    }
+  }
+  return true;
+}
+
+template <int XLEN>
+void Memory<XLEN>::attach(PhysicalMemory *phys, Hart<XLEN> *hart) {
+  phys_ = phys;
+  mem_ = phys->mem_;
+  dirty_ = phys->dirty_.get();
+  hart_ = hart;
+}
+
+void PhysicalMemory::add_device(uint32_t base, uint32_t size,
+                                Device *device) {
+  if (base < mmio_base || base + size > mmio_base + mmio_size) {
+    throw std::out_of_range("Device outside of the MMIO window");
+  }
+  if (mmio_pages_.empty()) {
+    mmio_pages_.resize(mmio_size >> mmio_page_shift);
+  }
+  for (uint32_t page = (base - mmio_base) >> mmio_page_shift;
+       page < (base - mmio_base + size + 0xFFF) >> mmio_page_shift; ++page) {
+    mmio_pages_[page] = {device, base};
+  }
+}
+
+const PhysicalMemory::MmioPage *
+PhysicalMemory::find_device(uint32_t paddr) const {
+  uint32_t page = (paddr - mmio_base) >> mmio_page_shift;
+  if (paddr < mmio_base || page >= mmio_pages_.size() ||
+      !mmio_pages_[page].device) {
+    return nullptr;
+  }
+  return &mmio_pages_[page];
+}
+
+uint64_t PhysicalMemory::mmio_read(uint32_t paddr, int size) {
+  std::lock_guard<std::mutex> lock(mmio_mutex_);
+  const MmioPage *page = find_device(paddr);
+  if (!page) {
+    throw std::out_of_range("Memory read: address out of range: " +
+                            std::to_string(paddr));
+  }
+  return page->device->read(paddr - page->base, size);
+}
+
+bool PhysicalMemory::mmio_write(uint32_t paddr, uint64_t value,
+                                int size) {
+  std::lock_guard<std::mutex> lock(mmio_mutex_);
+  const MmioPage *page = find_device(paddr);
+  if (!page) {
+    return false;
+  }
+  page->device->write(paddr - page->base, value, size);
+  return true;
+}
+
+template class Memory<32>;
+template class Memory<64>;
 } // namespace sim
\ No newline at end of file
@@ -1,55 +1,100 @@
 #include "mmu.hpp"
 #include "hart.hpp"
 #include "memory.hpp"
+#include <cstring>
 #include <iostream>
 
 namespace sim {
 
-MMU::MMU() {
+MmuStats &MmuStats::operator+=(const MmuStats &other) {
+  itlb_hits += other.itlb_hits;
+  itlb_misses += other.itlb_misses;
+  dtlb_hits += other.dtlb_hits;
+  dtlb_misses += other.dtlb_misses;
+  walk_cache_hits += other.walk_cache_hits;
+  page_faults += other.page_faults;
+  return *this;
+}
+
+template <int XLEN> MMU<XLEN>::MMU() {
   tlb_clear();
   init_tlb();
 }
 
-void MMU::init_tlb() {
-  for (auto &entry : tlb_) {
-    entry.valid = false;
-    entry.virtual_page = 0;
-    entry.physical_page = 0;
-    entry.flags = 0;
-    entry.asid = 0;
-  }
-  tlb_pointer_ = 0;
+template <int XLEN> void MMU<XLEN>::init_tlb() {
+  itlb_.clear();
+  dtlb_.clear();
+}
+
+template <int XLEN> void MMU<XLEN>::configure_tlb(const TlbConfig &config) {
+  itlb_.configure(config.entries, config.ways, config.policy);
+  dtlb_.configure(config.entries, config.ways, config.policy);
 }
 
-void MMU::set_hart(Hart *hart) { hart_ = hart; }
-
-void MMU::dump_tlb() const {
-  std::cout << "\n=== TLB Contents (" << TLB_SIZE << " entries) ===\n";
-  int valid_count = 0;
-
-  for (size_t i = 0; i < TLB_SIZE; i++) {
-    if (tlb_[i].valid) {
-      valid_count++;
-      std::cout << "  [" << i << "] VPN=0x" << std::hex << tlb_[i].virtual_page
-                << " -> PPN=0x" << tlb_[i].physical_page
-                << ", ASID=" << std::dec << tlb_[i].asid << ", flags=0x"
-                << std::hex << tlb_[i].flags << " "
-                << (tlb_[i].flags & PTE_R ? "R" : "-")
-                << (tlb_[i].flags & PTE_W ? "W" : "-")
-                << (tlb_[i].flags & PTE_X ? "X" : "-")
-                << (tlb_[i].flags & PTE_G ? "G" : "-") << std::dec << "\n";
+template <int XLEN> void MMU<XLEN>::copy_from(const MMU &other) {
+  satp_ = other.satp_;
+  mode_ = other.mode_;
+  itlb_.clear();
+  dtlb_.clear();
+  walk_cache_ = other.walk_cache_;
+}
+
+template <int XLEN> void MMU<XLEN>::save(StateWriter &out) const {
+  out.put(satp_);
+  out.put(mode_);
+}
+
+template <int XLEN> void MMU<XLEN>::restore(StateReader &in) {
+  in.get(satp_);
+  in.get(mode_);
+  tlb_clear();
+}
+
+template <int XLEN> void MMU<XLEN>::set_hart(Hart<XLEN> *hart) {
+  hart_ = hart;
+}
+
+template <int XLEN> void MMU<XLEN>::dump_tlb() const {
+  for (const TLB *tlb : {&itlb_, &dtlb_}) {
+    const auto &entries = tlb->entries();
+    std::cout << "\n=== " << (tlb == &itlb_ ? "iTLB" : "dTLB")
+              << " Contents (" << entries.size() << " entries, "
+              << tlb->ways() << "-way) ===\n";
+    int valid_count = 0;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      const TLBEntry &entry = entries[i];
+      if (entry.valid) {
+        valid_count++;
+        std::cout << "  [" << i << "] VPN=0x" << std::hex
+                  << entry.virtual_page
+                  << (entry.level ? " (superpage)" : "") << " -> PPN=0x"
+                  << entry.physical_page << ", ASID=" << std::dec
+                  << entry.asid << ", flags=0x" << std::hex << entry.flags
+                  << " " << (entry.flags & PTE_R ? "R" : "-")
+                  << (entry.flags & PTE_W ? "W" : "-")
+                  << (entry.flags & PTE_X ? "X" : "-")
+                  << (entry.flags & PTE_G ? "G" : "-") << std::dec << "\n";
+      }
     }
-  }
 
-  std::cout << "Valid entries: " << valid_count << "/" << TLB_SIZE << "\n";
+    std::cout << "Valid entries: " << valid_count << "/" << entries.size()
+              << "\n";
+  }
 }
 
-bool MMU::translate(uint32_t vaddr, uint32_t &paddr, uint32_t access_type,
-                    bool &page_fault) {
+template <int XLEN>
+bool MMU<XLEN>::translate(register_t vaddr, uint32_t &paddr,
+                          uint32_t access_type, bool &page_fault) {
   page_fault = false;
 
   if (mode_ == 0) {
-    paddr = vaddr;
+    // Physical addresses are 32-bit
+    if (XLEN > 32 && vaddr >> 31 >> 1) {
+      page_fault = true;
+      return false;
+    }
+    paddr = static_cast<uint32_t>(vaddr);
     return true;
   }
 
@@ -58,230 +103,260 @@ bool MMU::translate(uint32_t vaddr, uint32_t &paddr, uint32_t access_type,
     return false;
   }
 
-  uint32_t offset = vaddr & 0xFFF;
-  uint32_t vpn0 = (vaddr >> 12) & 0x3FF;
-  uint32_t vpn1 = (vaddr >> 22) & 0x3FF;
-  uint32_t full_vpn = (vpn1 << 10) | vpn0;
+  // Sv39 addresses must be sign-extended from bit 38
+  if (XLEN > va_bits &&
+      static_cast<sregister_t>(vaddr << (XLEN - va_bits)) >>
+              (XLEN - va_bits) !=
+          static_cast<sregister_t>(vaddr)) {
+    page_fault = true;
+    page_faults_++;
+    return false;
+  }
+
+  uint32_t vpn =
+      static_cast<uint32_t>(vaddr >> 12) & ((1u << (va_bits - 12)) - 1);
 
 #ifdef DEBUG_MMU
   std::cout << "MMU translate:" << " pc:" << std::hex << hart_->pc
             << " va: " << vaddr << "\n";
 #endif
 
-  uint32_t current_asid = (satp_ >> 22) & 0x1FF;
-  for (size_t i = 0; i < TLB_SIZE; i++) {
-    if (tlb_[i].valid && tlb_[i].virtual_page == full_vpn &&
-        ((tlb_[i].flags & PTE_G) || tlb_[i].asid == current_asid)) {
-
-      tlb_hits_++;
-      paddr = (tlb_[i].physical_page << 12) | offset;
+  uint32_t current_asid =
+      static_cast<uint32_t>(satp_ >> Mode::satp_asid_shift) &
+      Mode::satp_asid_mask;
+  TLB &tlb = access_type == ACCESS_EXECUTE ? itlb_ : dtlb_;
+  const TLBEntry *entry = tlb.lookup(vpn, current_asid);
+  // A store through a clean entry goes to the walk so that D gets set
+  if (entry && check_permissions(entry->flags, access_type) &&
+      (access_type != ACCESS_WRITE || (entry->flags & PTE_D))) {
+    paddr = (entry->physical_page << 12) |
+            static_cast<uint32_t>(vaddr & page_offset_mask(entry->level));
 
 #ifdef DEBUG_MMU
-      std::cout << "TLB HIT: 0x" << std::hex << vaddr << " -> 0x" << paddr
-                << std::dec << "\n";
+    std::cout << "TLB HIT: 0x" << std::hex << vaddr << " -> 0x" << paddr
+              << std::dec << "\n";
 #endif
 
-      return true;
-    }
+    return true;
   }
 
-  tlb_misses_++;
-
 #ifdef DEBUG_MMU
   std::cout << "TLB MISS, walking page tables...\n";
 #endif
 
-  uint32_t root_ppn = satp_ & 0x3FFFFF;
-  uint32_t pte1_addr = (root_ppn << 12) + (vpn1 * 4);
+  uint64_t root_ppn = satp_ & Mode::ppn_mask;
+  uint32_t vpn_high = vpn >> Mode::vpn_bits;
+  uint64_t table_ppn = root_ppn;
+  uint32_t level = Mode::levels - 1;
 
-  PageTableEntry pte1;
-  if (!read_pte(pte1_addr, pte1)) {
-    page_fault = true;
-    page_faults_++;
-    return false;
+  WalkCacheEntry &walk = walk_cache_[vpn_high % walk_cache_size];
+  if (walk.valid && walk.root_ppn == root_ppn && walk.vpn_high == vpn_high) {
+    walk_cache_hits_++;
+    table_ppn = walk.table_ppn;
+    level = 0;
   }
 
-#ifdef DEBUG_MMU
-  std::cout << "PTE1 read from 0x" << std::hex << pte1_addr << ": ppn=0x"
-            << pte1.ppn << ", flags=0x" << pte1.flags
-            << ", valid=" << pte1.valid << std::dec << "\n";
-#endif
+  for (;; --level) {
+    // Tables must lie in the 32-bit physical address space
+    uint64_t pte_addr =
+        (table_ppn << 12) +
+        ((vpn >> (level * Mode::vpn_bits)) & vpn_index_mask) * Mode::pte_size;
 
-  if (!pte1.valid) {
+    PageTableEntry pte;
+    if (pte_addr >> 32 || !read_pte(static_cast<uint32_t>(pte_addr), pte) ||
+        !pte.valid) {
 #ifdef DEBUG_MMU
-    std::cout << "Page fault: PTE1 invalid\n";
+      std::cout << "Page fault: level " << level << " PTE invalid\n";
 #endif
-    page_fault = true;
-    page_faults_++;
-    return false;
-  }
-
-  bool is_leaf = (pte1.flags & (PTE_R | PTE_W | PTE_X)) != 0;
-
-  if (is_leaf) {
-    if (!check_permissions(pte1.flags, access_type)) {
       page_fault = true;
       page_faults_++;
       return false;
     }
 
-    pte1.flags |= PTE_A;
-    if (access_type == 0x2) {
-      pte1.flags |= PTE_D;
-    }
-    write_pte(pte1_addr, pte1);
-    tlb_add(vaddr, pte1.ppn, pte1.flags, current_asid);
-
-    paddr = ((pte1.ppn << 12) & 0xFFC00000) | (vaddr & 0x3FFFFF);
-
 #ifdef DEBUG_MMU
-    std::cout << "Translation success (4MB): 0x" << std::hex << vaddr
-              << " -> 0x" << paddr << std::dec << "\n";
+    std::cout << "Level " << level << " PTE read from 0x" << std::hex
+              << pte_addr << ": ppn=0x" << pte.ppn << ", flags=0x" << pte.flags
+              << std::dec << "\n";
 #endif
 
-    return true;
-  } else {
-    uint32_t level2_table_addr = pte1.ppn << 12;
-    uint32_t pte0_addr = level2_table_addr + (vpn0 * 4);
+    bool is_leaf = (pte.flags & (PTE_R | PTE_W | PTE_X)) != 0;
+
+    if (is_leaf) {
+      // A superpage must be aligned to its size, and the frame must be below
+      // 4 GiB
+      uint64_t level_mask = page_offset_mask(level) >> 12;
+      if (!check_permissions(pte.flags, access_type) ||
+          (pte.ppn & level_mask) != 0 || pte.ppn >> 20) {
+        page_fault = true;
+        page_faults_++;
+        return false;
+      }
+
+      update_accessed_dirty(static_cast<uint32_t>(pte_addr), pte, access_type);
+      tlb_add(vpn, static_cast<uint32_t>(pte.ppn), pte.flags, current_asid,
+              access_type, level);
+
+      paddr = static_cast<uint32_t>(pte.ppn << 12) |
+              static_cast<uint32_t>(vaddr & page_offset_mask(level));
 
-    PageTableEntry pte0;
-    if (!read_pte(pte0_addr, pte0) || !pte0.valid) {
 #ifdef DEBUG_MMU
-      std::cout << "Page fault: PTE0 invalid\n";
+      std::cout << "Translation success: 0x" << std::hex << vaddr << " -> 0x"
+                << paddr << std::dec << "\n";
 #endif
-      page_fault = true;
-      page_faults_++;
-      return false;
+
+      return true;
     }
-#ifdef DEBUG_MMU
-    std::cout << "PTE0 read from 0x" << std::hex << pte0_addr << ": ppn=0x"
-              << pte0.ppn << ", flags=0x" << pte0.flags
-              << ", valid=" << pte0.valid << std::dec << "\n";
-#endif
 
-    if (!check_permissions(pte0.flags, access_type)) {
+    if (level == 0) {
       page_fault = true;
       page_faults_++;
       return false;
     }
-
-    pte0.flags |= PTE_A;
-    if (access_type == 0x2) {
-      pte0.flags |= PTE_D;
+    if (level == 1) {
+      walk = {true, root_ppn, vpn_high, pte.ppn};
     }
-    write_pte(pte0_addr, pte0);
-
-    tlb_add(vaddr, pte0.ppn, pte0.flags, current_asid);
-    paddr = (pte0.ppn << 12) | offset;
-
-#ifdef DEBUG_MMU
-    std::cout << "Translation success (4KB): 0x" << std::hex << vaddr
-              << " -> 0x" << paddr << std::dec << "\n";
-#endif
-
-    return true;
+    table_ppn = pte.ppn;
   }
-
-  page_fault = true;
-  return false;
 }
 
-void MMU::tlb_add(uint32_t vaddr, uint32_t ppn, uint32_t flags, uint32_t asid) {
-  uint32_t vpn0 = (vaddr >> 12) & 0x3FF;
-  uint32_t vpn1 = (vaddr >> 22) & 0x3FF;
-  uint32_t full_vpn = (vpn1 << 10) | vpn0;
-
-  for (size_t i = 0; i < TLB_SIZE; i++) {
-    if (tlb_[i].valid && tlb_[i].virtual_page == full_vpn &&
-        tlb_[i].asid == asid) {
-      tlb_[i].physical_page = ppn;
-      tlb_[i].flags = flags;
-      return;
-    }
+template <int XLEN>
+void MMU<XLEN>::update_accessed_dirty(uint32_t pte_addr, PageTableEntry &pte,
+                                      uint32_t access_type) {
+  uint32_t flags = pte.flags | PTE_A;
+  if (access_type == ACCESS_WRITE) {
+    flags |= PTE_D;
+  }
+  // Most walks hit PTEs that already have A (and D) set
+  if (flags != pte.flags) {
+    pte.flags = flags;
+    write_pte(pte_addr, pte);
   }
-
-  tlb_[tlb_pointer_].valid = true;
-  tlb_[tlb_pointer_].virtual_page = full_vpn;
-  tlb_[tlb_pointer_].physical_page = ppn;
-  tlb_[tlb_pointer_].flags = flags;
-  tlb_[tlb_pointer_].asid = asid;
-
-  tlb_pointer_ = (tlb_pointer_ + 1) % TLB_SIZE;
 }
 
-void MMU::tlb_clear() {
-  for (auto &entry : tlb_) {
+template <int XLEN> void MMU<XLEN>::walk_cache_clear() {
+  for (auto &entry : walk_cache_) {
     entry.valid = false;
   }
-  tlb_pointer_ = 0;
 }
 
-bool MMU::read_pte(uint32_t pte_addr, PageTableEntry &pte) {
-  uint32_t pte_value;
+template <int XLEN>
+void MMU<XLEN>::tlb_add(uint32_t vpn, uint32_t ppn, uint32_t flags,
+                        uint32_t asid, uint32_t access_type, uint32_t level) {
+  TLB &tlb = access_type == ACCESS_EXECUTE ? itlb_ : dtlb_;
+  tlb.insert(vpn, ppn, flags, asid, level);
+}
+
+template <int XLEN> void MMU<XLEN>::tlb_clear() {
+  itlb_.clear();
+  dtlb_.clear();
+  walk_cache_clear();
+}
+
+template <int XLEN>
+bool MMU<XLEN>::read_pte(uint32_t pte_addr, PageTableEntry &pte) {
+  const uint8_t *ptr = hart_->mem_->physical_ptr(pte_addr, Mode::pte_size);
+  if (!ptr) {
+    return false;
+  }
 
-  pte_value = hart_->mem_->read_physical_word(pte_addr);
+  uint64_t pte_value = 0;
+  std::memcpy(&pte_value, ptr, Mode::pte_size);
   pte.valid = (pte_value & 1) != 0;
-  pte.ppn = (pte_value >> 10) & 0x3FFFFF;
+  pte.ppn = (pte_value >> 10) & Mode::ppn_mask;
   pte.flags = pte_value & 0x3FF;
 
   return true;
 }
 
-bool MMU::write_pte(uint32_t pte_addr, const PageTableEntry &pte) {
-  uint32_t pte_value = 0;
+template <int XLEN>
+bool MMU<XLEN>::write_pte(uint32_t pte_addr, const PageTableEntry &pte) {
+  uint64_t pte_value = 0;
 
   if (pte.valid) {
     pte_value |= 1;
   }
 
-  pte_value |= (pte.ppn & 0x3FFFFF) << 10;
+  pte_value |= (pte.ppn & Mode::ppn_mask) << 10;
 
   pte_value |= pte.flags & 0x3FF;
 
-  (*hart_->mem_)[pte_addr] = static_cast<uint8_t>(pte_value & 0xFF);
-  (*hart_->mem_)[pte_addr + 1] = static_cast<uint8_t>((pte_value >> 8) & 0xFF);
-  (*hart_->mem_)[pte_addr + 2] = static_cast<uint8_t>((pte_value >> 16) & 0xFF);
-  (*hart_->mem_)[pte_addr + 3] = static_cast<uint8_t>((pte_value >> 24) & 0xFF);
+  uint8_t *ptr = hart_->mem_->writable_ptr(pte_addr, Mode::pte_size);
+  if (!ptr) {
+    return false;
+  }
+  std::memcpy(ptr, &pte_value, Mode::pte_size);
 
   return true;
 }
 
-void MMU::set_satp(uint32_t value) {
+template <int XLEN> void MMU<XLEN>::set_satp(register_t value) {
   satp_ = value;
 
-  uint32_t satp_mode = (value >> 31);
+  uint32_t satp_mode = static_cast<uint32_t>(value >> Mode::satp_mode_shift);
   if (satp_mode == 0) {
     mode_ = 0; // Bare mode
-  } else if (satp_mode == 1) {
-    mode_ = 1; // Sv32
+  } else if (satp_mode == Mode::satp_mode) {
+    mode_ = Mode::satp_mode; // Sv32 or Sv39
   }
 }
 
-uint32_t MMU::get_satp() const { return satp_; }
+template <int XLEN>
+typename MMU<XLEN>::register_t MMU<XLEN>::get_satp() const {
+  return satp_;
+}
 
-void MMU::tlb_remove(uint32_t vaddr, uint32_t asid) {
-  uint32_t vpn = vaddr >> 12;
+template <int XLEN>
+void MMU<XLEN>::sfence_vma(bool has_vaddr, register_t vaddr, bool has_asid,
+                           register_t asid) {
+  uint32_t asid_bits = static_cast<uint32_t>(asid) & Mode::satp_asid_mask;
+  if (!has_vaddr && !has_asid) {
+    tlb_clear();
+    return;
+  }
 
-  for (size_t i = 0; i < TLB_SIZE; i++) {
-    if (tlb_[i].valid && tlb_[i].virtual_page == vpn && tlb_[i].asid == asid) {
-      tlb_[i].valid = false;
+  uint32_t vpn =
+      static_cast<uint32_t>(vaddr >> 12) & ((1u << (va_bits - 12)) - 1);
+  for (TLB *tlb : {&itlb_, &dtlb_}) {
+    if (has_vaddr) {
+      tlb->remove(vpn, has_asid, asid_bits);
+    } else {
+      tlb->remove_asid(asid_bits);
     }
   }
+
+  // Walk cache entries are not tagged with an ASID
+  if (has_vaddr) {
+    walk_cache_[(vpn >> Mode::vpn_bits) % walk_cache_size].valid = false;
+  } else {
+    walk_cache_clear();
+  }
 }
 
-void MMU::dump_stats() const {
+template <int XLEN> void MMU<XLEN>::dump_stats() const {
+  uint64_t tlb_hits = itlb_.hits() + dtlb_.hits();
+  uint64_t tlb_misses = itlb_.misses() + dtlb_.misses();
+
   std::cout << "MMU Statistics:\n";
-  std::cout << "  TLB hits: " << tlb_hits_ << "\n";
-  std::cout << "  TLB misses: " << tlb_misses_ << "\n";
+  std::cout << "  TLB hits: " << tlb_hits << " (iTLB " << itlb_.hits()
+            << ", dTLB " << dtlb_.hits() << ")\n";
+  std::cout << "  TLB misses: " << tlb_misses << " (iTLB " << itlb_.misses()
+            << ", dTLB " << dtlb_.misses() << ")\n";
+  std::cout << "  Page walk cache hits: " << walk_cache_hits_ << "\n";
   std::cout << "  Page faults: " << page_faults_ << "\n";
 
-  if (tlb_hits_ + tlb_misses_ > 0) {
-    double hit_rate = (double)tlb_hits_ / (tlb_hits_ + tlb_misses_) * 100;
+  if (tlb_hits + tlb_misses > 0) {
+    double hit_rate = (double)tlb_hits / (tlb_hits + tlb_misses) * 100;
     std::cout << "  TLB hit rate: " << hit_rate << "%\n";
   }
 }
 
-bool MMU::check_permissions(uint32_t pte_flags, uint32_t access_type) {
+template <int XLEN> MmuStats MMU<XLEN>::stats() const {
+  return {itlb_.hits(),   itlb_.misses(),   dtlb_.hits(),
+          dtlb_.misses(), walk_cache_hits_, page_faults_};
+}
+
+template <int XLEN>
+bool MMU<XLEN>::check_permissions(uint32_t pte_flags, uint32_t access_type) {
   switch (access_type) {
   case 0: // read
     return (pte_flags & PTE_R) != 0;
@@ -294,4 +369,6 @@ bool MMU::check_permissions(uint32_t pte_flags, uint32_t access_type) {
   }
 }
 
-}; // namespace sim
\ No newline at end of file
+template class MMU<32>;
+template class MMU<64>;
+}; // namespace sim
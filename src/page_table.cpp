@@ -0,0 +1,115 @@
+#include "page_table.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace sim {
+template <int XLEN>
+PageTableBuilder<XLEN>::PageTableBuilder(PhysicalMemory &mem, uint32_t base,
+                                         uint32_t size)
+    : mem_(mem), root_(base), next_table_(base), limit_(base + size) {
+  if (base % page_size != 0) {
+    throw std::invalid_argument("Page table must be 4KB aligned");
+  }
+  root_ = alloc_table();
+}
+
+template <int XLEN>
+uint64_t PageTableBuilder<XLEN>::read_pte(uint32_t addr) const {
+  const uint8_t *ptr = mem_.physical_ptr(addr, Mode::pte_size);
+  uint64_t value = 0;
+  std::memcpy(&value, ptr, Mode::pte_size);
+  return value;
+}
+
+template <int XLEN>
+void PageTableBuilder<XLEN>::write_pte(uint32_t addr, uint64_t value) {
+  std::memcpy(mem_.writable_ptr(addr, Mode::pte_size), &value,
+              Mode::pte_size);
+}
+
+template <int XLEN> uint32_t PageTableBuilder<XLEN>::alloc_table() {
+  uint8_t *table = next_table_ + page_size <= limit_
+                       ? mem_.writable_ptr(next_table_, page_size)
+                       : nullptr;
+  if (!table) {
+    throw std::out_of_range("Out of space for page tables");
+  }
+  std::memset(table, 0, page_size);
+  uint32_t addr = next_table_;
+  next_table_ += page_size;
+  return addr;
+}
+
+template <int XLEN>
+void PageTableBuilder<XLEN>::map(uint64_t vaddr, uint32_t paddr,
+                                 uint64_t size, uint32_t flags) {
+  uint32_t offset = vaddr & (page_size - 1);
+  uint64_t end = vaddr + size;
+  uint64_t va = vaddr - offset;
+  uint64_t pa = paddr - offset;
+
+  flags |= PTE_V | PTE_A;
+  if (flags & PTE_W) {
+    flags |= PTE_D;
+  }
+
+  while (va < end) {
+    uint32_t table = root_;
+    uint64_t step = page_size;
+
+    for (uint32_t level = Mode::levels - 1;; --level) {
+      uint32_t shift = 12 + level * Mode::vpn_bits;
+      uint64_t level_size = uint64_t{1} << shift;
+      uint32_t index = (va >> shift) & ((1u << Mode::vpn_bits) - 1);
+      uint32_t pte_addr = table + index * Mode::pte_size;
+      uint64_t pte = read_pte(pte_addr);
+      uint64_t leaf = ((pa >> 12) << 10) | flags;
+
+      if (level == 0) {
+        if ((pte & PTE_V) && (pte >> 10) == (leaf >> 10)) {
+          leaf |= pte;
+        }
+        write_pte(pte_addr, leaf);
+        break;
+      }
+
+      if (!(pte & PTE_V) && (va | pa) % level_size == 0 &&
+          end - va >= level_size) {
+        write_pte(pte_addr, leaf);
+        step = level_size;
+        break;
+      }
+
+      if (pte & (PTE_R | PTE_W | PTE_X)) {
+        // Already covered by a superpage
+        if ((pte >> 10) << 12 == (pa & ~(level_size - 1))) {
+          write_pte(pte_addr, pte | flags);
+        }
+        step = level_size - (va & (level_size - 1));
+        break;
+      }
+
+      if (!(pte & PTE_V)) {
+        pte = ((uint64_t{alloc_table()} >> 12) << 10) | PTE_V;
+        write_pte(pte_addr, pte);
+      }
+      table = static_cast<uint32_t>((pte >> 10) << 12);
+    }
+
+    va += step;
+    pa += step;
+  }
+}
+
+template <int XLEN>
+typename Xlen<XLEN>::reg PageTableBuilder<XLEN>::satp(uint32_t asid) const {
+  using register_t = typename Xlen<XLEN>::reg;
+  return (register_t{Mode::satp_mode} << Mode::satp_mode_shift) |
+         (register_t{asid & Mode::satp_asid_mask} << Mode::satp_asid_shift) |
+         (root_ >> 12);
+}
+
+template class PageTableBuilder<32>;
+template class PageTableBuilder<64>;
+} // namespace sim
@@ -0,0 +1,221 @@
+#include "snapshot.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace sim {
+namespace {
+constexpr char magic[8] = {'R', 'V', 'S', 'N', 'A', 'P', '0', '3'};
+
+// Runs body(begin, end) over [0, n) split into one range per host CPU
+void in_parallel(std::size_t n,
+                 const std::function<void(std::size_t, std::size_t)> &body) {
+  if (n == 0) {
+    return;
+  }
+  std::size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t chunk = (n + n_threads - 1) / n_threads;
+  std::vector<std::thread> threads;
+  for (std::size_t begin = 0; begin < n; begin += chunk) {
+    threads.emplace_back(body, begin, std::min(n, begin + chunk));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void write_at(int fd, const void *data, std::size_t size, uint64_t offset) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  while (size > 0) {
+    ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+    if (written <= 0) {
+      throw std::runtime_error("Cannot write snapshot");
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+}
+
+void read_at(int fd, void *data, std::size_t size, uint64_t offset) {
+  auto *bytes = static_cast<uint8_t *>(data);
+  while (size > 0) {
+    ssize_t n = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+    if (n <= 0) {
+      throw std::runtime_error("Snapshot file is truncated");
+    }
+    bytes += n;
+    size -= static_cast<std::size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+}
+
+bool is_zero(const uint8_t *page) {
+  const auto *words = reinterpret_cast<const uint64_t *>(page);
+  for (std::size_t i = 0; i < SnapshotFile::page_size / 8; ++i) {
+    if (words[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+void SnapshotFile::write(const std::string &path, int xlen,
+                         std::size_t n_harts, const StateWriter &state,
+                         const PhysicalMemory &memory,
+                         const std::string &parent,
+                         const std::vector<uint32_t> &pages) {
+  if (!parent.empty() && std::filesystem::absolute(path) == parent) {
+    throw std::invalid_argument("A snapshot cannot replace its parent");
+  }
+  const uint8_t *ram = memory.data();
+  std::size_t n_pages = PhysicalMemory::n_pages;
+  // Pages to look at: all pages ever written for a full snapshot, those
+  // written since the last one for an incremental snapshot. The latter go
+  // in even if they are zero now, since the parent may hold something else.
+  std::vector<bool> used;
+  if (parent.empty()) {
+    used = memory.used_pages();
+  } else {
+    used.resize(n_pages);
+    for (uint32_t page : pages) {
+      used[page] = true;
+    }
+  }
+
+  // Hashes of the stored pages, 0 for the others
+  std::vector<std::size_t> hashes(n_pages);
+  std::vector<uint8_t> stored(n_pages);
+  in_parallel(n_pages, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      const uint8_t *page = ram + i * page_size;
+      if (used[i] && (!parent.empty() || !is_zero(page))) {
+        stored[i] = 1;
+        hashes[i] = std::hash<std::string_view>{}(std::string_view(
+            reinterpret_cast<const char *>(page), page_size));
+      }
+    }
+  });
+
+  std::vector<PageEntry> entries;
+  // First page of each stored copy
+  std::vector<uint32_t> blobs;
+  std::unordered_multimap<std::size_t, uint32_t> by_hash;
+  for (std::size_t i = 0; i < n_pages; ++i) {
+    if (!stored[i]) {
+      continue;
+    }
+    const uint8_t *page = ram + i * page_size;
+    uint32_t blob = static_cast<uint32_t>(blobs.size());
+    auto range = by_hash.equal_range(hashes[i]);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (std::memcmp(page, ram + std::size_t{blobs[it->second]} * page_size,
+                      page_size) == 0) {
+        blob = it->second;
+        break;
+      }
+    }
+    if (blob == blobs.size()) {
+      blobs.push_back(static_cast<uint32_t>(i));
+      by_hash.emplace(hashes[i], blob);
+    }
+    entries.push_back({static_cast<uint32_t>(i), blob});
+  }
+
+  Header header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.xlen = static_cast<uint32_t>(xlen);
+  header.harts = static_cast<uint32_t>(n_harts);
+  header.state_size = state.data().size();
+  header.parent_size = parent.size();
+  header.n_pages = entries.size();
+  uint64_t map_offset = sizeof(Header) + header.state_size + parent.size();
+  uint64_t map_end = map_offset + entries.size() * sizeof(PageEntry);
+  header.data_offset = (map_end + page_size - 1) / page_size * page_size;
+
+  // A machine may still map pages of the file being replaced
+  std::string temporary = path + ".tmp";
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create snapshot: " + path);
+  }
+  try {
+    write_at(fd, &header, sizeof(header), 0);
+    write_at(fd, state.data().data(), state.data().size(), sizeof(Header));
+    write_at(fd, parent.data(), parent.size(),
+             sizeof(Header) + header.state_size);
+    write_at(fd, entries.data(), entries.size() * sizeof(PageEntry),
+             map_offset);
+    in_parallel(blobs.size(), [&](std::size_t begin, std::size_t end) {
+      for (std::size_t b = begin; b < end; ++b) {
+        write_at(fd, ram + std::size_t{blobs[b]} * page_size, page_size,
+                 header.data_offset + b * page_size);
+      }
+    });
+  } catch (...) {
+    ::close(fd);
+    std::remove(temporary.c_str());
+    throw;
+  }
+  ::close(fd);
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("Cannot create snapshot: " + path);
+  }
+}
+
+SnapshotFile::SnapshotFile(const std::string &path)
+    : path_(std::filesystem::absolute(path).string()) {
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot open snapshot: " + path);
+  }
+  try {
+    read_at(fd_, &header_, sizeof(header_), 0);
+    if (std::memcmp(header_.magic, magic, sizeof(magic)) != 0) {
+      throw std::runtime_error("Not a snapshot file: " + path);
+    }
+    state_.resize(header_.state_size);
+    read_at(fd_, state_.data(), state_.size(), sizeof(Header));
+    parent_.resize(header_.parent_size);
+    read_at(fd_, parent_.data(), parent_.size(),
+            sizeof(Header) + header_.state_size);
+    pages_.resize(header_.n_pages);
+    read_at(fd_, pages_.data(), pages_.size() * sizeof(PageEntry),
+            sizeof(Header) + header_.state_size + header_.parent_size);
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+SnapshotFile::~SnapshotFile() { ::close(fd_); }
+
+void SnapshotFile::map_memory(PhysicalMemory &memory) const {
+  if (!parent_.empty()) {
+    SnapshotFile(parent_).map_memory(memory);
+  }
+  // Runs of pages whose copies follow each other in the file take one mmap
+  for (std::size_t i = 0; i < pages_.size();) {
+    std::size_t run = 1;
+    while (i + run < pages_.size() &&
+           pages_[i + run].page == pages_[i].page + run &&
+           pages_[i + run].blob == pages_[i].blob + run) {
+      ++run;
+    }
+    memory.map_file(fd_, header_.data_offset + pages_[i].blob * page_size,
+                    static_cast<uint32_t>(pages_[i].page * page_size),
+                    run * page_size);
+    i += run;
+  }
+}
+} // namespace sim
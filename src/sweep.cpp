@@ -0,0 +1,101 @@
+#include "sweep.hpp"
+
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace sim {
+namespace {
+struct Outcome {
+  MmuStats stats;
+  long instructions = 0;
+  double seconds = 0;
+  std::string error;
+};
+
+double percent(uint64_t hits, uint64_t misses) {
+  return hits + misses ? 100.0 * hits / (hits + misses) : 0;
+}
+} // namespace
+
+Sweep::Sweep(long fast_forward, long region, std::vector<TlbConfig> configs)
+    : fast_forward_(fast_forward), region_(region),
+      configs_(std::move(configs)) {}
+
+int Sweep::run(MachineBase &machine) const {
+  auto start = std::chrono::steady_clock::now();
+  machine.set_quiet(true);
+  machine.set_instruction_limit(fast_forward_);
+  int exit_code = machine.run();
+  if (!machine.out_of_budget()) {
+    std::cout << "Program exited after " << machine.instructions()
+              << " instructions, before the end of the fast-forward"
+              << std::endl;
+    return exit_code;
+  }
+  std::chrono::duration<double> warm_up =
+      std::chrono::steady_clock::now() - start;
+  long forked_at = machine.instructions();
+
+  // Forks only read the stopped machine, so they are made in parallel too
+  std::vector<Outcome> outcomes(configs_.size());
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < configs_.size(); ++i) {
+    threads.emplace_back([this, &machine, &outcomes, forked_at, i] {
+      Outcome &outcome = outcomes[i];
+      try {
+        std::unique_ptr<MachineBase> fork = machine.fork();
+        fork->configure_tlb(configs_[i]);
+        fork->set_instruction_limit(fast_forward_ + region_);
+        auto begin = std::chrono::steady_clock::now();
+        fork->resume();
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        outcome.seconds = elapsed.count();
+        outcome.stats = fork->mmu_stats();
+        outcome.instructions = fork->instructions() - forked_at;
+      } catch (const std::exception &e) {
+        outcome.error = e.what();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::cout << "Fast-forward: " << forked_at << " instructions in "
+            << warm_up.count() << " s" << std::endl;
+  std::cout << std::left << std::setw(16) << "TLB" << std::right
+            << std::setw(14) << "Instructions" << std::setw(10) << "iTLB %"
+            << std::setw(10) << "dTLB %" << std::setw(10) << "TLB %"
+            << std::setw(12) << "Misses" << std::setw(12) << "Walk hits"
+            << std::setw(8) << "Faults" << std::setw(10) << "MIPS"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  for (std::size_t i = 0; i < configs_.size(); ++i) {
+    const Outcome &outcome = outcomes[i];
+    std::cout << std::left << std::setw(16) << configs_[i].name()
+              << std::right;
+    if (!outcome.error.empty()) {
+      std::cout << "  error: " << outcome.error << std::endl;
+      continue;
+    }
+    const MmuStats &stats = outcome.stats;
+    double mips = outcome.seconds > 0
+                      ? outcome.instructions / (outcome.seconds * 1e6)
+                      : 0;
+    std::cout << std::setw(14) << outcome.instructions << std::setw(10)
+              << percent(stats.itlb_hits, stats.itlb_misses) << std::setw(10)
+              << percent(stats.dtlb_hits, stats.dtlb_misses) << std::setw(10)
+              << percent(stats.itlb_hits + stats.dtlb_hits,
+                         stats.itlb_misses + stats.dtlb_misses)
+              << std::setw(12) << stats.itlb_misses + stats.dtlb_misses
+              << std::setw(12) << stats.walk_cache_hits << std::setw(8)
+              << stats.page_faults << std::setw(10) << mips << std::endl;
+  }
+  std::cout << std::defaultfloat;
+  return 0;
+}
+} // namespace sim
@@ -0,0 +1,367 @@
+#include "syscall.hpp"
+#include "hart.hpp"
+#include "registers.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sim {
+namespace {
+const uint8_t reg_a0 = static_cast<uint8_t>(RiscvRegisters::a0);
+const uint8_t reg_a7 = static_cast<uint8_t>(RiscvRegisters::a7);
+
+template <int XLEN>
+typename Hart<XLEN>::register_t arg(const Hart<XLEN> *hart, int n) {
+  return hart->gpr_[reg_a0 + n];
+}
+
+// Results are truncated to the register width when written back to a0
+uint64_t error(int err) { return static_cast<uint64_t>(-err); }
+
+uint64_t result(long value) {
+  return value < 0 ? error(errno) : static_cast<uint64_t>(value);
+}
+
+// Waits until a read from fd would not block. Regular files always poll
+// readable, and errors are left to read() itself. Returns false if the hart
+// has to give its thread back first: at once when it is cooperative, and
+// once it is stopped otherwise, so that a hart waiting for input does not
+// keep the machine from ending.
+template <int XLEN> bool wait_readable(const Hart<XLEN> *hart, int fd) {
+  pollfd request{fd, POLLIN, 0};
+  if (hart->cooperative()) {
+    return ::poll(&request, 1, 0) != 0;
+  }
+  while (::poll(&request, 1, 100) == 0) {
+    if (hart->stop_requested()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// struct kernel_stat as laid out by newlib/libgloss for RISC-V (the same
+// 128-byte layout as asm-generic stat64)
+struct GuestStat {
+  uint64_t st_dev;
+  uint64_t st_ino;
+  uint32_t st_mode;
+  uint32_t st_nlink;
+  uint32_t st_uid;
+  uint32_t st_gid;
+  uint64_t st_rdev;
+  uint64_t pad1;
+  int64_t st_size;
+  int32_t st_blksize;
+  int32_t pad2;
+  int64_t st_blocks;
+  int64_t st_atime_sec;
+  int64_t st_atime_nsec;
+  int64_t st_mtime_sec;
+  int64_t st_mtime_nsec;
+  int64_t st_ctime_sec;
+  int64_t st_ctime_nsec;
+  int32_t reserved[2];
+};
+static_assert(sizeof(GuestStat) == 128, "kernel_stat must be 128 bytes");
+
+// Layout shared by struct timespec and struct timeval on both RV32 (64-bit
+// time_t, 32-bit long padded to 8) and RV64
+struct GuestTime {
+  int64_t sec;
+  int64_t frac;
+};
+} // namespace
+
+void Syscalls::set_brk(uint64_t addr) {
+  brk_start_ = (addr + 0xFFF) & ~uint64_t{0xFFF};
+  brk_ = brk_start_;
+  brk_high_ = brk_start_;
+}
+
+void Syscalls::set_mmap_top(uint64_t addr) {
+  mmap_top_ = addr & ~uint64_t{0xFFF};
+  mmap_bottom_ = mmap_top_;
+  mmap_low_ = mmap_top_;
+}
+
+void Syscalls::copy_from(const Syscalls &other) {
+  brk_start_ = other.brk_start_;
+  brk_ = other.brk_;
+  mmap_top_ = other.mmap_top_;
+  mmap_bottom_ = other.mmap_bottom_;
+  brk_high_ = other.brk_high_;
+  mmap_low_ = other.mmap_low_;
+}
+
+void Syscalls::save(StateWriter &out) const {
+  out.put(brk_start_);
+  out.put(brk_);
+  out.put(mmap_top_);
+  out.put(mmap_bottom_);
+  out.put(brk_high_);
+  out.put(mmap_low_);
+}
+
+void Syscalls::restore(StateReader &in) {
+  in.get(brk_start_);
+  in.get(brk_);
+  in.get(mmap_top_);
+  in.get(mmap_bottom_);
+  in.get(brk_high_);
+  in.get(mmap_low_);
+}
+
+template <int XLEN> void Syscalls::handle(Hart<XLEN> *hart) {
+  uint64_t number = hart->gpr_[reg_a7];
+  uint64_t ret = 0;
+
+  switch (number) {
+  case sysno::exit:
+  case sysno::exit_group:
+    hart->exit_code_ = static_cast<int>(arg(hart, 0));
+    hart->halted_ = true;
+    return;
+  case sysno::read:
+    if (!wait_readable(hart, static_cast<int>(arg(hart, 0)))) {
+      hart->retry_syscall();
+      return;
+    }
+    ret = sys_read(hart);
+    break;
+  case sysno::write:
+    ret = sys_write(hart);
+    break;
+  case sysno::openat:
+    ret = sys_openat(hart);
+    break;
+  case sysno::close: {
+    int fd = static_cast<int>(arg(hart, 0));
+    // The guest must not close the simulator's own standard streams
+    ret = fd <= STDERR_FILENO ? 0 : result(::close(fd));
+    break;
+  }
+  case sysno::lseek:
+    ret = result(::lseek(static_cast<int>(arg(hart, 0)),
+                         static_cast<typename Hart<XLEN>::sregister_t>(
+                             arg(hart, 1)),
+                         static_cast<int>(arg(hart, 2))));
+    break;
+  case sysno::fstat:
+    ret = sys_fstat(hart);
+    break;
+  case sysno::brk:
+    ret = sys_brk(hart);
+    break;
+  case sysno::mmap:
+    ret = sys_mmap(hart);
+    break;
+  case sysno::munmap:
+    ret = sys_munmap(hart);
+    break;
+  case sysno::clock_gettime:
+    ret = sys_clock_gettime(hart);
+    break;
+  case sysno::gettimeofday:
+    ret = sys_gettimeofday(hart);
+    break;
+  default:
+    std::cerr << "Unsupported syscall " << std::dec << number << " at pc=0x"
+              << std::hex << hart->pc << std::dec << std::endl;
+    ret = error(ENOSYS);
+    break;
+  }
+
+  hart->gpr_[reg_a0] = static_cast<typename Hart<XLEN>::register_t>(ret);
+}
+
+template <int XLEN> uint64_t Syscalls::sys_read(Hart<XLEN> *hart) {
+  std::vector<iovec> iov;
+  if (!hart->mem_->host_iovec(arg(hart, 1), arg(hart, 2), ACCESS_WRITE, iov)) {
+    return error(EFAULT);
+  }
+  return result(::readv(static_cast<int>(arg(hart, 0)), iov.data(),
+                        static_cast<int>(iov.size())));
+}
+
+template <int XLEN> uint64_t Syscalls::sys_write(Hart<XLEN> *hart) {
+  std::vector<iovec> iov;
+  if (!hart->mem_->host_iovec(arg(hart, 1), arg(hart, 2), ACCESS_READ, iov)) {
+    return error(EFAULT);
+  }
+  return result(::writev(static_cast<int>(arg(hart, 0)), iov.data(),
+                         static_cast<int>(iov.size())));
+}
+
+template <int XLEN> uint64_t Syscalls::sys_openat(Hart<XLEN> *hart) {
+  std::string path;
+  if (!hart->mem_->read_string(arg(hart, 1), path)) {
+    return error(EFAULT);
+  }
+  return result(::openat(static_cast<int32_t>(arg(hart, 0)), path.c_str(),
+                         static_cast<int>(arg(hart, 2)),
+                         static_cast<mode_t>(arg(hart, 3))));
+}
+
+template <int XLEN> uint64_t Syscalls::sys_fstat(Hart<XLEN> *hart) {
+  struct stat host {};
+  if (::fstat(static_cast<int>(arg(hart, 0)), &host) < 0) {
+    return error(errno);
+  }
+
+  GuestStat guest{};
+  guest.st_dev = host.st_dev;
+  guest.st_ino = host.st_ino;
+  guest.st_mode = host.st_mode;
+  guest.st_nlink = static_cast<uint32_t>(host.st_nlink);
+  guest.st_uid = host.st_uid;
+  guest.st_gid = host.st_gid;
+  guest.st_rdev = host.st_rdev;
+  guest.st_size = host.st_size;
+  guest.st_blksize = static_cast<int32_t>(host.st_blksize);
+  guest.st_blocks = host.st_blocks;
+  guest.st_atime_sec = host.st_atim.tv_sec;
+  guest.st_atime_nsec = host.st_atim.tv_nsec;
+  guest.st_mtime_sec = host.st_mtim.tv_sec;
+  guest.st_mtime_nsec = host.st_mtim.tv_nsec;
+  guest.st_ctime_sec = host.st_ctim.tv_sec;
+  guest.st_ctime_nsec = host.st_ctim.tv_nsec;
+
+  return copy_to_guest(hart, arg(hart, 1), &guest, sizeof(guest))
+             ? 0
+             : error(EFAULT);
+}
+
+template <int XLEN> uint64_t Syscalls::sys_brk(Hart<XLEN> *hart) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t addr = arg(hart, 0);
+  if (addr >= brk_start_ && addr <= mmap_bottom_) {
+    // Space given back by a lower break must read as zero when it grows again
+    if (addr > brk_ && !zero_reused(hart, brk_, addr - brk_)) {
+      return brk_;
+    }
+    brk_ = addr;
+    brk_high_ = std::max(brk_high_, brk_);
+  }
+  return brk_;
+}
+
+template <int XLEN> uint64_t Syscalls::sys_mmap(Hart<XLEN> *hart) {
+  const uint64_t map_anonymous = 0x20;
+  uint64_t length = (uint64_t{arg(hart, 1)} + 0xFFF) & ~uint64_t{0xFFF};
+  uint64_t flags = arg(hart, 3);
+  int fd = static_cast<int32_t>(arg(hart, 4));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (length == 0 || length > mmap_bottom_ - brk_) {
+    return error(ENOMEM);
+  }
+  mmap_bottom_ -= length;
+
+  // The pages may have been mapped before, and a file mapping reads as zero
+  // past the end of the file
+  if (!zero_reused(hart, mmap_bottom_, length)) {
+    mmap_bottom_ += length;
+    return error(EFAULT);
+  }
+  mmap_low_ = std::min(mmap_low_, mmap_bottom_);
+  if (!(flags & map_anonymous) && fd >= 0) {
+    std::vector<iovec> iov;
+    if (!hart->mem_->host_iovec(mmap_bottom_, arg(hart, 1), ACCESS_WRITE,
+                                iov)) {
+      mmap_bottom_ += length;
+      return error(EFAULT);
+    }
+    if (::preadv(fd, iov.data(), static_cast<int>(iov.size()),
+                 arg(hart, 5)) < 0) {
+      mmap_bottom_ += length;
+      return error(errno);
+    }
+  }
+  return mmap_bottom_;
+}
+
+template <int XLEN> uint64_t Syscalls::sys_munmap(Hart<XLEN> *hart) {
+  uint64_t length = (uint64_t{arg(hart, 1)} + 0xFFF) & ~uint64_t{0xFFF};
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Only the most recent mapping can be given back; anything else is leaked
+  if (arg(hart, 0) == mmap_bottom_ && mmap_bottom_ + length <= mmap_top_) {
+    mmap_bottom_ += length;
+  }
+  return 0;
+}
+
+template <int XLEN> uint64_t Syscalls::sys_clock_gettime(Hart<XLEN> *hart) {
+  const uint64_t clock_realtime = 0;
+  auto now = arg(hart, 0) == clock_realtime
+                 ? std::chrono::system_clock::now().time_since_epoch()
+                 : std::chrono::steady_clock::now().time_since_epoch();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+
+  GuestTime ts{ns / 1000000000, ns % 1000000000};
+  return copy_to_guest(hart, arg(hart, 1), &ts, sizeof(ts)) ? 0
+                                                             : error(EFAULT);
+}
+
+template <int XLEN> uint64_t Syscalls::sys_gettimeofday(Hart<XLEN> *hart) {
+  if (arg(hart, 0) == 0) {
+    return 0;
+  }
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+
+  GuestTime tv{us / 1000000, us % 1000000};
+  return copy_to_guest(hart, arg(hart, 0), &tv, sizeof(tv)) ? 0
+                                                             : error(EFAULT);
+}
+
+template <int XLEN>
+bool Syscalls::copy_to_guest(Hart<XLEN> *hart, uint64_t addr, const void *data,
+                             std::size_t size) {
+  std::vector<iovec> iov;
+  if (!hart->mem_->host_iovec(addr, size, ACCESS_WRITE, iov)) {
+    return false;
+  }
+
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  for (const auto &chunk : iov) {
+    std::copy(src, src + chunk.iov_len, static_cast<uint8_t *>(chunk.iov_base));
+    src += chunk.iov_len;
+  }
+  return true;
+}
+
+template <int XLEN>
+bool Syscalls::zero_guest(Hart<XLEN> *hart, uint64_t addr, std::size_t size) {
+  std::vector<iovec> iov;
+  if (!hart->mem_->host_iovec(addr, size, ACCESS_WRITE, iov)) {
+    return false;
+  }
+  for (const auto &chunk : iov) {
+    std::memset(chunk.iov_base, 0, chunk.iov_len);
+  }
+  return true;
+}
+
+template <int XLEN>
+bool Syscalls::zero_reused(Hart<XLEN> *hart, uint64_t addr, uint64_t size) {
+  uint64_t end = addr + size;
+  uint64_t heap_end = std::min(end, brk_high_);
+  uint64_t mmap_start = std::max(addr, mmap_low_);
+  if (addr < heap_end && !zero_guest(hart, addr, heap_end - addr)) {
+    return false;
+  }
+  return mmap_start >= end || zero_guest(hart, mmap_start, end - mmap_start);
+}
+
+template void Syscalls::handle<32>(Hart<32> *hart);
+template void Syscalls::handle<64>(Hart<64> *hart);
+} // namespace sim
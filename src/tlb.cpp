@@ -0,0 +1,163 @@
+#include "tlb.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace sim {
+namespace {
+bool is_power_of_two(std::size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+const char *const policy_names[] = {"plru", "fifo", "random"};
+} // namespace
+
+TlbConfig TlbConfig::parse(const std::string &text) {
+  TlbConfig config;
+  char *end = nullptr;
+  config.entries = std::strtoul(text.c_str(), &end, 10);
+  config.ways = *end == ':' ? std::strtoul(end + 1, &end, 10) : 0;
+  if (*end == ':') {
+    std::string policy(end + 1);
+    std::size_t i = 0;
+    while (i < 3 && policy != policy_names[i]) {
+      ++i;
+    }
+    if (i == 3) {
+      throw std::invalid_argument("Unknown TLB replacement policy: " + policy);
+    }
+    config.policy = static_cast<TlbPolicy>(i);
+  }
+  return config;
+}
+
+std::string TlbConfig::name() const {
+  return std::to_string(entries) + ":" + std::to_string(ways) + ":" +
+         policy_names[static_cast<int>(policy)];
+}
+
+TLB::TLB(std::size_t entries, std::size_t ways, uint32_t level_bits)
+    : level_bits_(level_bits) {
+  configure(entries, ways);
+}
+
+void TLB::configure(std::size_t entries, std::size_t ways,
+                    TlbPolicy policy) {
+  if (!is_power_of_two(entries) || !is_power_of_two(ways) || ways > entries ||
+      ways > max_ways) {
+    throw std::invalid_argument("TLB size and associativity must be powers "
+                                "of two with ways <= min(entries, 64)");
+  }
+  sets_ = entries / ways;
+  ways_ = ways;
+  set_mask_ = static_cast<uint32_t>(sets_ - 1);
+  entries_.assign(entries, TLBEntry{});
+  plru_.assign(sets_, 0);
+  policy_ = policy;
+  max_level_ = 0;
+  hits_ = 0;
+  misses_ = 0;
+}
+
+// The PLRU tree of a set is stored heap-style in bits 1..ways-1; each node
+// bit points at the half that should be evicted next.
+void TLB::touch(std::size_t set, std::size_t way) {
+  if (policy_ != TlbPolicy::plru) {
+    return;
+  }
+  uint64_t &bits = plru_[set];
+  std::size_t node = 1;
+  for (std::size_t half = ways_ >> 1; half > 0; half >>= 1) {
+    bool right = (way & half) != 0;
+    if (right) {
+      bits &= ~(uint64_t{1} << node);
+    } else {
+      bits |= uint64_t{1} << node;
+    }
+    node = node * 2 + right;
+  }
+}
+
+std::size_t TLB::victim(std::size_t set) {
+  if (policy_ == TlbPolicy::fifo) {
+    return plru_[set]++ & (ways_ - 1);
+  }
+  if (policy_ == TlbPolicy::random) {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    return random_ & (ways_ - 1);
+  }
+  uint64_t bits = plru_[set];
+  std::size_t node = 1;
+  std::size_t way = 0;
+  for (std::size_t half = ways_ >> 1; half > 0; half >>= 1) {
+    bool right = (bits >> node) & 1;
+    if (right) {
+      way |= half;
+    }
+    node = node * 2 + right;
+  }
+  return way;
+}
+
+void TLB::insert(uint32_t vpn, uint32_t ppn, uint32_t flags, uint32_t asid,
+                 uint32_t level) {
+  uint32_t tag = vpn >> (level * level_bits_);
+  std::size_t set = tag & set_mask_;
+  TLBEntry *base = &entries_[set * ways_];
+
+  std::size_t way = ways_;
+  for (std::size_t i = 0; i < ways_; ++i) {
+    if (base[i].valid && base[i].virtual_page == tag &&
+        base[i].level == level && base[i].asid == asid) {
+      way = i;
+      break;
+    }
+    if (!base[i].valid && way == ways_) {
+      way = i;
+    }
+  }
+  if (way == ways_) {
+    way = victim(set);
+  }
+
+  base[way] = {true, tag, ppn, flags, asid, level};
+  touch(set, way);
+  if (level > max_level_) {
+    max_level_ = level;
+  }
+}
+
+void TLB::remove(uint32_t vpn, bool match_asid, uint32_t asid) {
+  for (uint32_t level = 0; level <= max_level_; ++level) {
+    uint32_t tag = vpn >> (level * level_bits_);
+    TLBEntry *base = &entries_[(tag & set_mask_) * ways_];
+    for (std::size_t way = 0; way < ways_; ++way) {
+      TLBEntry &entry = base[way];
+      if (entry.valid && entry.virtual_page == tag && entry.level == level &&
+          (!match_asid || (!(entry.flags & PTE_G) && entry.asid == asid))) {
+        entry.valid = false;
+      }
+    }
+  }
+}
+
+void TLB::remove_asid(uint32_t asid) {
+  for (auto &entry : entries_) {
+    if (entry.valid && !(entry.flags & PTE_G) && entry.asid == asid) {
+      entry.valid = false;
+    }
+  }
+}
+
+void TLB::clear() {
+  for (auto &entry : entries_) {
+    entry.valid = false;
+  }
+  for (auto &bits : plru_) {
+    bits = 0;
+  }
+  max_level_ = 0;
+}
+} // namespace sim
@@ -0,0 +1,713 @@
+#include "vector.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "generated_instructions.hpp"
+#include "hart.hpp"
+
+namespace sim {
+namespace {
+// Host and guest are both little-endian, so an element is its first sew
+// bytes
+uint64_t element(const uint8_t *base, std::size_t i, uint32_t sew) {
+  uint64_t value = 0;
+  std::memcpy(&value, base + i * sew, sew);
+  return value;
+}
+
+int64_t signed_element(const uint8_t *base, std::size_t i, uint32_t sew) {
+  unsigned shift = 64 - 8 * sew;
+  return static_cast<int64_t>(element(base, i, sew) << shift) >> shift;
+}
+
+void set_element(uint8_t *base, std::size_t i, uint32_t sew, uint64_t value) {
+  std::memcpy(base + i * sew, &value, sew);
+}
+
+bool bit(const uint8_t *mask, std::size_t i) {
+  return mask[i / 8] >> (i % 8) & 1;
+}
+
+void set_bit(uint8_t *mask, std::size_t i, bool value) {
+  uint8_t select = static_cast<uint8_t>(1 << (i % 8));
+  mask[i / 8] = value ? mask[i / 8] | select : mask[i / 8] & ~select;
+}
+
+uint8_t mask_op(uint32_t funct6, uint8_t a, uint8_t b) {
+  switch (funct6) {
+  case 0x18: // vmandn
+    return a & ~b;
+  case 0x19: // vmand
+    return a & b;
+  case 0x1A: // vmor
+    return a | b;
+  case 0x1B: // vmxor
+    return a ^ b;
+  case 0x1C: // vmorn
+    return a | ~b;
+  case 0x1D: // vmnand
+    return ~(a & b);
+  case 0x1E: // vmnor
+    return ~(a | b);
+  default: // vmxnor
+    return ~(a ^ b);
+  }
+}
+} // namespace
+
+void VectorUnit::save_mask() {
+  std::copy_n(vreg_.begin(), vlenb, mask_.begin());
+}
+
+void VectorUnit::save(StateWriter &out) const {
+  out.put(vreg_);
+  out.put(vl_);
+  out.put(vtype_);
+  out.put(vill_);
+  out.put(sew_);
+  out.put(vstart_);
+}
+
+void VectorUnit::restore(StateReader &in) {
+  in.get(vreg_);
+  in.get(vl_);
+  in.get(vtype_);
+  in.get(vill_);
+  in.get(sew_);
+  in.get(vstart_);
+}
+
+uint64_t VectorUnit::set_vtype(uint64_t vtype, uint64_t avl) {
+  uint32_t vlmul = vtype & 0x7;
+  uint32_t vsew = (vtype >> 3) & 0x7;
+  // LMUL as a power of two, negative when fractional
+  int lmul_log2 = vlmul < 4 ? static_cast<int>(vlmul)
+                            : static_cast<int>(vlmul) - 8;
+  uint32_t sew = 1u << vsew;
+  // Fractional LMUL needs SEW <= LMUL * ELEN, where ELEN is 64
+  vill_ = (vtype >> 8) != 0 || vlmul == 4 || vsew > 3 ||
+          (lmul_log2 < 0 && 8 * sew > (64u >> -lmul_log2));
+  if (vill_) {
+    vtype_ = 0;
+    vl_ = 0;
+    return 0;
+  }
+
+  vtype_ = vtype;
+  sew_ = sew;
+  uint64_t vlmax = lmul_log2 >= 0 ? (uint64_t{vlenb} << lmul_log2) / sew
+                                  : (uint64_t{vlenb} >> -lmul_log2) / sew;
+  vl_ = std::min(avl, vlmax);
+  return vl_;
+}
+
+const uint8_t *VectorUnit::splat(uint64_t value) {
+  for (std::size_t i = 0; i < vl_; ++i) {
+    set_element(operand_.data(), i, sew_, value);
+  }
+  return operand_.data();
+}
+
+bool VectorUnit::implemented(uint32_t funct3, uint32_t funct6) {
+  switch (funct3) {
+  case OPIVV:
+  case OPIVX:
+  case OPIVI:
+    switch (funct6) {
+    case 0x00: // vadd
+    case 0x09: // vand
+    case 0x0A: // vor
+    case 0x0B: // vxor
+    case 0x17: // vmerge, vmv.v
+    case 0x18: // vmseq
+    case 0x19: // vmsne
+    case 0x1C: // vmsleu
+    case 0x1D: // vmsle
+    case 0x25: // vsll
+    case 0x28: // vsrl
+    case 0x29: // vsra
+      return true;
+    case 0x02: // vsub
+    case 0x04: // vminu
+    case 0x05: // vmin
+    case 0x06: // vmaxu
+    case 0x07: // vmax
+    case 0x1A: // vmsltu
+    case 0x1B: // vmslt
+      return funct3 != OPIVI;
+    case 0x03: // vrsub
+    case 0x1E: // vmsgtu
+    case 0x1F: // vmsgt
+      return funct3 != OPIVV;
+    default:
+      return false;
+    }
+  case OPMVV:
+    // Reductions, vmv.x.s/vcpop/vfirst, vid, mask logic and vmul
+    return funct6 <= 0x07 || funct6 == 0x10 || funct6 == 0x14 ||
+           (funct6 >= 0x18 && funct6 <= 0x1F) || funct6 == 0x25;
+  case OPMVX:
+    // vmv.s.x and vmul
+    return funct6 == 0x10 || funct6 == 0x25;
+  default:
+    return false;
+  }
+}
+
+bool VectorUnit::unsigned_immediate(uint32_t funct6) {
+  return funct6 == 0x25 || funct6 == 0x28 || funct6 == 0x29;
+}
+
+bool VectorUnit::opi(uint32_t funct6, uint8_t vd, uint8_t vs2,
+                     const uint8_t *operand, bool masked) {
+  if (vill_ || !operand || !fits(vs2, vl_ * sew_)) {
+    return false;
+  }
+  if (funct6 >= 0x18 && funct6 <= 0x1F) {
+    return compare(funct6, vd, vs2, operand, masked);
+  }
+  if (funct6 == 0x17) {
+    return merge(vd, vs2, operand, masked);
+  }
+
+  const uint8_t *a = reg(vs2);
+  const uint8_t *b = operand;
+  VectorOp op;
+  switch (funct6) {
+  case 0x00:
+    op = VectorOp::add;
+    break;
+  case 0x02:
+    op = VectorOp::sub;
+    break;
+  case 0x03:
+    op = VectorOp::sub;
+    std::swap(a, b);
+    break;
+  case 0x04:
+    op = VectorOp::minu;
+    break;
+  case 0x05:
+    op = VectorOp::min;
+    break;
+  case 0x06:
+    op = VectorOp::maxu;
+    break;
+  case 0x07:
+    op = VectorOp::max;
+    break;
+  case 0x09:
+    op = VectorOp::and_;
+    break;
+  case 0x0A:
+    op = VectorOp::or_;
+    break;
+  case 0x0B:
+    op = VectorOp::xor_;
+    break;
+  case 0x25:
+    op = VectorOp::sll;
+    break;
+  case 0x28:
+    op = VectorOp::srl;
+    break;
+  case 0x29:
+    op = VectorOp::sra;
+    break;
+  default:
+    return false;
+  }
+  return elementwise(op, vd, a, b, masked);
+}
+
+bool VectorUnit::opm(uint32_t funct6, uint8_t vd, uint8_t vs2, uint8_t vs1,
+                     const uint8_t *operand, bool masked) {
+  if (vill_ || !fits(vs2, vl_ * sew_)) {
+    return false;
+  }
+  if (funct6 <= 0x07) {
+    return reduce(funct6, vd, vs2, vs1, masked);
+  }
+  if (funct6 >= 0x18 && funct6 <= 0x1F) {
+    return mask_logical(funct6, vd, vs2, vs1, masked);
+  }
+  if (funct6 == 0x14) {
+    return id(vd, masked);
+  }
+  if (funct6 == 0x25 && operand) {
+    return elementwise(VectorOp::mul, vd, reg(vs2), operand, masked);
+  }
+  return false;
+}
+
+bool VectorUnit::elementwise(VectorOp op, uint8_t vd, const uint8_t *a,
+                             const uint8_t *b, bool masked) {
+  // A masked instruction may not overwrite its own mask
+  if (!fits(vd, vl_ * sew_) || (masked && vd == 0)) {
+    return false;
+  }
+  VectorKernel kernel = kernels_->get(op, sew_);
+  if (!masked) {
+    kernel(reg(vd), a, b, vl_);
+    return true;
+  }
+
+  save_mask();
+  kernel(result_.data(), a, b, vl_);
+  uint8_t *dst = reg(vd);
+  for (std::size_t i = 0; i < vl_; ++i) {
+    if (active(i)) {
+      std::memcpy(dst + i * sew_, result_.data() + i * sew_, sew_);
+    }
+  }
+  return true;
+}
+
+bool VectorUnit::compare(uint32_t funct6, uint8_t vd, uint8_t vs2,
+                         const uint8_t *operand, bool masked) {
+  if (masked) {
+    save_mask();
+  }
+  // Element i is read before mask bit i is written, so vd may be vs2
+  const uint8_t *a = reg(vs2);
+  uint8_t *dst = reg(vd);
+  for (std::size_t i = 0; i < vl_; ++i) {
+    if (masked && !active(i)) {
+      continue;
+    }
+    uint64_t x = element(a, i, sew_);
+    uint64_t y = element(operand, i, sew_);
+    int64_t sx = signed_element(a, i, sew_);
+    int64_t sy = signed_element(operand, i, sew_);
+    bool result;
+    switch (funct6) {
+    case 0x18:
+      result = x == y;
+      break;
+    case 0x19:
+      result = x != y;
+      break;
+    case 0x1A:
+      result = x < y;
+      break;
+    case 0x1B:
+      result = sx < sy;
+      break;
+    case 0x1C:
+      result = x <= y;
+      break;
+    case 0x1D:
+      result = sx <= sy;
+      break;
+    case 0x1E:
+      result = x > y;
+      break;
+    default:
+      result = sx > sy;
+      break;
+    }
+    set_bit(dst, i, result);
+  }
+  return true;
+}
+
+bool VectorUnit::merge(uint8_t vd, uint8_t vs2, const uint8_t *operand,
+                       bool masked) {
+  std::size_t bytes = vl_ * sew_;
+  if (!fits(vd, bytes)) {
+    return false;
+  }
+  if (!masked) { // vmv.v.v, vmv.v.x, vmv.v.i
+    std::memmove(reg(vd), operand, bytes);
+    return true;
+  }
+
+  save_mask();
+  const uint8_t *a = reg(vs2);
+  for (std::size_t i = 0; i < vl_; ++i) {
+    const uint8_t *src = active(i) ? operand : a;
+    std::memcpy(result_.data() + i * sew_, src + i * sew_, sew_);
+  }
+  std::memcpy(reg(vd), result_.data(), bytes);
+  return true;
+}
+
+bool VectorUnit::reduce(uint32_t funct6, uint8_t vd, uint8_t vs2,
+                        uint8_t vs1, bool masked) {
+  if (vl_ == 0) {
+    return true;
+  }
+  if (masked) {
+    save_mask();
+  }
+  const uint8_t *a = reg(vs2);
+  bool is_signed = funct6 == 0x05 || funct6 == 0x07;
+  uint64_t acc = is_signed ? signed_element(reg(vs1), 0, sew_)
+                           : element(reg(vs1), 0, sew_);
+  for (std::size_t i = 0; i < vl_; ++i) {
+    if (masked && !active(i)) {
+      continue;
+    }
+    uint64_t x = is_signed ? signed_element(a, i, sew_) : element(a, i, sew_);
+    switch (funct6) {
+    case 0x00: // vredsum
+      acc += x;
+      break;
+    case 0x01: // vredand
+      acc &= x;
+      break;
+    case 0x02: // vredor
+      acc |= x;
+      break;
+    case 0x03: // vredxor
+      acc ^= x;
+      break;
+    case 0x04: // vredminu
+      acc = std::min(acc, x);
+      break;
+    case 0x05: // vredmin
+      acc = static_cast<int64_t>(x) < static_cast<int64_t>(acc) ? x : acc;
+      break;
+    case 0x06: // vredmaxu
+      acc = std::max(acc, x);
+      break;
+    default: // vredmax
+      acc = static_cast<int64_t>(x) > static_cast<int64_t>(acc) ? x : acc;
+      break;
+    }
+  }
+  set_element(reg(vd), 0, sew_, acc);
+  return true;
+}
+
+bool VectorUnit::mask_logical(uint32_t funct6, uint8_t vd, uint8_t vs2,
+                              uint8_t vs1, bool masked) {
+  if (masked) {
+    return false;
+  }
+  const uint8_t *a = reg(vs2);
+  const uint8_t *b = reg(vs1);
+  uint8_t *dst = reg(vd);
+  // Whole bytes at once, then the bits of a partial last byte
+  std::size_t bytes = vl_ / 8;
+  for (std::size_t i = 0; i < bytes; ++i) {
+    dst[i] = mask_op(funct6, a[i], b[i]);
+  }
+  for (std::size_t i = bytes * 8; i < vl_; ++i) {
+    set_bit(dst, i, mask_op(funct6, bit(a, i), bit(b, i)) & 1);
+  }
+  return true;
+}
+
+bool VectorUnit::id(uint8_t vd, bool masked) {
+  if (!fits(vd, vl_ * sew_) || (masked && vd == 0)) {
+    return false;
+  }
+  if (masked) {
+    save_mask();
+  }
+  for (std::size_t i = 0; i < vl_; ++i) {
+    if (!masked || active(i)) {
+      set_element(reg(vd), i, sew_, i);
+    }
+  }
+  return true;
+}
+
+int64_t VectorUnit::scalar(uint8_t vs2) const {
+  return signed_element(vreg_.data() + vs2 * vlenb, 0, sew_);
+}
+
+void VectorUnit::set_scalar(uint8_t vd, uint64_t value) {
+  if (vl_ > 0) {
+    set_element(reg(vd), 0, sew_, value);
+  }
+}
+
+uint64_t VectorUnit::cpop(uint8_t vs2, bool masked) {
+  if (masked) {
+    save_mask();
+  }
+  uint64_t count = 0;
+  for (std::size_t i = 0; i < vl_; ++i) {
+    count += bit(reg(vs2), i) && (!masked || active(i));
+  }
+  return count;
+}
+
+int64_t VectorUnit::first(uint8_t vs2, bool masked) {
+  if (masked) {
+    save_mask();
+  }
+  for (std::size_t i = 0; i < vl_; ++i) {
+    if (bit(reg(vs2), i) && (!masked || active(i))) {
+      return static_cast<int64_t>(i);
+    }
+  }
+  return -1;
+}
+
+// VSETVLI instruction
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vsetvli(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t rd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  register_t vtype = (instr >> 20) & 0x7FF;
+
+  // x0 as rs1 asks for VLMAX, or keeps vl when rd is x0 too
+  VectorUnit &vpu = hart->vpu_;
+  uint64_t avl = rs1 != 0   ? hart->gpr_[rs1]
+                 : rd != 0 ? ~uint64_t{0}
+                           : vpu.vl();
+  register_t result = static_cast<register_t>(vpu.set_vtype(vtype, avl));
+  if (rd != 0)
+    hart->gpr_[rd] = result;
+}
+
+// VSETIVLI instruction
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vsetivli(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t rd = (instr >> 7) & 0x1F;
+  uint8_t uimm = (instr >> 15) & 0x1F;
+  register_t vtype = (instr >> 20) & 0x3FF;
+
+  register_t result =
+      static_cast<register_t>(hart->vpu_.set_vtype(vtype, uimm));
+  if (rd != 0)
+    hart->gpr_[rd] = result;
+}
+
+// VSETVL instruction
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vsetvl(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t rd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint8_t rs2 = (instr >> 20) & 0x1F;
+
+  VectorUnit &vpu = hart->vpu_;
+  uint64_t avl = rs1 != 0   ? hart->gpr_[rs1]
+                 : rd != 0 ? ~uint64_t{0}
+                           : vpu.vl();
+  register_t result =
+      static_cast<register_t>(vpu.set_vtype(hart->gpr_[rs2], avl));
+  if (rd != 0)
+    hart->gpr_[rd] = result;
+}
+
+// VLE8.V, VLE16.V, VLE32.V and VLE64.V instructions
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vle(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint32_t eew = vector_eew((instr >> 12) & 0x7);
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  std::size_t bytes = vpu.vl() * eew;
+  if (vpu.vill() || !vpu.fits(vd, bytes) || (masked && vd == 0)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+    return;
+  }
+  register_t rs1_val = hart->gpr_[rs1];
+  if (!masked) {
+    // Straight into the register group, a page at a time
+    hart->mem_->read_block(rs1_val, vpu.reg(vd), bytes);
+    return;
+  }
+  for (std::size_t i = 0; i < vpu.vl(); ++i) {
+    if (vpu.mask_bit(i) &&
+        !hart->mem_->read_block(rs1_val + i * eew, vpu.reg(vd) + i * eew,
+                                eew)) {
+      return;
+    }
+  }
+}
+
+// VSE8.V, VSE16.V, VSE32.V and VSE64.V instructions
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vse(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vs3 = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint32_t eew = vector_eew((instr >> 12) & 0x7);
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  std::size_t bytes = vpu.vl() * eew;
+  if (vpu.vill() || !vpu.fits(vs3, bytes)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+    return;
+  }
+  register_t rs1_val = hart->gpr_[rs1];
+  if (!masked) {
+    hart->mem_->write_block(vpu.reg(vs3), rs1_val, bytes);
+    return;
+  }
+  for (std::size_t i = 0; i < vpu.vl(); ++i) {
+    if (vpu.mask_bit(i) &&
+        !hart->mem_->write_block(vpu.reg(vs3) + i * eew, rs1_val + i * eew,
+                                 eew)) {
+      return;
+    }
+  }
+}
+
+// VLSE8.V, VLSE16.V, VLSE32.V and VLSE64.V instructions
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vlse(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint8_t rs2 = (instr >> 20) & 0x1F;
+  uint32_t eew = vector_eew((instr >> 12) & 0x7);
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  if (vpu.vill() || !vpu.fits(vd, vpu.vl() * eew) || (masked && vd == 0)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+    return;
+  }
+  register_t rs1_val = hart->gpr_[rs1];
+  register_t stride = hart->gpr_[rs2];
+  for (std::size_t i = 0; i < vpu.vl(); ++i) {
+    if ((!masked || vpu.mask_bit(i)) &&
+        !hart->mem_->read_block(rs1_val + i * stride, vpu.reg(vd) + i * eew,
+                                eew)) {
+      return;
+    }
+  }
+}
+
+// VSSE8.V, VSSE16.V, VSSE32.V and VSSE64.V instructions
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_vsse(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vs3 = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint8_t rs2 = (instr >> 20) & 0x1F;
+  uint32_t eew = vector_eew((instr >> 12) & 0x7);
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  if (vpu.vill() || !vpu.fits(vs3, vpu.vl() * eew)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+    return;
+  }
+  register_t rs1_val = hart->gpr_[rs1];
+  register_t stride = hart->gpr_[rs2];
+  for (std::size_t i = 0; i < vpu.vl(); ++i) {
+    if ((!masked || vpu.mask_bit(i)) &&
+        !hart->mem_->write_block(vpu.reg(vs3) + i * eew,
+                                 rs1_val + i * stride, eew)) {
+      return;
+    }
+  }
+}
+
+// OPIVV instructions: vadd.vv, vsub.vv, vand.vv, vmseq.vv, ...
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_opivv(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint8_t vs1 = (instr >> 15) & 0x1F;
+  uint8_t vs2 = (instr >> 20) & 0x1F;
+  uint32_t funct6 = instr >> 26;
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  if (!vpu.opi(funct6, vd, vs2, vpu.source(vs1), masked)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+  }
+}
+
+// OPIVX instructions: vadd.vx, vrsub.vx, vmslt.vx, ...
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_opivx(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint8_t vs2 = (instr >> 20) & 0x1F;
+  uint32_t funct6 = instr >> 26;
+  bool masked = !((instr >> 25) & 1);
+
+  // Scalars are sign-extended to SEW, which matters for RV32 with SEW=64
+  VectorUnit &vpu = hart->vpu_;
+  int64_t rs1_val = static_cast<sregister_t>(hart->gpr_[rs1]);
+  if (!vpu.opi(funct6, vd, vs2, vpu.splat(rs1_val), masked)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+  }
+}
+
+// OPIVI instructions: vadd.vi, vsll.vi, vmseq.vi, ...
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_opivi(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint32_t uimm = (instr >> 15) & 0x1F;
+  uint8_t vs2 = (instr >> 20) & 0x1F;
+  uint32_t funct6 = instr >> 26;
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  int64_t imm = static_cast<int32_t>(uimm << 27) >> 27;
+  if (VectorUnit::unsigned_immediate(funct6))
+    imm = uimm;
+  if (!vpu.opi(funct6, vd, vs2, vpu.splat(imm), masked)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+  }
+}
+
+// OPMVV instructions: reductions, mask logic, vmul.vv, vmv.x.s, vcpop.m,
+// vfirst.m and vid.v
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_opmvv(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t rd = (instr >> 7) & 0x1F;
+  uint8_t vs1 = (instr >> 15) & 0x1F;
+  uint8_t vs2 = (instr >> 20) & 0x1F;
+  uint32_t funct6 = instr >> 26;
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  if (funct6 == 0x10) {
+    // VWXUNARY0 writes a scalar register
+    if (vpu.vill()) {
+      Instructions<XLEN>::exec_ill(hart, instr);
+      return;
+    }
+    register_t result =
+        vs1 == 0x00   ? static_cast<register_t>(vpu.scalar(vs2))
+        : vs1 == 0x10 ? static_cast<register_t>(vpu.cpop(vs2, masked))
+                      : static_cast<register_t>(vpu.first(vs2, masked));
+    if (rd != 0)
+      hart->gpr_[rd] = result;
+    return;
+  }
+  if (!vpu.opm(funct6, rd, vs2, vs1, vpu.source(vs1), masked)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+  }
+}
+
+// OPMVX instructions: vmul.vx and vmv.s.x
+template <int XLEN>
+void VectorInstructions<XLEN>::exec_opmvx(Hart<XLEN> *hart, uint32_t instr) {
+  uint8_t vd = (instr >> 7) & 0x1F;
+  uint8_t rs1 = (instr >> 15) & 0x1F;
+  uint8_t vs2 = (instr >> 20) & 0x1F;
+  uint32_t funct6 = instr >> 26;
+  bool masked = !((instr >> 25) & 1);
+
+  VectorUnit &vpu = hart->vpu_;
+  int64_t rs1_val = static_cast<sregister_t>(hart->gpr_[rs1]);
+  if (funct6 == 0x10) {
+    // vmv.s.x
+    if (vpu.vill()) {
+      Instructions<XLEN>::exec_ill(hart, instr);
+      return;
+    }
+    vpu.set_scalar(vd, rs1_val);
+    return;
+  }
+  if (!vpu.opm(funct6, vd, vs2, 0, vpu.splat(rs1_val), masked)) {
+    Instructions<XLEN>::exec_ill(hart, instr);
+  }
+}
+
+template struct VectorInstructions<32>;
+template struct VectorInstructions<64>;
+} // namespace sim
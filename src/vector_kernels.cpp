@@ -0,0 +1,289 @@
+#include "vector_kernels.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIM_X86_KERNELS 1
+#endif
+
+namespace sim {
+namespace {
+template <typename T> T load(const uint8_t *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+template <typename T> void store(uint8_t *p, T value) {
+  std::memcpy(p, &value, sizeof(value));
+}
+
+// Plain loops, which also finish the elements left over by the SIMD kernels
+template <typename T, VectorOp Op>
+void generic(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+             std::size_t n) {
+  using S = std::make_signed_t<T>;
+  // Narrow elements are computed in unsigned int so products do not overflow
+  using U = std::conditional_t<(sizeof(T) < sizeof(unsigned)), unsigned, T>;
+  constexpr unsigned shift_mask = sizeof(T) * 8 - 1;
+  for (std::size_t i = 0; i < n; ++i) {
+    U x = load<T>(a + i * sizeof(T));
+    U y = load<T>(b + i * sizeof(T));
+    U result;
+    if constexpr (Op == VectorOp::add) {
+      result = x + y;
+    } else if constexpr (Op == VectorOp::sub) {
+      result = x - y;
+    } else if constexpr (Op == VectorOp::and_) {
+      result = x & y;
+    } else if constexpr (Op == VectorOp::or_) {
+      result = x | y;
+    } else if constexpr (Op == VectorOp::xor_) {
+      result = x ^ y;
+    } else if constexpr (Op == VectorOp::mul) {
+      result = x * y;
+    } else if constexpr (Op == VectorOp::minu) {
+      result = x < y ? x : y;
+    } else if constexpr (Op == VectorOp::min) {
+      result = static_cast<S>(x) < static_cast<S>(y) ? x : y;
+    } else if constexpr (Op == VectorOp::maxu) {
+      result = x > y ? x : y;
+    } else if constexpr (Op == VectorOp::max) {
+      result = static_cast<S>(x) > static_cast<S>(y) ? x : y;
+    } else if constexpr (Op == VectorOp::sll) {
+      result = x << (y & shift_mask);
+    } else if constexpr (Op == VectorOp::srl) {
+      result = x >> (y & shift_mask);
+    } else {
+      result = static_cast<T>(static_cast<S>(x) >> (y & shift_mask));
+    }
+    store<T>(dst + i * sizeof(T), static_cast<T>(result));
+  }
+}
+
+void set(VectorKernels &kernels, VectorOp op, uint32_t sew,
+         VectorKernel kernel) {
+  kernels.op[static_cast<std::size_t>(op)][VectorKernels::sew_index(sew)] =
+      kernel;
+}
+
+template <typename T> void use_generic(VectorKernels &kernels) {
+  constexpr uint32_t sew = sizeof(T);
+  set(kernels, VectorOp::add, sew, generic<T, VectorOp::add>);
+  set(kernels, VectorOp::sub, sew, generic<T, VectorOp::sub>);
+  set(kernels, VectorOp::and_, sew, generic<T, VectorOp::and_>);
+  set(kernels, VectorOp::or_, sew, generic<T, VectorOp::or_>);
+  set(kernels, VectorOp::xor_, sew, generic<T, VectorOp::xor_>);
+  set(kernels, VectorOp::mul, sew, generic<T, VectorOp::mul>);
+  set(kernels, VectorOp::minu, sew, generic<T, VectorOp::minu>);
+  set(kernels, VectorOp::min, sew, generic<T, VectorOp::min>);
+  set(kernels, VectorOp::maxu, sew, generic<T, VectorOp::maxu>);
+  set(kernels, VectorOp::max, sew, generic<T, VectorOp::max>);
+  set(kernels, VectorOp::sll, sew, generic<T, VectorOp::sll>);
+  set(kernels, VectorOp::srl, sew, generic<T, VectorOp::srl>);
+  set(kernels, VectorOp::sra, sew, generic<T, VectorOp::sra>);
+}
+
+#if SIM_X86_KERNELS
+// Defines a kernel that runs a whole host register of elements per step. The
+// functions are compiled for the given ISA only, and are only installed when
+// the CPU reports it.
+#define SIM_SIMD_KERNEL(isa, vec, width, vload, vstore, name, T, op, expr)   \
+  __attribute__((target(isa))) void name(uint8_t *dst, const uint8_t *a,     \
+                                         const uint8_t *b, std::size_t n) {  \
+    std::size_t bytes = n * sizeof(T);                                       \
+    std::size_t i = 0;                                                       \
+    for (; i + width <= bytes; i += width) {                                 \
+      vec x = vload(reinterpret_cast<const vec *>(a + i));                   \
+      vec y = vload(reinterpret_cast<const vec *>(b + i));                   \
+      vstore(reinterpret_cast<vec *>(dst + i), expr);                        \
+    }                                                                        \
+    generic<T, VectorOp::op>(dst + i, a + i, b + i, (bytes - i) / sizeof(T)); \
+  }
+
+#define SIM_SSE2_KERNEL(name, T, op, expr)                                   \
+  SIM_SIMD_KERNEL("sse2", __m128i, 16, _mm_loadu_si128, _mm_storeu_si128,    \
+                  name, T, op, expr)
+
+#define SIM_AVX2_KERNEL(name, T, op, expr)                                   \
+  SIM_SIMD_KERNEL("avx2", __m256i, 32, _mm256_loadu_si256,                   \
+                  _mm256_storeu_si256, name, T, op, expr)
+
+SIM_SSE2_KERNEL(sse2_add8, uint8_t, add, _mm_add_epi8(x, y))
+SIM_SSE2_KERNEL(sse2_add16, uint16_t, add, _mm_add_epi16(x, y))
+SIM_SSE2_KERNEL(sse2_add32, uint32_t, add, _mm_add_epi32(x, y))
+SIM_SSE2_KERNEL(sse2_add64, uint64_t, add, _mm_add_epi64(x, y))
+SIM_SSE2_KERNEL(sse2_sub8, uint8_t, sub, _mm_sub_epi8(x, y))
+SIM_SSE2_KERNEL(sse2_sub16, uint16_t, sub, _mm_sub_epi16(x, y))
+SIM_SSE2_KERNEL(sse2_sub32, uint32_t, sub, _mm_sub_epi32(x, y))
+SIM_SSE2_KERNEL(sse2_sub64, uint64_t, sub, _mm_sub_epi64(x, y))
+SIM_SSE2_KERNEL(sse2_and8, uint8_t, and_, _mm_and_si128(x, y))
+SIM_SSE2_KERNEL(sse2_and16, uint16_t, and_, _mm_and_si128(x, y))
+SIM_SSE2_KERNEL(sse2_and32, uint32_t, and_, _mm_and_si128(x, y))
+SIM_SSE2_KERNEL(sse2_and64, uint64_t, and_, _mm_and_si128(x, y))
+SIM_SSE2_KERNEL(sse2_or8, uint8_t, or_, _mm_or_si128(x, y))
+SIM_SSE2_KERNEL(sse2_or16, uint16_t, or_, _mm_or_si128(x, y))
+SIM_SSE2_KERNEL(sse2_or32, uint32_t, or_, _mm_or_si128(x, y))
+SIM_SSE2_KERNEL(sse2_or64, uint64_t, or_, _mm_or_si128(x, y))
+SIM_SSE2_KERNEL(sse2_xor8, uint8_t, xor_, _mm_xor_si128(x, y))
+SIM_SSE2_KERNEL(sse2_xor16, uint16_t, xor_, _mm_xor_si128(x, y))
+SIM_SSE2_KERNEL(sse2_xor32, uint32_t, xor_, _mm_xor_si128(x, y))
+SIM_SSE2_KERNEL(sse2_xor64, uint64_t, xor_, _mm_xor_si128(x, y))
+SIM_SSE2_KERNEL(sse2_mul16, uint16_t, mul, _mm_mullo_epi16(x, y))
+SIM_SSE2_KERNEL(sse2_minu8, uint8_t, minu, _mm_min_epu8(x, y))
+SIM_SSE2_KERNEL(sse2_maxu8, uint8_t, maxu, _mm_max_epu8(x, y))
+SIM_SSE2_KERNEL(sse2_min16, uint16_t, min, _mm_min_epi16(x, y))
+SIM_SSE2_KERNEL(sse2_max16, uint16_t, max, _mm_max_epi16(x, y))
+
+SIM_AVX2_KERNEL(avx2_add8, uint8_t, add, _mm256_add_epi8(x, y))
+SIM_AVX2_KERNEL(avx2_add16, uint16_t, add, _mm256_add_epi16(x, y))
+SIM_AVX2_KERNEL(avx2_add32, uint32_t, add, _mm256_add_epi32(x, y))
+SIM_AVX2_KERNEL(avx2_add64, uint64_t, add, _mm256_add_epi64(x, y))
+SIM_AVX2_KERNEL(avx2_sub8, uint8_t, sub, _mm256_sub_epi8(x, y))
+SIM_AVX2_KERNEL(avx2_sub16, uint16_t, sub, _mm256_sub_epi16(x, y))
+SIM_AVX2_KERNEL(avx2_sub32, uint32_t, sub, _mm256_sub_epi32(x, y))
+SIM_AVX2_KERNEL(avx2_sub64, uint64_t, sub, _mm256_sub_epi64(x, y))
+SIM_AVX2_KERNEL(avx2_and8, uint8_t, and_, _mm256_and_si256(x, y))
+SIM_AVX2_KERNEL(avx2_and16, uint16_t, and_, _mm256_and_si256(x, y))
+SIM_AVX2_KERNEL(avx2_and32, uint32_t, and_, _mm256_and_si256(x, y))
+SIM_AVX2_KERNEL(avx2_and64, uint64_t, and_, _mm256_and_si256(x, y))
+SIM_AVX2_KERNEL(avx2_or8, uint8_t, or_, _mm256_or_si256(x, y))
+SIM_AVX2_KERNEL(avx2_or16, uint16_t, or_, _mm256_or_si256(x, y))
+SIM_AVX2_KERNEL(avx2_or32, uint32_t, or_, _mm256_or_si256(x, y))
+SIM_AVX2_KERNEL(avx2_or64, uint64_t, or_, _mm256_or_si256(x, y))
+SIM_AVX2_KERNEL(avx2_xor8, uint8_t, xor_, _mm256_xor_si256(x, y))
+SIM_AVX2_KERNEL(avx2_xor16, uint16_t, xor_, _mm256_xor_si256(x, y))
+SIM_AVX2_KERNEL(avx2_xor32, uint32_t, xor_, _mm256_xor_si256(x, y))
+SIM_AVX2_KERNEL(avx2_xor64, uint64_t, xor_, _mm256_xor_si256(x, y))
+SIM_AVX2_KERNEL(avx2_mul16, uint16_t, mul, _mm256_mullo_epi16(x, y))
+SIM_AVX2_KERNEL(avx2_mul32, uint32_t, mul, _mm256_mullo_epi32(x, y))
+SIM_AVX2_KERNEL(avx2_minu8, uint8_t, minu, _mm256_min_epu8(x, y))
+SIM_AVX2_KERNEL(avx2_minu16, uint16_t, minu, _mm256_min_epu16(x, y))
+SIM_AVX2_KERNEL(avx2_minu32, uint32_t, minu, _mm256_min_epu32(x, y))
+SIM_AVX2_KERNEL(avx2_min8, uint8_t, min, _mm256_min_epi8(x, y))
+SIM_AVX2_KERNEL(avx2_min16, uint16_t, min, _mm256_min_epi16(x, y))
+SIM_AVX2_KERNEL(avx2_min32, uint32_t, min, _mm256_min_epi32(x, y))
+SIM_AVX2_KERNEL(avx2_maxu8, uint8_t, maxu, _mm256_max_epu8(x, y))
+SIM_AVX2_KERNEL(avx2_maxu16, uint16_t, maxu, _mm256_max_epu16(x, y))
+SIM_AVX2_KERNEL(avx2_maxu32, uint32_t, maxu, _mm256_max_epu32(x, y))
+SIM_AVX2_KERNEL(avx2_max8, uint8_t, max, _mm256_max_epi8(x, y))
+SIM_AVX2_KERNEL(avx2_max16, uint16_t, max, _mm256_max_epi16(x, y))
+SIM_AVX2_KERNEL(avx2_max32, uint32_t, max, _mm256_max_epi32(x, y))
+SIM_AVX2_KERNEL(avx2_sll32, uint32_t, sll,
+                _mm256_sllv_epi32(x, _mm256_and_si256(
+                                         y, _mm256_set1_epi32(31))))
+SIM_AVX2_KERNEL(avx2_sll64, uint64_t, sll,
+                _mm256_sllv_epi64(x, _mm256_and_si256(
+                                         y, _mm256_set1_epi64x(63))))
+SIM_AVX2_KERNEL(avx2_srl32, uint32_t, srl,
+                _mm256_srlv_epi32(x, _mm256_and_si256(
+                                         y, _mm256_set1_epi32(31))))
+SIM_AVX2_KERNEL(avx2_srl64, uint64_t, srl,
+                _mm256_srlv_epi64(x, _mm256_and_si256(
+                                         y, _mm256_set1_epi64x(63))))
+SIM_AVX2_KERNEL(avx2_sra32, uint32_t, sra,
+                _mm256_srav_epi32(x, _mm256_and_si256(
+                                         y, _mm256_set1_epi32(31))))
+
+void use_sse2(VectorKernels &kernels) {
+  kernels.isa = "sse2";
+  set(kernels, VectorOp::add, 1, sse2_add8);
+  set(kernels, VectorOp::add, 2, sse2_add16);
+  set(kernels, VectorOp::add, 4, sse2_add32);
+  set(kernels, VectorOp::add, 8, sse2_add64);
+  set(kernels, VectorOp::sub, 1, sse2_sub8);
+  set(kernels, VectorOp::sub, 2, sse2_sub16);
+  set(kernels, VectorOp::sub, 4, sse2_sub32);
+  set(kernels, VectorOp::sub, 8, sse2_sub64);
+  set(kernels, VectorOp::and_, 1, sse2_and8);
+  set(kernels, VectorOp::and_, 2, sse2_and16);
+  set(kernels, VectorOp::and_, 4, sse2_and32);
+  set(kernels, VectorOp::and_, 8, sse2_and64);
+  set(kernels, VectorOp::or_, 1, sse2_or8);
+  set(kernels, VectorOp::or_, 2, sse2_or16);
+  set(kernels, VectorOp::or_, 4, sse2_or32);
+  set(kernels, VectorOp::or_, 8, sse2_or64);
+  set(kernels, VectorOp::xor_, 1, sse2_xor8);
+  set(kernels, VectorOp::xor_, 2, sse2_xor16);
+  set(kernels, VectorOp::xor_, 4, sse2_xor32);
+  set(kernels, VectorOp::xor_, 8, sse2_xor64);
+  set(kernels, VectorOp::mul, 2, sse2_mul16);
+  set(kernels, VectorOp::minu, 1, sse2_minu8);
+  set(kernels, VectorOp::maxu, 1, sse2_maxu8);
+  set(kernels, VectorOp::min, 2, sse2_min16);
+  set(kernels, VectorOp::max, 2, sse2_max16);
+}
+
+void use_avx2(VectorKernels &kernels) {
+  kernels.isa = "avx2";
+  set(kernels, VectorOp::add, 1, avx2_add8);
+  set(kernels, VectorOp::add, 2, avx2_add16);
+  set(kernels, VectorOp::add, 4, avx2_add32);
+  set(kernels, VectorOp::add, 8, avx2_add64);
+  set(kernels, VectorOp::sub, 1, avx2_sub8);
+  set(kernels, VectorOp::sub, 2, avx2_sub16);
+  set(kernels, VectorOp::sub, 4, avx2_sub32);
+  set(kernels, VectorOp::sub, 8, avx2_sub64);
+  set(kernels, VectorOp::and_, 1, avx2_and8);
+  set(kernels, VectorOp::and_, 2, avx2_and16);
+  set(kernels, VectorOp::and_, 4, avx2_and32);
+  set(kernels, VectorOp::and_, 8, avx2_and64);
+  set(kernels, VectorOp::or_, 1, avx2_or8);
+  set(kernels, VectorOp::or_, 2, avx2_or16);
+  set(kernels, VectorOp::or_, 4, avx2_or32);
+  set(kernels, VectorOp::or_, 8, avx2_or64);
+  set(kernels, VectorOp::xor_, 1, avx2_xor8);
+  set(kernels, VectorOp::xor_, 2, avx2_xor16);
+  set(kernels, VectorOp::xor_, 4, avx2_xor32);
+  set(kernels, VectorOp::xor_, 8, avx2_xor64);
+  set(kernels, VectorOp::mul, 2, avx2_mul16);
+  set(kernels, VectorOp::mul, 4, avx2_mul32);
+  set(kernels, VectorOp::minu, 1, avx2_minu8);
+  set(kernels, VectorOp::minu, 2, avx2_minu16);
+  set(kernels, VectorOp::minu, 4, avx2_minu32);
+  set(kernels, VectorOp::min, 1, avx2_min8);
+  set(kernels, VectorOp::min, 2, avx2_min16);
+  set(kernels, VectorOp::min, 4, avx2_min32);
+  set(kernels, VectorOp::maxu, 1, avx2_maxu8);
+  set(kernels, VectorOp::maxu, 2, avx2_maxu16);
+  set(kernels, VectorOp::maxu, 4, avx2_maxu32);
+  set(kernels, VectorOp::max, 1, avx2_max8);
+  set(kernels, VectorOp::max, 2, avx2_max16);
+  set(kernels, VectorOp::max, 4, avx2_max32);
+  set(kernels, VectorOp::sll, 4, avx2_sll32);
+  set(kernels, VectorOp::sll, 8, avx2_sll64);
+  set(kernels, VectorOp::srl, 4, avx2_srl32);
+  set(kernels, VectorOp::srl, 8, avx2_srl64);
+  set(kernels, VectorOp::sra, 4, avx2_sra32);
+}
+#endif
+
+VectorKernels select_kernels() {
+  VectorKernels kernels{};
+  kernels.isa = "generic";
+  use_generic<uint8_t>(kernels);
+  use_generic<uint16_t>(kernels);
+  use_generic<uint32_t>(kernels);
+  use_generic<uint64_t>(kernels);
+#if SIM_X86_KERNELS
+  // Each level only replaces the kernels it has, so AVX2 falls back to SSE2
+  // for the operations it does not cover
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    use_sse2(kernels);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    use_avx2(kernels);
+  }
+#endif
+  return kernels;
+}
+} // namespace
+
+const VectorKernels &vector_kernels() {
+  static const VectorKernels kernels = select_kernels();
+  return kernels;
+}
+} // namespace sim
@@ -0,0 +1,388 @@
+#include "virtio_blk.hpp"
+
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sim {
+namespace {
+// virtio-mmio register offsets
+constexpr uint32_t reg_magic = 0x000;
+constexpr uint32_t reg_version = 0x004;
+constexpr uint32_t reg_device_id = 0x008;
+constexpr uint32_t reg_vendor_id = 0x00c;
+constexpr uint32_t reg_device_features = 0x010;
+constexpr uint32_t reg_device_features_sel = 0x014;
+constexpr uint32_t reg_driver_features = 0x020;
+constexpr uint32_t reg_driver_features_sel = 0x024;
+constexpr uint32_t reg_queue_sel = 0x030;
+constexpr uint32_t reg_queue_num_max = 0x034;
+constexpr uint32_t reg_queue_num = 0x038;
+constexpr uint32_t reg_queue_ready = 0x044;
+constexpr uint32_t reg_queue_notify = 0x050;
+constexpr uint32_t reg_interrupt_status = 0x060;
+constexpr uint32_t reg_interrupt_ack = 0x064;
+constexpr uint32_t reg_status = 0x070;
+constexpr uint32_t reg_queue_desc_low = 0x080;
+constexpr uint32_t reg_queue_driver_low = 0x090;
+constexpr uint32_t reg_queue_device_low = 0x0a0;
+constexpr uint32_t reg_config_generation = 0x0fc;
+constexpr uint32_t reg_config = 0x100;
+
+constexpr uint32_t magic_value = 0x74726976; // "virt"
+constexpr uint32_t device_id_blk = 2;
+constexpr uint32_t vendor_id = 0x554d4551;
+
+constexpr uint64_t feature_blk_ro = uint64_t{1} << 5;
+constexpr uint64_t feature_blk_size = uint64_t{1} << 6;
+constexpr uint64_t feature_blk_flush = uint64_t{1} << 9;
+constexpr uint64_t feature_version_1 = uint64_t{1} << 32;
+
+constexpr uint16_t desc_next = 1;
+constexpr uint16_t desc_write = 2;
+
+constexpr uint32_t req_in = 0;
+constexpr uint32_t req_out = 1;
+constexpr uint32_t req_flush = 4;
+constexpr uint32_t req_get_id = 8;
+
+constexpr uint8_t status_ok = 0;
+constexpr uint8_t status_ioerr = 1;
+constexpr uint8_t status_unsupp = 2;
+
+constexpr uint32_t interrupt_used_buffer = 1;
+
+struct Descriptor {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t flags;
+  uint16_t next;
+};
+static_assert(sizeof(Descriptor) == 16, "virtq_desc must be 16 bytes");
+
+struct RequestHeader {
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t sector;
+};
+
+template <typename T>
+bool load(PhysicalMemory *mem, uint64_t paddr, T &value) {
+  const uint8_t *ptr = mem->physical_ptr(static_cast<uint32_t>(paddr),
+                                         sizeof(T));
+  if (!ptr || paddr >> 32) {
+    return false;
+  }
+  std::memcpy(&value, ptr, sizeof(T));
+  return true;
+}
+
+template <typename T>
+bool store(PhysicalMemory *mem, uint64_t paddr, const T &value) {
+  uint8_t *ptr = mem->writable_ptr(static_cast<uint32_t>(paddr), sizeof(T));
+  if (!ptr || paddr >> 32) {
+    return false;
+  }
+  std::memcpy(ptr, &value, sizeof(T));
+  return true;
+}
+} // namespace
+
+VirtioBlk::~VirtioBlk() {
+  if (image_) {
+    ::munmap(image_, image_size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void VirtioBlk::open(const std::string &path) {
+  fd_ = ::open(path.c_str(), O_RDWR);
+  if (fd_ < 0) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    read_only_ = true;
+  }
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot open disk image: " + path);
+  }
+
+  struct stat st {};
+  if (::fstat(fd_, &st) < 0 || st.st_size < sector_size) {
+    throw std::runtime_error("Disk image is empty: " + path);
+  }
+  image_size_ = static_cast<std::size_t>(st.st_size) & ~(sector_size - 1);
+
+  int prot = read_only_ ? PROT_READ : PROT_READ | PROT_WRITE;
+  void *image = ::mmap(nullptr, image_size_, prot, MAP_SHARED, fd_, 0);
+  if (image == MAP_FAILED) {
+    throw std::runtime_error("Cannot map disk image: " + path);
+  }
+  image_ = static_cast<uint8_t *>(image);
+}
+
+void VirtioBlk::attach(PhysicalMemory *mem, InterruptLines *irq) {
+  mem_ = mem;
+  irq_ = irq;
+}
+
+uint64_t VirtioBlk::features() const {
+  uint64_t features = feature_version_1 | feature_blk_size | feature_blk_flush;
+  if (read_only_) {
+    features |= feature_blk_ro;
+  }
+  return features;
+}
+
+uint64_t VirtioBlk::config_read(uint32_t offset, int size) const {
+  // struct virtio_blk_config up to blk_size
+  std::array<uint8_t, 0x18> config{};
+  uint64_t capacity = image_size_ / sector_size;
+  std::memcpy(&config[0x00], &capacity, sizeof(capacity));
+  std::memcpy(&config[0x14], &sector_size, sizeof(sector_size));
+
+  uint64_t value = 0;
+  if (offset + size <= config.size()) {
+    std::memcpy(&value, &config[offset], size);
+  }
+  return value;
+}
+
+void VirtioBlk::reset() {
+  queue_ = Queue{};
+  status_ = 0;
+  device_features_sel_ = 0;
+  driver_features_sel_ = 0;
+  driver_features_ = 0;
+  interrupt_status_ = 0;
+  irq_->lower(MIP_MEIP);
+}
+
+uint64_t VirtioBlk::read(uint32_t offset, int size) {
+  if (offset >= reg_config) {
+    return config_read(offset - reg_config, size);
+  }
+
+  switch (offset) {
+  case reg_magic:
+    return magic_value;
+  case reg_version:
+    return 2;
+  case reg_device_id:
+    return device_id_blk;
+  case reg_vendor_id:
+    return vendor_id;
+  case reg_device_features:
+    return device_features_sel_ < 2
+               ? static_cast<uint32_t>(features() >> (32 * device_features_sel_))
+               : 0;
+  case reg_queue_num_max:
+    return queue_num_max;
+  case reg_queue_ready:
+    return queue_.ready;
+  case reg_interrupt_status:
+    return interrupt_status_;
+  case reg_status:
+    return status_;
+  case reg_config_generation:
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+void VirtioBlk::write(uint32_t offset, uint64_t value, int) {
+  uint32_t word = static_cast<uint32_t>(value);
+
+  switch (offset) {
+  case reg_device_features_sel:
+    device_features_sel_ = word;
+    break;
+  case reg_driver_features_sel:
+    driver_features_sel_ = word;
+    break;
+  case reg_driver_features:
+    if (driver_features_sel_ < 2) {
+      uint32_t shift = 32 * driver_features_sel_;
+      driver_features_ &= ~(uint64_t{0xFFFFFFFF} << shift);
+      driver_features_ |= (uint64_t{word} << shift) & features();
+    }
+    break;
+  case reg_queue_sel:
+    // Only queue 0 exists; the driver probes further queues by reading
+    // QueueNumMax, which stays the same, so there is nothing to track
+    break;
+  case reg_queue_num:
+    queue_.num = word <= queue_num_max ? word : queue_num_max;
+    break;
+  case reg_queue_ready:
+    queue_.ready = word & 1;
+    break;
+  case reg_queue_desc_low:
+    queue_.desc = word;
+    break;
+  case reg_queue_driver_low:
+    queue_.avail = word;
+    break;
+  case reg_queue_device_low:
+    queue_.used = word;
+    break;
+  case reg_queue_notify:
+    if (word == 0) {
+      process_queue();
+    }
+    break;
+  case reg_interrupt_ack:
+    interrupt_status_ &= ~word;
+    if (interrupt_status_ == 0) {
+      irq_->lower(MIP_MEIP);
+    }
+    break;
+  case reg_status:
+    if (word == 0) {
+      reset();
+    } else {
+      status_ = word;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void VirtioBlk::process_queue() {
+  if (!queue_.ready || queue_.num == 0) {
+    return;
+  }
+
+  uint16_t avail_idx = 0;
+  uint16_t used_idx = 0;
+  if (!load(mem_, queue_.avail + 2, avail_idx) ||
+      !load(mem_, queue_.used + 2, used_idx)) {
+    return;
+  }
+
+  bool completed = false;
+  while (queue_.last_avail != avail_idx) {
+    uint16_t head = 0;
+    if (!load(mem_, queue_.avail + 4 + 2 * (queue_.last_avail % queue_.num),
+              head)) {
+      break;
+    }
+    ++queue_.last_avail;
+
+    uint32_t written = 0;
+    process_request(head, written);
+
+    uint32_t used_elem = queue_.used + 4 + 8 * (used_idx % queue_.num);
+    store(mem_, used_elem, uint32_t{head});
+    store(mem_, used_elem + 4, written);
+    ++used_idx;
+    completed = true;
+  }
+
+  if (completed) {
+    // The used index is published only after all ring entries are written
+    store(mem_, queue_.used + 2, used_idx);
+    interrupt_status_ |= interrupt_used_buffer;
+    irq_->raise(MIP_MEIP);
+  }
+}
+
+uint32_t VirtioBlk::process_request(uint16_t head, uint32_t &written) {
+  static thread_local std::vector<Descriptor> chain;
+  chain.clear();
+
+  uint16_t index = head;
+  for (;;) {
+    Descriptor desc{};
+    if (chain.size() >= queue_.num || index >= queue_.num ||
+        !load(mem_, queue_.desc + 16 * uint64_t{index}, desc)) {
+      return status_ioerr;
+    }
+    chain.push_back(desc);
+    if (!(desc.flags & desc_next)) {
+      break;
+    }
+    index = desc.next;
+  }
+
+  // Header, data buffers, status byte
+  RequestHeader header{};
+  const Descriptor &status_desc = chain.back();
+  if (chain.size() < 2 || chain.front().len < sizeof(header) ||
+      !(status_desc.flags & desc_write) ||
+      !load(mem_, chain.front().addr, header)) {
+    return status_ioerr;
+  }
+
+  uint8_t status = status_ok;
+  uint64_t offset = 0;
+  if (header.type == req_in || header.type == req_out) {
+    // Checked before the multiply, which a huge sector would wrap
+    if (header.sector >= image_size_ / sector_size) {
+      status = status_ioerr;
+    } else {
+      offset = header.sector * sector_size;
+    }
+  }
+  for (std::size_t i = 1; i + 1 < chain.size() && status == status_ok; ++i) {
+    const Descriptor &desc = chain[i];
+    uint32_t addr = static_cast<uint32_t>(desc.addr);
+    const uint8_t *guest =
+        desc.addr >> 32 ? nullptr : mem_->physical_ptr(addr, desc.len);
+    if (!guest) {
+      status = status_ioerr;
+      break;
+    }
+
+    switch (header.type) {
+    case req_in:
+      if (!(desc.flags & desc_write) || desc.len > image_size_ - offset) {
+        status = status_ioerr;
+        break;
+      }
+      std::memcpy(mem_->writable_ptr(addr, desc.len), image_ + offset,
+                  desc.len);
+      written += desc.len;
+      offset += desc.len;
+      break;
+    case req_out:
+      if (read_only_ || desc.len > image_size_ - offset) {
+        status = status_ioerr;
+        break;
+      }
+      std::memcpy(image_ + offset, guest, desc.len);
+      offset += desc.len;
+      break;
+    case req_get_id: {
+      static const char id[20] = "sim-virtio-blk";
+      uint32_t len = desc.len < sizeof(id) ? desc.len : sizeof(id);
+      std::memcpy(mem_->writable_ptr(addr, len), id, len);
+      written += len;
+      break;
+    }
+    case req_flush:
+      break;
+    default:
+      status = status_unsupp;
+      break;
+    }
+  }
+
+  if (header.type == req_flush && status == status_ok && !read_only_ &&
+      ::msync(image_, image_size_, MS_SYNC) < 0) {
+    status = status_ioerr;
+  }
+
+  if (store(mem_, status_desc.addr, status)) {
+    ++written;
+  }
+  return status;
+}
+} // namespace sim
@@ -0,0 +1,620 @@
+#include "wide_hart.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "compressed.hpp"
+#include "machine.hpp"
+
+namespace sim {
+namespace {
+template <typename T> T load(const uint8_t *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+template <typename T> void store(uint8_t *p, T value) {
+  std::memcpy(p, &value, sizeof(value));
+}
+} // namespace
+
+template <int XLEN>
+WideHart<XLEN>::WideHart(std::vector<Machine<XLEN> *> lanes)
+    : lanes_(std::move(lanes)) {
+  if (lanes_.empty() || lanes_.size() > max_lanes) {
+    throw std::invalid_argument("A wide hart runs 1 to 16 lanes");
+  }
+  Hart<XLEN> &first = lanes_[0]->hart(0);
+  pc_ = first.pc;
+  n_instructions_ = first.n_instructions;
+  for (std::size_t lane = 0; lane < lanes_.size(); ++lane) {
+    Hart<XLEN> &hart = lanes_[lane]->hart(0);
+    if (hart.pc != pc_) {
+      throw std::invalid_argument("Lanes must start at the same pc");
+    }
+    // Syscalls go through the scalar hart and its MMU
+    hart.start();
+    for (std::size_t reg = 0; reg < 32; ++reg) {
+      x_[reg][lane] = hart.gpr_[reg];
+    }
+    active_ |= 1u << lane;
+  }
+}
+
+template <int XLEN> void WideHart<XLEN>::run() {
+#if ENABLE_MMU
+  // Lanes address memory physically, which only matches bare mode
+  split_all();
+#endif
+  while (active_ != 0) {
+    const Instruction *instr = fetch();
+    if (!instr || !execute(*instr)) {
+      split_all();
+    }
+  }
+}
+
+template <int XLEN>
+const typename WideHart<XLEN>::Instruction *WideHart<XLEN>::fetch() {
+  auto it = decoded_.find(pc_);
+  if (it != decoded_.end()) {
+    return &it->second;
+  }
+  if (pc_ >= static_cast<register_t>(memory_size) - 4) {
+    return nullptr;
+  }
+  // Lanes run the same code, so any active lane can be read
+  std::size_t lane = __builtin_ctz(active_);
+  const uint8_t *ptr =
+      lanes_[lane]->memory_.physical_ptr(static_cast<uint32_t>(pc_), 4);
+  if (!ptr) {
+    return nullptr;
+  }
+  uint32_t bits = load<uint32_t>(ptr);
+  uint32_t length = instruction_length(bits);
+  if (length == 2) {
+    bits = expand_compressed<XLEN>(static_cast<uint16_t>(bits));
+  }
+  return &decoded_.emplace(pc_, decode(bits, length)).first->second;
+}
+
+template <int XLEN>
+typename WideHart<XLEN>::Instruction WideHart<XLEN>::decode(uint32_t bits,
+                                                            uint32_t length) {
+  Instruction instr;
+  instr.length = length;
+  instr.rd = bits >> 7 & 0x1F;
+  instr.funct3 = bits >> 12 & 0x7;
+  instr.rs1 = bits >> 15 & 0x1F;
+  instr.rs2 = bits >> 20 & 0x1F;
+  uint32_t funct7 = bits >> 25;
+  int32_t sbits = static_cast<int32_t>(bits);
+  auto sext = [](int32_t value) {
+    return static_cast<register_t>(static_cast<sregister_t>(value));
+  };
+  register_t imm_i = sext(sbits >> 20);
+  // Shifts by a constant take the shift amount from the low immediate bits
+  register_t shamt = bits >> 20 & (XLEN - 1);
+  bool shift_ok = XLEN == 64 ? (funct7 >> 1) == 0 : funct7 == 0;
+  bool shift_alt = XLEN == 64 ? (funct7 >> 1) == 0x10 : funct7 == 0x20;
+
+  switch (bits & 0x7F) {
+  case 0x33: // OP
+    instr.use_rs2 = true;
+    if (funct7 == 0x01) {
+      if (instr.funct3 == 0) {
+        instr.kind = Kind::op;
+        instr.op = VectorOp::mul;
+      } else {
+        instr.kind = Kind::muldiv;
+      }
+      break;
+    }
+    if (funct7 != 0 && !(funct7 == 0x20 && (instr.funct3 == 0 ||
+                                            instr.funct3 == 5))) {
+      break;
+    }
+    switch (instr.funct3) {
+    case 0:
+      instr.kind = Kind::op;
+      instr.op = funct7 ? VectorOp::sub : VectorOp::add;
+      break;
+    case 1:
+      instr.kind = Kind::op;
+      instr.op = VectorOp::sll;
+      break;
+    case 2:
+      instr.kind = Kind::slt;
+      break;
+    case 3:
+      instr.kind = Kind::sltu;
+      break;
+    case 4:
+      instr.kind = Kind::op;
+      instr.op = VectorOp::xor_;
+      break;
+    case 5:
+      instr.kind = Kind::op;
+      instr.op = funct7 ? VectorOp::sra : VectorOp::srl;
+      break;
+    case 6:
+      instr.kind = Kind::op;
+      instr.op = VectorOp::or_;
+      break;
+    case 7:
+      instr.kind = Kind::op;
+      instr.op = VectorOp::and_;
+      break;
+    }
+    break;
+  case 0x13: // OP-IMM
+    instr.imm = imm_i;
+    switch (instr.funct3) {
+    case 0:
+      instr.kind = Kind::op_imm;
+      instr.op = VectorOp::add;
+      break;
+    case 1:
+      if (shift_ok) {
+        instr.kind = Kind::op_imm;
+        instr.op = VectorOp::sll;
+        instr.imm = shamt;
+      }
+      break;
+    case 2:
+      instr.kind = Kind::slt;
+      break;
+    case 3:
+      instr.kind = Kind::sltu;
+      break;
+    case 4:
+      instr.kind = Kind::op_imm;
+      instr.op = VectorOp::xor_;
+      break;
+    case 5:
+      if (shift_ok || shift_alt) {
+        instr.kind = Kind::op_imm;
+        instr.op = shift_ok ? VectorOp::srl : VectorOp::sra;
+        instr.imm = shamt;
+      }
+      break;
+    case 6:
+      instr.kind = Kind::op_imm;
+      instr.op = VectorOp::or_;
+      break;
+    case 7:
+      instr.kind = Kind::op_imm;
+      instr.op = VectorOp::and_;
+      break;
+    }
+    break;
+  case 0x3B: // OP-32
+    instr.use_rs2 = true;
+    if (XLEN == 64 && funct7 == 0x01 &&
+        (instr.funct3 == 0 || instr.funct3 >= 4)) {
+      instr.kind = Kind::muldivw;
+    } else if (XLEN == 64 &&
+               (funct7 == 0 ||
+                (funct7 == 0x20 && (instr.funct3 == 0 || instr.funct3 == 5))) &&
+               (instr.funct3 == 0 || instr.funct3 == 1 || instr.funct3 == 5)) {
+      instr.kind = Kind::word;
+      // subw and sraw
+      instr.alt = funct7 == 0x20 && (instr.funct3 == 0 || instr.funct3 == 5);
+    }
+    break;
+  case 0x1B: // OP-IMM-32
+    instr.imm = instr.funct3 == 0 ? imm_i : instr.rs2;
+    if (XLEN == 64 &&
+        (instr.funct3 == 0 || (instr.funct3 == 1 && funct7 == 0) ||
+         (instr.funct3 == 5 && (funct7 == 0 || funct7 == 0x20)))) {
+      instr.kind = Kind::word;
+      // sraiw; the funct7 bits of addiw are immediate bits
+      instr.alt = instr.funct3 == 5 && funct7 == 0x20;
+    }
+    break;
+  case 0x37:
+    instr.kind = Kind::lui;
+    instr.imm = sext(sbits & ~0xFFF);
+    break;
+  case 0x17:
+    instr.kind = Kind::auipc;
+    instr.imm = sext(sbits & ~0xFFF);
+    break;
+  case 0x6F:
+    instr.kind = Kind::jal;
+    instr.imm = sext((sbits >> 11 & ~0xFFFFF) | (bits & 0xFF000) |
+                     (bits >> 9 & 0x800) | (bits >> 20 & 0x7FE));
+    break;
+  case 0x67:
+    if (instr.funct3 == 0) {
+      instr.kind = Kind::jalr;
+      instr.imm = imm_i;
+    }
+    break;
+  case 0x63:
+    instr.use_rs2 = true;
+    if (instr.funct3 != 2 && instr.funct3 != 3) {
+      instr.kind = Kind::branch;
+      instr.imm = sext((sbits >> 19 & ~0xFFF) | (bits << 4 & 0x800) |
+                       (bits >> 20 & 0x7E0) | (bits >> 7 & 0x1E));
+    }
+    break;
+  case 0x03:
+    if (instr.funct3 != 7 && (XLEN == 64 || (instr.funct3 != 3 &&
+                                             instr.funct3 != 6))) {
+      instr.kind = Kind::load;
+      instr.imm = imm_i;
+    }
+    break;
+  case 0x23:
+    instr.use_rs2 = true;
+    if (instr.funct3 < (XLEN == 64 ? 4 : 3)) {
+      instr.kind = Kind::store;
+      instr.imm = sext((sbits >> 20 & ~0x1F) | (bits >> 7 & 0x1F));
+    }
+    break;
+  case 0x73:
+    if (bits == 0x73) {
+      instr.kind = Kind::ecall;
+    }
+    break;
+  case 0x0F: // fence, fence.i: lanes share nothing
+    if (instr.funct3 <= 1) {
+      instr.kind = Kind::nop;
+    }
+    break;
+  }
+  return instr;
+}
+
+template <int XLEN>
+void WideHart<XLEN>::split(std::size_t lane, register_t pc) {
+  Hart<XLEN> &hart = lanes_[lane]->hart(0);
+  for (std::size_t reg = 1; reg < 32; ++reg) {
+    hart.gpr_[reg] = x_[reg][lane];
+  }
+  hart.pc = pc;
+  hart.n_instructions = n_instructions_;
+  active_ &= ~(1u << lane);
+  split_.push_back(lane);
+}
+
+template <int XLEN> void WideHart<XLEN>::split_all() {
+  while (active_ != 0) {
+    split(__builtin_ctz(active_), pc_);
+  }
+}
+
+template <int XLEN> void WideHart<XLEN>::retire() {
+  ++n_instructions_;
+  lane_instructions_ += __builtin_popcount(active_);
+}
+
+template <int XLEN> void WideHart<XLEN>::diverge(const Lanes &next_pc) {
+  // The most common target keeps running in lock-step
+  std::size_t best = max_lanes;
+  int best_count = 0;
+  for (uint32_t lanes = active_; lanes != 0; lanes &= lanes - 1) {
+    std::size_t lane = __builtin_ctz(lanes);
+    int count = 0;
+    for (uint32_t other = active_; other != 0; other &= other - 1) {
+      count += next_pc[__builtin_ctz(other)] == next_pc[lane];
+    }
+    if (count > best_count) {
+      best = lane;
+      best_count = count;
+    }
+  }
+  pc_ = next_pc[best];
+  for (uint32_t lanes = active_; lanes != 0; lanes &= lanes - 1) {
+    std::size_t lane = __builtin_ctz(lanes);
+    if (next_pc[lane] != pc_) {
+      split(lane, next_pc[lane]);
+    }
+  }
+}
+
+template <int XLEN> bool WideHart<XLEN>::execute(const Instruction &instr) {
+  std::size_t n = lanes_.size();
+  Lanes &rd = x_[instr.rd];
+  const Lanes &rs1 = x_[instr.rs1];
+  const Lanes &rs2 = instr.use_rs2 ? x_[instr.rs2] : operand_;
+  if (!instr.use_rs2) {
+    operand_.fill(instr.imm);
+  }
+  // x0 is never written, so it stays zero in every lane
+  bool write = instr.rd != 0;
+  Lanes next;
+
+  switch (instr.kind) {
+  case Kind::op:
+  case Kind::op_imm:
+    if (write) {
+      kernels_.get(instr.op, sizeof(register_t))(
+          reinterpret_cast<uint8_t *>(rd.data()),
+          reinterpret_cast<const uint8_t *>(rs1.data()),
+          reinterpret_cast<const uint8_t *>(rs2.data()), n);
+    }
+    break;
+  case Kind::slt:
+    for (std::size_t i = 0; write && i < n; ++i) {
+      rd[i] = static_cast<sregister_t>(rs1[i]) <
+              static_cast<sregister_t>(rs2[i]);
+    }
+    break;
+  case Kind::sltu:
+    for (std::size_t i = 0; write && i < n; ++i) {
+      rd[i] = rs1[i] < rs2[i];
+    }
+    break;
+  case Kind::muldiv:
+    if (write) {
+      muldiv(instr, rd, rs1, rs2);
+    }
+    break;
+  case Kind::word:
+  case Kind::muldivw:
+    if (write) {
+      word(instr, rd, rs1, rs2);
+    }
+    break;
+  case Kind::lui:
+    if (write) {
+      rd.fill(instr.imm);
+    }
+    break;
+  case Kind::auipc:
+    if (write) {
+      rd.fill(pc_ + instr.imm);
+    }
+    break;
+  case Kind::jal:
+    if (write) {
+      rd.fill(pc_ + instr.length);
+    }
+    retire();
+    pc_ += instr.imm;
+    return true;
+  case Kind::jalr:
+    for (std::size_t i = 0; i < n; ++i) {
+      next[i] = (rs1[i] + instr.imm) & ~register_t{1};
+    }
+    if (write) {
+      rd.fill(pc_ + instr.length);
+    }
+    retire();
+    diverge(next);
+    return true;
+  case Kind::branch:
+    for (std::size_t i = 0; i < n; ++i) {
+      bool taken = branch_taken(instr.funct3, rs1[i], rs2[i]);
+      next[i] = pc_ + (taken ? instr.imm : instr.length);
+    }
+    retire();
+    diverge(next);
+    return true;
+  case Kind::load:
+  case Kind::store:
+    if (!memory(instr)) {
+      return false;
+    }
+    break;
+  case Kind::ecall:
+    retire();
+    ecall();
+    pc_ += instr.length;
+    return true;
+  case Kind::nop:
+    break;
+  case Kind::scalar:
+    return false;
+  }
+  retire();
+  pc_ += instr.length;
+  return true;
+}
+
+template <int XLEN>
+bool WideHart<XLEN>::branch_taken(uint32_t funct3, register_t a,
+                                  register_t b) {
+  switch (funct3) {
+  case 0:
+    return a == b;
+  case 1:
+    return a != b;
+  case 4:
+    return static_cast<sregister_t>(a) < static_cast<sregister_t>(b);
+  case 5:
+    return static_cast<sregister_t>(a) >= static_cast<sregister_t>(b);
+  case 6:
+    return a < b;
+  default:
+    return a >= b;
+  }
+}
+
+template <int XLEN>
+void WideHart<XLEN>::muldiv(const Instruction &instr, Lanes &rd,
+                            const Lanes &rs1, const Lanes &rs2) {
+  using dreg = typename Xlen<XLEN>::dreg;
+  using sdreg = typename Xlen<XLEN>::sdreg;
+  constexpr register_t min_signed = register_t{1} << (XLEN - 1);
+  for (std::size_t i = 0; i < lanes_.size(); ++i) {
+    register_t a = rs1[i];
+    register_t b = rs2[i];
+    sregister_t sa = static_cast<sregister_t>(a);
+    sregister_t sb = static_cast<sregister_t>(b);
+    // Inactive lanes hold stale values, so overflow is avoided in all lanes
+    bool overflow = a == min_signed && sb == -1;
+    switch (instr.funct3) {
+    case 1:
+      rd[i] = static_cast<register_t>(
+          static_cast<dreg>(static_cast<sdreg>(sa) * static_cast<sdreg>(sb)) >>
+          XLEN);
+      break;
+    case 2:
+      rd[i] = static_cast<register_t>(
+          static_cast<dreg>(static_cast<sdreg>(sa) *
+                            static_cast<sdreg>(static_cast<dreg>(b))) >>
+          XLEN);
+      break;
+    case 3:
+      rd[i] = static_cast<register_t>(
+          static_cast<dreg>(a) * static_cast<dreg>(b) >> XLEN);
+      break;
+    case 4:
+      rd[i] = b == 0 ? ~register_t{0} : overflow ? a : sa / sb;
+      break;
+    case 5:
+      rd[i] = b == 0 ? ~register_t{0} : a / b;
+      break;
+    case 6:
+      rd[i] = b == 0 ? a : overflow ? 0 : sa % sb;
+      break;
+    default:
+      rd[i] = b == 0 ? a : a % b;
+      break;
+    }
+  }
+}
+
+template <int XLEN>
+void WideHart<XLEN>::word(const Instruction &instr, Lanes &rd,
+                          const Lanes &rs1, const Lanes &rs2) {
+  for (std::size_t i = 0; i < lanes_.size(); ++i) {
+    uint32_t a = static_cast<uint32_t>(rs1[i]);
+    uint32_t b = static_cast<uint32_t>(rs2[i]);
+    int32_t sa = static_cast<int32_t>(a);
+    int32_t sb = static_cast<int32_t>(b);
+    uint32_t result;
+    if (instr.kind == Kind::muldivw) {
+      bool overflow = a == 0x80000000u && sb == -1;
+      switch (instr.funct3) {
+      case 0:
+        result = a * b;
+        break;
+      case 4:
+        result = b == 0 ? ~0u : overflow ? a : sa / sb;
+        break;
+      case 5:
+        result = b == 0 ? ~0u : a / b;
+        break;
+      case 6:
+        result = b == 0 ? a : overflow ? 0 : sa % sb;
+        break;
+      default:
+        result = b == 0 ? a : a % b;
+        break;
+      }
+    } else if (instr.funct3 == 0) {
+      result = instr.alt ? a - b : a + b;
+    } else if (instr.funct3 == 1) {
+      result = a << (b & 31);
+    } else {
+      result = instr.alt ? static_cast<uint32_t>(sa >> (b & 31))
+                         : a >> (b & 31);
+    }
+    rd[i] = static_cast<register_t>(
+        static_cast<sregister_t>(static_cast<int32_t>(result)));
+  }
+}
+
+template <int XLEN> bool WideHart<XLEN>::memory(const Instruction &instr) {
+  std::size_t size = std::size_t{1} << (instr.funct3 & 3);
+  // Stores get writable pointers, so loads leave the page clean
+  std::array<const uint8_t *, max_lanes> src;
+  std::array<uint8_t *, max_lanes> dst;
+  // Every lane has to reach RAM before any of them accesses it
+  for (uint32_t lanes = active_; lanes != 0; lanes &= lanes - 1) {
+    std::size_t lane = __builtin_ctz(lanes);
+    uint64_t addr = x_[instr.rs1][lane] + instr.imm;
+    PhysicalMemory &memory = lanes_[lane]->memory_;
+    if (addr >> 32) {
+      return false;
+    }
+    if (instr.kind == Kind::store) {
+      src[lane] = dst[lane] =
+          memory.writable_ptr(static_cast<uint32_t>(addr), size);
+    } else {
+      src[lane] = memory.physical_ptr(static_cast<uint32_t>(addr), size);
+    }
+    if (!src[lane]) {
+      return false;
+    }
+  }
+
+  Lanes &rd = x_[instr.rd];
+  const Lanes &rs2 = x_[instr.rs2];
+  for (uint32_t lanes = active_; lanes != 0; lanes &= lanes - 1) {
+    std::size_t lane = __builtin_ctz(lanes);
+    const uint8_t *p = src[lane];
+    if (instr.kind == Kind::store) {
+      switch (size) {
+      case 1:
+        *dst[lane] = static_cast<uint8_t>(rs2[lane]);
+        break;
+      case 2:
+        store<uint16_t>(dst[lane], static_cast<uint16_t>(rs2[lane]));
+        break;
+      case 4:
+        store<uint32_t>(dst[lane], static_cast<uint32_t>(rs2[lane]));
+        break;
+      default:
+        store<uint64_t>(dst[lane], static_cast<uint64_t>(rs2[lane]));
+        break;
+      }
+      continue;
+    }
+    if (instr.rd == 0) {
+      continue;
+    }
+    switch (instr.funct3) {
+    case 0:
+      rd[lane] = static_cast<register_t>(static_cast<int8_t>(*p));
+      break;
+    case 1:
+      rd[lane] = static_cast<register_t>(load<int16_t>(p));
+      break;
+    case 2:
+      rd[lane] = static_cast<register_t>(load<int32_t>(p));
+      break;
+    case 3:
+      rd[lane] = static_cast<register_t>(load<uint64_t>(p));
+      break;
+    case 4:
+      rd[lane] = *p;
+      break;
+    case 5:
+      rd[lane] = load<uint16_t>(p);
+      break;
+    default:
+      rd[lane] = load<uint32_t>(p);
+      break;
+    }
+  }
+  return true;
+}
+
+template <int XLEN> void WideHart<XLEN>::ecall() {
+  // Each lane makes its own syscall through its scalar hart
+  for (uint32_t lanes = active_; lanes != 0; lanes &= lanes - 1) {
+    std::size_t lane = __builtin_ctz(lanes);
+    Hart<XLEN> &hart = lanes_[lane]->hart(0);
+    for (std::size_t reg = 1; reg < 32; ++reg) {
+      hart.gpr_[reg] = x_[reg][lane];
+    }
+    hart.pc = pc_;
+    hart.n_instructions = n_instructions_;
+    hart.sys_->handle(&hart);
+    if (hart.halted_) {
+      active_ &= ~(1u << lane);
+    } else {
+      x_[10][lane] = hart.gpr_[10];
+    }
+  }
+}
+
+template class WideHart<32>;
+template class WideHart<64>;
+} // namespace sim